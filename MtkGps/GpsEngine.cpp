@@ -0,0 +1,218 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "GpsEngine.h"
+
+#define ENGINE_READ_LEN 1024
+
+GpsEngine::GpsEngine(engineHandler *handler, void *data)
+{
+	this->handler = handler;
+	hdata = data;
+	nparsed = 0;
+	for(int i = 0; i < GPS_ENGINE_MAX; i++) {
+		rcv[i].gps = NULL;
+		rcv[i].port = NULL;
+		rcv[i].errors = 0;
+		rcv[i].id = i;
+		rcv[i].engine = this;
+	}
+	efd = epoll_create1(EPOLL_CLOEXEC);
+}
+
+GpsEngine::~GpsEngine(void)
+{
+	for(int i = 0; i < GPS_ENGINE_MAX; i++)
+		remove(i);
+	if (efd >= 0)
+		close(efd);
+	efd = -1;
+}
+
+int GpsEngine::add(MtkGps *gps, const char *dev, uint32_t baud)
+{
+	receiver *r = alloc();
+	if (r == NULL || gps == NULL || r->tty.open(dev, baud) < 0)
+		return -1;
+
+	if (watch(r, gps, &r->tty) < 0) {
+		r->tty.close();
+		return -1;
+	}
+	gps->begin(baud);
+
+	return r->id;
+}
+
+int GpsEngine::add(MtkGps *gps, int fd)
+{
+	receiver *r = alloc();
+	if (r == NULL || fd < 0)
+		return -1;
+
+	r->tty.attach(fd);
+	if (watch(r, gps, &r->tty) < 0) {
+		r->tty.attach(-1);
+		return -1;
+	}
+	return r->id;
+}
+
+int GpsEngine::add(MtkGps *gps, GpsPort *port)
+{
+	receiver *r = alloc();
+	if (r == NULL || watch(r, gps, port) < 0)
+		return -1;
+	return r->id;
+}
+
+GpsEngine::receiver *GpsEngine::alloc(void)
+{
+	if (efd < 0)
+		return NULL;
+
+	for(int i = 0; i < GPS_ENGINE_MAX; i++) {
+		if (rcv[i].gps == NULL)
+			return &rcv[i];
+	}
+	return NULL;
+}
+
+int GpsEngine::watch(receiver *r, MtkGps *gps, GpsPort *port)
+{
+	if (gps == NULL || port == NULL || port->fd() < 0)
+		return -1;
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = r;
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, port->fd(), &ev) < 0)
+		return -1;
+
+	r->gps = gps;
+	r->port = port;
+	r->errors = 0;
+	gps->attach(port);
+	gps->setHandler(dispatch, r);
+	return 0;
+}
+
+void GpsEngine::remove(int id)
+{
+	if (id < 0 || id >= GPS_ENGINE_MAX || rcv[id].gps == NULL)
+		return;
+
+	receiver *r = &rcv[id];
+	epoll_ctl(efd, EPOLL_CTL_DEL, r->port->fd(), NULL);
+	r->gps->setHandler(NULL);
+	r->gps->attach((GpsPort *)NULL);
+	// closes only device opened by the engine
+	r->tty.close();
+	r->gps = NULL;
+	r->port = NULL;
+}
+
+MtkGps *GpsEngine::get(int id)
+{
+	if (id < 0 || id >= GPS_ENGINE_MAX)
+		return NULL;
+	return rcv[id].gps;
+}
+
+void GpsEngine::dispatch(MtkGps *gps, int nmea_type, void *data)
+{
+	receiver *r = (receiver *)data;
+	GpsEngine *engine = r->engine;
+
+	if (engine->handler)
+		engine->handler(r->id, gps, nmea_type, engine->hdata);
+}
+
+// drain receiver port, parse every complete sentence
+int GpsEngine::process(receiver *r)
+{
+	char buf[ENGINE_READ_LEN];
+
+	while(1) {
+		int len = r->port->read(buf, sizeof(buf));
+		if (len < 0) {
+			r->errors++;
+			return -1;
+		}
+		// device gone is reported as EPOLLHUP
+		if (len == 0)
+			return 0;
+
+		r->gps->record(buf, len);
+		for(int i = 0; i < len; i++) {
+			const char *nmea = r->gps->frame(buf[i]);
+			// counted here, handler is not called for filtered sentences
+			if (nmea && r->gps->parse_nmea(nmea) == 0)
+				nparsed++;
+		}
+		if (len < (int)sizeof(buf))
+			return 0;
+	}
+}
+
+int GpsEngine::poll(int timeout)
+{
+	struct epoll_event ev[GPS_ENGINE_MAX];
+
+	if (efd < 0)
+		return -1;
+
+	int n = epoll_wait(efd, ev, GPS_ENGINE_MAX, timeout);
+	if (n < 0)
+		return (errno == EINTR) ? 0 : -1;
+
+	nparsed = 0;
+	for(int i = 0; i < n; i++) {
+		receiver *r = (receiver *)ev[i].data.ptr;
+		if (r->gps == NULL)
+			continue;
+		int ret = 0;
+		if (ev[i].events & EPOLLIN)
+			ret = process(r);
+		// stop waiting on broken ports, receiver stays registered
+		if (ret < 0 || (ev[i].events & (EPOLLERR | EPOLLHUP)))
+			epoll_ctl(efd, EPOLL_CTL_DEL, r->port->fd(), NULL);
+	}
+
+	// read() is not used, so queued command timeouts are checked here
+	for(int i = 0; i < GPS_ENGINE_MAX; i++) {
+		if (rcv[i].gps)
+			rcv[i].gps->serveCommands();
+	}
+
+	return nparsed;
+}
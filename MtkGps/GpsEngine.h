@@ -0,0 +1,93 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifndef __MTK_GPS_ENGINE_H__
+#define __MTK_GPS_ENGINE_H__
+
+/*
+	Single thread engine serving a number of GPS receivers: waits for
+	data on all attached serial ports with epoll, frames and parses data
+	from whichever ports are ready and dispatches parsed sentences
+	tagged with the receiver ID
+*/
+
+#include "MtkGps.h"
+
+#define GPS_ENGINE_MAX 16 // maximum number of receivers
+
+// called for every parsed sentence, id is receiver ID returned by GpsEngine::add()
+typedef void engineHandler(int id, MtkGps *gps, int nmea_type, void *data);
+
+class GpsEngine {
+public:
+	GpsEngine(engineHandler *handler = NULL, void *data = NULL);
+	~GpsEngine(void);
+
+	// open serial device and attach gps to it, returns receiver ID or -1
+	// note: engine uses gps nmeaHandler, do not call gps->setHandler()
+	int add(MtkGps *gps, const char *dev, uint32_t baud);
+	// attach gps to already opened non-blocking descriptor, returns receiver ID or -1
+	int add(MtkGps *gps, int fd);
+	// attach gps to a port with a non-blocking descriptor, see GpsPort::fd()
+	int add(MtkGps *gps, GpsPort *port);
+	// detach receiver, closes device opened by add()
+	void remove(int id);
+	// receiver by ID
+	MtkGps *get(int id);
+
+	// epoll descriptor, can be waited on by an outer event loop;
+	// call poll(0) on it and from a timer too, so queued commands time out
+	int fd(void) { return efd; }
+	// wait up to timeout msec (-1 forever) for data and process it,
+	// serves queued commands of all receivers, see MtkGps::serveCommands()
+	// returns number of sentences parsed or -1 on error
+	int poll(int timeout);
+
+private:
+	struct receiver {
+		MtkGps   *gps;
+		GpsPort  *port;
+		GpsTtyPort tty;   // device opened or descriptor attached by the engine
+		int       id;
+		uint32_t  errors; // read errors
+		GpsEngine *engine;
+	};
+
+	int efd;
+	int nparsed;
+	engineHandler *handler;
+	void *hdata;
+	receiver rcv[GPS_ENGINE_MAX];
+
+	receiver *alloc(void);
+	int watch(receiver *r, MtkGps *gps, GpsPort *port);
+	int process(receiver *r);
+	static void dispatch(MtkGps *gps, int nmea_type, void *data);
+};
+
+#endif
@@ -0,0 +1,197 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <math.h>
+#include <string.h>
+
+#include "GpsFilter.h"
+#include "MtkGps.h"
+
+// metres per degree of latitude, mean Earth radius 6371 km
+#define METRES_PER_DEGREE 111195.0
+
+GpsFilter::GpsFilter(void)
+{
+	metres_thr = GPS_FILTER_METRES;
+	knots_thr = GPS_FILTER_KNOTS;
+	degrees_thr = GPS_FILTER_DEGREES;
+	changes = GPS_FILTER_QUALITY | GPS_FILTER_SATS;
+	silence = GPS_FILTER_SILENCE;
+	memset(passed, 0, sizeof(passed));
+	memset(suppressed, 0, sizeof(suppressed));
+	reset();
+}
+
+void GpsFilter::reset(void)
+{
+	memset(last, 0, sizeof(last));
+	gsv_sats = 0;
+	gsv_pass = false;
+}
+
+// NMEA DDDMM.mmmm to signed degrees
+static double to_degrees(double ddmm, bool negative)
+{
+	double deg;
+	double frac = modf(ddmm / 100.0, &deg);
+
+	deg += frac / 0.6;
+	return negative ? -deg : deg;
+}
+
+static uint64_t prn_bit(unsigned prn)
+{
+	return (prn > 0 && prn <= 64) ? (1ULL << (prn - 1)) : 0;
+}
+
+bool GpsFilter::moved(last_pass *lp, double lat, double lon)
+{
+	if (metres_thr <= 0)
+		return false;
+	// equirectangular approximation is good enough for metres
+	double dy = (lat - lp->lat) * METRES_PER_DEGREE;
+	double dx = (lon - lp->lon) * METRES_PER_DEGREE * cos(lat * M_PI / 180.0);
+	return (dx * dx + dy * dy) >= (metres_thr * metres_thr);
+}
+
+bool GpsFilter::motion(last_pass *lp, double speed, double course)
+{
+	if (knots_thr > 0 && fabs(speed - lp->speed) >= knots_thr)
+		return true;
+	// course of a receiver standing still is noise
+	if (degrees_thr <= 0 || (knots_thr > 0 && speed < knots_thr))
+		return false;
+	double diff = fabs(course - lp->course);
+	if (diff > 180.0)
+		diff = 360.0 - diff;
+	return diff >= degrees_thr;
+}
+
+bool GpsFilter::update(MtkGps *gps, int nmea_type)
+{
+	int idx = nmea_type_index(nmea_type);
+	last_pass *lp = &last[idx];
+	last_pass now = *lp;
+	uint64_t t = gps->getParsedTime() / 1000000;
+	bool pass = (lp->t == 0) || (silence && (t - lp->t) >= silence);
+	bool quality = changes & GPS_FILTER_QUALITY;
+	bool sats = changes & GPS_FILTER_SATS;
+
+	switch(nmea_type) {
+	case NMEA_SEN_GLL:
+		now.lat = to_degrees(gps->gll.latitude, gps->gll.flags & NMEA_LAT_SOUTH);
+		now.lon = to_degrees(gps->gll.longitude, gps->gll.flags & NMEA_LON_WEST);
+		now.quality = gps->gll.flags & NMEA_VALID;
+		pass |= moved(lp, now.lat, now.lon);
+		pass |= quality && (now.quality != lp->quality);
+		break;
+	case NMEA_SEN_RMC:
+		now.lat = gps->latitude;
+		now.lon = gps->longitude;
+		now.speed = gps->rmc.speed;
+		now.course = gps->rmc.course;
+		now.quality = gps->rmc.flags & NMEA_VALID;
+		pass |= moved(lp, now.lat, now.lon);
+		pass |= motion(lp, now.speed, now.course);
+		pass |= quality && (now.quality != lp->quality);
+		break;
+	case NMEA_SEN_GGA:
+		now.lat = to_degrees(gps->gga.latitude, gps->gga.flags & NMEA_LAT_SOUTH);
+		now.lon = to_degrees(gps->gga.longitude, gps->gga.flags & NMEA_LON_WEST);
+		now.quality = gps->gga.quality;
+		pass |= moved(lp, now.lat, now.lon);
+		pass |= quality && (now.quality != lp->quality);
+		break;
+	case NMEA_SEN_VTG:
+		now.speed = gps->vtg.nspeed;
+		now.course = gps->vtg.ttrack;
+		pass |= motion(lp, now.speed, now.course);
+		break;
+	case NMEA_SEN_GSA:
+		now.quality = gps->gsa.fix;
+		now.sats = 0;
+		for(int i = 0; i < NMEA_GSA_MAX_PRN; i++)
+			now.sats |= prn_bit(gps->gsa.prn[i]);
+		pass |= quality && (now.quality != lp->quality);
+		pass |= sats && (now.sats != lp->sats);
+		break;
+	case NMEA_SEN_GSV: {
+		// every part is passed once the group differs from the last
+		// passed one, the last part always is, so handlers which wait
+		// for the complete group see the change
+		uint16_t igsv = gps->getGsvIndex();
+		uint16_t first = (igsv > 4) ? igsv - 4 : 0;
+		bool complete = igsv >= gps->ngsv;
+		if (first == 0) {
+			gsv_sats = 0;
+			gsv_pass = pass;
+		}
+		for(uint16_t i = first; i < igsv && i < NMEA_MAX_GSV; i++)
+			gsv_sats |= prn_bit(gps->gsv[i].prn);
+		if (sats && (gsv_sats & ~lp->sats))
+			gsv_pass = true;
+		if (complete && sats && gsv_sats != lp->sats)
+			gsv_pass = true;
+		pass = gsv_pass;
+		now.sats = gsv_sats;
+		// group is compared as a whole, update only when it is done
+		if (!complete) {
+			if (pass)
+				passed[idx]++;
+			else
+				suppressed[idx]++;
+			return pass;
+		}
+		break;
+	}
+	case NMEA_SEN_MCHN:
+		now.sats = 0;
+		for(int i = 0; i < MTK_MAX_CHN; i++) {
+			if (gps->chn[i].track == 2)
+				now.sats |= prn_bit(gps->chn[i].prn);
+		}
+		pass |= sats && (now.sats != lp->sats);
+		break;
+	case NMEA_SEN_ZDA:
+		// time always changes, silence interval only
+		break;
+	default:
+		// PMTK replies and whatever is unknown
+		passed[idx]++;
+		return true;
+	}
+
+	if (!pass) {
+		suppressed[idx]++;
+		return false;
+	}
+	now.t = t ? t : 1;
+	*lp = now;
+	passed[idx]++;
+	return true;
+}
@@ -0,0 +1,110 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifndef __MTK_GPS_FILTER_H__
+#define __MTK_GPS_FILTER_H__
+
+/*
+	Change detection between parsing and nmeaHandler: a receiver standing
+	still repeats nearly the same sentences every fix, the filter lets
+	through only those which differ from the last one of the same type
+	passed to the handler by more than a threshold, or which were not
+	passed for the maximum silence interval. Parsed data is always
+	up to date, only handler calls are skipped. See MtkGps::setFilter()
+*/
+
+#include <stdint.h>
+
+#include "nmea.h"
+
+// default thresholds
+#define GPS_FILTER_METRES  2.0   // position, GLL/RMC/GGA
+#define GPS_FILTER_KNOTS   0.5   // speed, RMC/VTG
+#define GPS_FILTER_DEGREES 10.0  // course, RMC/VTG, checked above speed threshold only
+#define GPS_FILTER_SILENCE 30000 // msec
+
+// discrete changes, setChanges() mask
+#define GPS_FILTER_QUALITY 0x01 // fix status/quality/type, RMC/GLL/GGA/GSA
+#define GPS_FILTER_SATS    0x02 // satellites used, in view or tracked, GSA/GSV/MCHN
+
+class MtkGps;
+
+class GpsFilter {
+public:
+	GpsFilter(void);
+
+	// 0 or negative threshold - field is not checked
+	void setPosition(double metres) { metres_thr = metres; }
+	void setSpeed(double knots) { knots_thr = knots; }
+	void setCourse(double degrees) { degrees_thr = degrees; }
+	void setChanges(uint8_t mask) { changes = mask; }
+	// pass a sentence anyway if none of its type was passed for msec, 0 - never
+	void setSilence(uint32_t msec) { silence = msec; }
+
+	double   getPosition(void) { return metres_thr; }
+	double   getSpeed(void) { return knots_thr; }
+	double   getCourse(void) { return degrees_thr; }
+	uint8_t  getChanges(void) { return changes; }
+	uint32_t getSilence(void) { return silence; }
+
+	// forget last passed sentences, next one of every type is passed
+	void reset(void);
+	// returns true if sentence of nmea_type just parsed by gps is to be
+	// passed to the handler; PMTK replies and unknown types always are
+	bool update(MtkGps *gps, int nmea_type);
+
+	// sentences passed and suppressed by NMEA_IDX_* type index
+	uint32_t passed[NMEA_NTYPES];
+	uint32_t suppressed[NMEA_NTYPES];
+
+private:
+	double   metres_thr;
+	double   knots_thr;
+	double   degrees_thr;
+	uint8_t  changes;
+	uint32_t silence;
+
+	// last passed sentence of every type
+	struct last_pass {
+		uint64_t t;       // msec, 0 if none yet
+		double   lat;
+		double   lon;
+		double   speed;
+		double   course;
+		uint8_t  quality;
+		uint64_t sats;    // PRN 1-64 bit mask
+	};
+	last_pass last[NMEA_NTYPES];
+	uint64_t gsv_sats; // GSV group being received
+	bool     gsv_pass; // current GSV group is passed
+
+	bool moved(last_pass *lp, double lat, double lon);
+	bool motion(last_pass *lp, double speed, double course);
+};
+
+#endif
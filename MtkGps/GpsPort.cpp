@@ -0,0 +1,248 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "GpsPort.h"
+#include "ttyfd.h"
+
+#ifdef __ARDUINO_X86__
+TTYUARTClass *GpsUartPort::attach(TTYUARTClass *ser)
+{
+	TTYUARTClass *cur = this->ser;
+	this->ser = ser;
+	return cur;
+}
+
+int GpsUartPort::begin(uint32_t baud)
+{
+	if (ser == NULL)
+		return -1;
+	ser->begin(baud);
+	delay(10);
+	return 0;
+}
+
+int GpsUartPort::read(char *buf, unsigned len)
+{
+	unsigned n = 0;
+
+	if (ser == NULL)
+		return -1;
+	while(n < len && ser->available())
+		buf[n++] = ser->read();
+	return n;
+}
+
+int GpsUartPort::write(const void *data, unsigned len)
+{
+	if (ser == NULL)
+		return -1;
+	return ser->write((const uint8_t *)data, len);
+}
+
+int GpsUartPort::available(void)
+{
+	return ser ? ser->available() : 0;
+}
+#endif
+
+GpsTtyPort::GpsTtyPort(void)
+{
+	tfd = -1;
+	own = false;
+}
+
+GpsTtyPort::~GpsTtyPort(void)
+{
+	close();
+}
+
+int GpsTtyPort::open(const char *dev, uint32_t baud, uint8_t vmin, uint8_t vtime)
+{
+	int fd = tty_open(dev, baud);
+	if (fd < 0)
+		return -1;
+	if ((vmin || vtime) && tty_set_timeouts(fd, vmin, vtime) < 0) {
+		::close(fd);
+		return -1;
+	}
+	tty_set_low_latency(fd, 1);
+
+	close();
+	tfd = fd;
+	own = true;
+	return 0;
+}
+
+int GpsTtyPort::attach(int fd)
+{
+	int cur = own ? -1 : tfd;
+	if (own)
+		close();
+	tfd = fd;
+	own = false;
+	return cur;
+}
+
+void GpsTtyPort::close(void)
+{
+	if (own && tfd >= 0)
+		::close(tfd);
+	tfd = -1;
+	own = false;
+}
+
+int GpsTtyPort::setTimeouts(uint8_t vmin, uint8_t vtime)
+{
+	return (tfd < 0) ? -1 : tty_set_timeouts(tfd, vmin, vtime);
+}
+
+int GpsTtyPort::setLowLatency(bool on)
+{
+	return (tfd < 0) ? -1 : tty_set_low_latency(tfd, on);
+}
+
+int GpsTtyPort::begin(uint32_t baud)
+{
+	return (tfd < 0) ? -1 : tty_set_baud(tfd, baud);
+}
+
+int GpsTtyPort::read(char *buf, unsigned len)
+{
+	ssize_t n;
+
+	if (tfd < 0)
+		return -1;
+	do {
+		n = ::read(tfd, buf, len);
+	} while(n < 0 && errno == EINTR);
+
+	if (n < 0)
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+	// with VMIN 0 no data is not an error
+	return n;
+}
+
+int GpsTtyPort::write(const void *data, unsigned len)
+{
+	const char *ptr = (const char *)data;
+	unsigned left = len;
+
+	if (tfd < 0)
+		return -1;
+	// commands are short, wait a bit rather than send a partial command
+	while(left) {
+		ssize_t n = ::write(tfd, ptr, left);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return -1;
+			usleep(1000);
+			continue;
+		}
+		ptr += n;
+		left -= n;
+	}
+	return len;
+}
+
+int GpsTtyPort::available(void)
+{
+	int n = 0;
+
+	if (tfd < 0 || ioctl(tfd, FIONREAD, &n) < 0)
+		return 0;
+	return n;
+}
+
+GpsMemPort::GpsMemPort(unsigned size)
+{
+	rxbuf = (char *)malloc(size);
+	this->size = rxbuf ? size : 0;
+	head = tail = 0;
+	baud = 0;
+	tx = txtail = 0;
+}
+
+GpsMemPort::~GpsMemPort(void)
+{
+	free(rxbuf);
+}
+
+unsigned GpsMemPort::feed(const void *data, unsigned len)
+{
+	if (tail == head)
+		head = tail = 0;
+	else if (len > (size - head)) {
+		memmove(rxbuf, rxbuf + tail, head - tail);
+		head -= tail;
+		tail = 0;
+	}
+	if (len > (size - head))
+		len = size - head;
+	memcpy(rxbuf + head, data, len);
+	head += len;
+	return len;
+}
+
+int GpsMemPort::read(char *buf, unsigned len)
+{
+	if (len > (head - tail))
+		len = head - tail;
+	memcpy(buf, rxbuf + tail, len);
+	tail += len;
+	return len;
+}
+
+int GpsMemPort::write(const void *data, unsigned len)
+{
+	const char *ptr = (const char *)data;
+
+	for(unsigned i = 0; i < len; i++)
+		txbuf[(tx + i) % GPS_MEM_TX] = ptr[i];
+	tx += len;
+	if ((tx - txtail) > GPS_MEM_TX)
+		txtail = tx - GPS_MEM_TX;
+	return len;
+}
+
+unsigned GpsMemPort::sent(char *buf, unsigned len)
+{
+	unsigned n = 0;
+
+	while(n < len && txtail < tx)
+		buf[n++] = txbuf[txtail++ % GPS_MEM_TX];
+	return n;
+}
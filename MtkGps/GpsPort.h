@@ -0,0 +1,144 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifndef __MTK_GPS_PORT_H__
+#define __MTK_GPS_PORT_H__
+
+/*
+	Transport between MtkGps and a receiver:
+	  GpsUartPort - Galileo TTYUARTClass (Serial, Serial1, ...)
+	  GpsTtyPort  - raw termios descriptor, any Linux serial device or pty
+	  GpsMemPort  - memory buffer, for replay, tests and benchmarks
+	Only GpsUartPort needs the Galileo core, the rest builds on any Linux host
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __ARDUINO_X86__
+#include <Arduino.h>
+#include "TTYUART.h"
+#endif
+
+class GpsPort {
+public:
+	virtual ~GpsPort(void) {}
+
+	// set baud rate, 0 or -1 if not supported
+	virtual int begin(uint32_t baud) = 0;
+	// read up to len bytes, returns number of bytes read, 0 if there is
+	// no data now or -1 on error
+	virtual int read(char *buf, unsigned len) = 0;
+	// returns number of bytes written or -1
+	virtual int write(const void *data, unsigned len) = 0;
+	// bytes waiting to be read, 0 if unknown
+	virtual int available(void) = 0;
+	// descriptor to wait on with poll/epoll, -1 if there is none
+	virtual int fd(void) { return -1; }
+};
+
+#ifdef __ARDUINO_X86__
+class GpsUartPort : public GpsPort {
+public:
+	GpsUartPort(TTYUARTClass *ser = NULL) { this->ser = ser; }
+
+	// returns previously attached serial port
+	TTYUARTClass *attach(TTYUARTClass *ser);
+	TTYUARTClass *serial(void) { return ser; }
+
+	virtual int begin(uint32_t baud);
+	virtual int read(char *buf, unsigned len);
+	virtual int write(const void *data, unsigned len);
+	virtual int available(void);
+
+private:
+	TTYUARTClass *ser;
+};
+#endif
+
+class GpsTtyPort : public GpsPort {
+public:
+	GpsTtyPort(void);
+	virtual ~GpsTtyPort(void);
+
+	// open serial device in raw mode; vmin/vtime 0 - non-blocking for
+	// event loops, otherwise blocking read() returns when vmin bytes are
+	// received or the line was idle for vtime tenths of a second.
+	// Low latency mode is requested, ignored if not supported
+	int open(const char *dev, uint32_t baud, uint8_t vmin = 0, uint8_t vtime = 0);
+	// use already opened descriptor, it is not closed by the port;
+	// returns previous descriptor or -1
+	int attach(int fd);
+	void close(void);
+
+	int setTimeouts(uint8_t vmin, uint8_t vtime);
+	int setLowLatency(bool on);
+
+	virtual int begin(uint32_t baud);
+	virtual int read(char *buf, unsigned len);
+	virtual int write(const void *data, unsigned len);
+	virtual int available(void);
+	virtual int fd(void) { return tfd; }
+
+private:
+	int tfd;
+	bool own; // opened by open()
+};
+
+#define GPS_MEM_RX 65536 // default receive buffer
+#define GPS_MEM_TX 1024  // last written data kept for inspection
+
+class GpsMemPort : public GpsPort {
+public:
+	GpsMemPort(unsigned size = GPS_MEM_RX);
+	virtual ~GpsMemPort(void);
+
+	// data to be received by the library, returns number of bytes taken
+	unsigned feed(const void *data, unsigned len);
+	// take data written by the library, up to the last GPS_MEM_TX bytes
+	unsigned sent(char *buf, unsigned len);
+	uint64_t txBytes(void) { return tx; }
+	uint32_t getBaud(void) { return baud; }
+
+	virtual int begin(uint32_t baud) { this->baud = baud; return 0; }
+	virtual int read(char *buf, unsigned len);
+	virtual int write(const void *data, unsigned len);
+	virtual int available(void) { return head - tail; }
+
+private:
+	char    *rxbuf;
+	unsigned size;
+	unsigned head;
+	unsigned tail;
+	uint32_t baud;
+	uint64_t tx;
+	uint64_t txtail; // oldest byte in txbuf not taken by sent()
+	char     txbuf[GPS_MEM_TX];
+};
+
+#endif
@@ -0,0 +1,709 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "GpsdServer.h"
+
+#define RING_MASK   (GPSD_RING_SIZE - 1)
+#define REC_HDR     4 // record header: uint16_t length, kind, reserved
+#define MAX_IOV     64
+#define LISTENER    GPSD_MAX_CLIENTS // epoll tag of the listening socket
+#define KNOTS_TO_MS 0.514444
+
+/*
+	tiny JSON writer, no sprintf: output is truncated
+	if it does not fit into the buffer
+*/
+typedef struct jbuf_s
+{
+	char *ptr;
+	char *end;
+} jbuf_t;
+
+static void j_raw(jbuf_t *j, const char *str)
+{
+	while(*str && j->ptr < j->end)
+		*j->ptr++ = *str++;
+}
+
+static void j_uint(jbuf_t *j, uint64_t val)
+{
+	char tmp[24];
+	char *p = tmp + sizeof(tmp);
+
+	*--p = '\0';
+	do {
+		*--p = '0' + val % 10;
+		val /= 10;
+	} while(val);
+	j_raw(j, p);
+}
+
+static void j_int(jbuf_t *j, int64_t val)
+{
+	if (val < 0) {
+		j_raw(j, "-");
+		val = -val;
+	}
+	j_uint(j, (uint64_t)val);
+}
+
+// fixed point output, 'digits' after decimal point
+static void j_fixed(jbuf_t *j, double val, int digits)
+{
+	static const uint32_t scale[] = {
+		1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+	};
+
+	if (val < 0) {
+		j_raw(j, "-");
+		val = -val;
+	}
+	uint64_t fixed = (uint64_t)(val * scale[digits] + 0.5);
+	j_uint(j, fixed / scale[digits]);
+	if (digits == 0)
+		return;
+
+	char frac[12];
+	uint32_t rem = fixed % scale[digits];
+	frac[0] = '.';
+	frac[digits + 1] = '\0';
+	for(int i = digits; i > 0; i--) {
+		frac[i] = '0' + rem % 10;
+		rem /= 10;
+	}
+	j_raw(j, frac);
+}
+
+static void j_key(jbuf_t *j, const char *key)
+{
+	j_raw(j, ",\"");
+	j_raw(j, key);
+	j_raw(j, "\":");
+}
+
+static void j_str(jbuf_t *j, const char *key, const char *val)
+{
+	j_key(j, key);
+	j_raw(j, "\"");
+	j_raw(j, val);
+	j_raw(j, "\"");
+}
+
+static uint32_t j_len(jbuf_t *j, char *start)
+{
+	return j->ptr - start;
+}
+
+GpsdServer::GpsdServer(uint32_t policy)
+{
+	lsock = -1;
+	efd = -1;
+	this->policy = policy;
+	nclients = ndropped = ndisconnected = 0;
+	head = tail = 0;
+	ring = NULL;
+	last_tpv[0] = last_sky[0] = '\0';
+	strcpy(device, "/dev/ttyS0");
+	memset(clients, 0, sizeof(clients));
+}
+
+GpsdServer::~GpsdServer(void)
+{
+	end();
+}
+
+void GpsdServer::setDevice(const char *path)
+{
+	strncpy(device, path, sizeof(device) - 1);
+	device[sizeof(device) - 1] = '\0';
+}
+
+int GpsdServer::begin(uint16_t port, const char *ip_addr)
+{
+	struct sockaddr_in addr;
+
+	end();
+	if ((ring = (char *)malloc(GPSD_RING_SIZE)) == NULL)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = ip_addr ? inet_addr(ip_addr) : htonl(INADDR_ANY);
+
+	lsock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (lsock < 0)
+		goto error;
+
+	{
+		int opt = 1;
+		setsockopt(lsock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+	}
+	if (bind(lsock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lsock, 16) < 0)
+		goto error;
+
+	if ((efd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		goto error;
+
+	{
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.u32 = LISTENER;
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, lsock, &ev) < 0)
+			goto error;
+	}
+
+	return lsock;
+
+error:
+	end();
+	return -1;
+}
+
+void GpsdServer::end(void)
+{
+	for(int i = 0; i < GPSD_MAX_CLIENTS; i++) {
+		if (clients[i])
+			drop(clients[i]);
+	}
+	if (lsock >= 0)
+		close(lsock);
+	if (efd >= 0)
+		close(efd);
+	lsock = efd = -1;
+	if (ring)
+		free(ring);
+	ring = NULL;
+	head = tail = 0;
+}
+
+void GpsdServer::drop(client *c)
+{
+	for(int i = 0; i < GPSD_MAX_CLIENTS; i++) {
+		if (clients[i] == c) {
+			clients[i] = NULL;
+			break;
+		}
+	}
+	close(c->fd); // also removes it from epoll set
+	free(c);
+	nclients--;
+}
+
+void GpsdServer::set_events(client *c, uint32_t events)
+{
+	if (c->events == events)
+		return;
+
+	struct epoll_event ev;
+	ev.events = events;
+	for(int i = 0; i < GPSD_MAX_CLIENTS; i++) {
+		if (clients[i] == c)
+			ev.data.u32 = i;
+	}
+	epoll_ctl(efd, EPOLL_CTL_MOD, c->fd, &ev);
+	c->events = events;
+}
+
+void GpsdServer::reply(client *c, const char *str, uint32_t len)
+{
+	// compact already sent part
+	if (c->outoff) {
+		memmove(c->out, c->out + c->outoff, c->outlen - c->outoff);
+		c->outlen -= c->outoff;
+		c->outoff = 0;
+	}
+	if (len > (sizeof(c->out) - c->outlen))
+		return; // client does not read its replies, ignore
+	memcpy(c->out + c->outlen, str, len);
+	c->outlen += len;
+}
+
+void GpsdServer::accept_clients(void)
+{
+	while(1) {
+		int fd = accept4(lsock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+
+		int idx;
+		for(idx = 0; idx < GPSD_MAX_CLIENTS && clients[idx]; idx++);
+		client *c = (idx < GPSD_MAX_CLIENTS) ? (client *)malloc(sizeof(client)) : NULL;
+		if (c == NULL) {
+			close(fd);
+			continue;
+		}
+
+		memset(c, 0, offsetof(client, in));
+		c->fd = fd;
+		c->pos = head;
+		c->events = EPOLLIN;
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.u32 = idx;
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			close(fd);
+			free(c);
+			continue;
+		}
+		clients[idx] = c;
+		nclients++;
+
+		static const char version[] = "{\"class\":\"VERSION\",\"release\":\"3.11\","
+			"\"rev\":\"MtkGps\",\"proto_major\":3,\"proto_minor\":11}\r\n";
+		reply(c, version, sizeof(version) - 1);
+		send_client(c);
+	}
+}
+
+static int is_set(const char *cmd, const char *key, int def)
+{
+	const char *val = strstr(cmd, key);
+	if (val == NULL)
+		return def;
+	val += strlen(key);
+	while(*val == ' ' || *val == ':')
+		val++;
+	return strncmp(val, "true", 4) == 0;
+}
+
+void GpsdServer::command(client *c, char *cmd)
+{
+	char buf[GPSD_MAX_REPLY];
+	jbuf_t j = { buf, buf + sizeof(buf) - 2 };
+
+	while(*cmd == ' ' || *cmd == '\r')
+		cmd++;
+	if (*cmd == '\0')
+		return;
+
+	if (strncmp(cmd, "?WATCH", 6) == 0) {
+		if (cmd[6] == '=') {
+			int enable = is_set(cmd, "\"enable\"", 1);
+			int nmea = is_set(cmd, "\"nmea\"", 0);
+			int json = is_set(cmd, "\"json\"", !nmea);
+			c->watch = 0;
+			if (enable) {
+				c->watch |= json ? GPSD_JSON : 0;
+				c->watch |= nmea ? GPSD_NMEA : 0;
+			}
+			// start streaming from the current data
+			c->pos = head;
+			c->off = 0;
+		}
+		j_raw(&j, "{\"class\":\"DEVICES\",\"devices\":[{\"class\":\"DEVICE\"");
+		j_str(&j, "path", device);
+		j_str(&j, "driver", "MTK-3301");
+		j_raw(&j, ",\"activated\":1}]}\r\n");
+		j_raw(&j, "{\"class\":\"WATCH\",\"enable\":");
+		j_raw(&j, c->watch ? "true" : "false");
+		j_key(&j, "json");
+		j_raw(&j, (c->watch & GPSD_JSON) ? "true" : "false");
+		j_key(&j, "nmea");
+		j_raw(&j, (c->watch & GPSD_NMEA) ? "true" : "false");
+		j_raw(&j, ",\"raw\":0,\"scaled\":false,\"timing\":false,\"split24\":false,\"pps\":false}");
+	}
+	else if (strncmp(cmd, "?POLL", 5) == 0) {
+		j_raw(&j, "{\"class\":\"POLL\",\"active\":1,\"tpv\":[");
+		j_raw(&j, last_tpv);
+		j_raw(&j, "],\"sky\":[");
+		j_raw(&j, last_sky);
+		j_raw(&j, "]}");
+	}
+	else if (strncmp(cmd, "?VERSION", 8) == 0) {
+		j_raw(&j, "{\"class\":\"VERSION\",\"release\":\"3.11\",\"rev\":\"MtkGps\","
+			"\"proto_major\":3,\"proto_minor\":11}");
+	}
+	else if (strncmp(cmd, "?DEVICES", 8) == 0) {
+		j_raw(&j, "{\"class\":\"DEVICES\",\"devices\":[{\"class\":\"DEVICE\"");
+		j_str(&j, "path", device);
+		j_str(&j, "driver", "MTK-3301");
+		j_raw(&j, ",\"activated\":1}]}");
+	}
+	else {
+		j_raw(&j, "{\"class\":\"ERROR\",\"message\":\"Unrecognized request\"}");
+	}
+
+	j.end += 2; // room for EOL reserved above
+	j_raw(&j, "\r\n");
+	reply(c, buf, j_len(&j, buf));
+}
+
+// returns -1 if client is gone
+int GpsdServer::read_client(client *c)
+{
+	while(1) {
+		ssize_t len = recv(c->fd, c->in + c->inlen, sizeof(c->in) - c->inlen - 1, MSG_DONTWAIT);
+		if (len == 0)
+			return -1;
+		if (len < 0)
+			return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+
+		c->inlen += len;
+		c->in[c->inlen] = '\0';
+
+		// commands are terminated with ';' or EOL
+		char *cmd = c->in;
+		for(char *p = c->in; *p; p++) {
+			if (*p == ';' || *p == '\n') {
+				*p = '\0';
+				command(c, cmd);
+				cmd = p + 1;
+			}
+		}
+		c->inlen -= cmd - c->in;
+		memmove(c->in, cmd, c->inlen);
+		// line too long, discard it
+		if (c->inlen == sizeof(c->in) - 1)
+			c->inlen = 0;
+	}
+}
+
+void GpsdServer::ring_copy(char *dst, uint64_t at, uint32_t len)
+{
+	uint32_t idx = at & RING_MASK;
+	uint32_t first = GPSD_RING_SIZE - idx;
+	if (first > len)
+		first = len;
+	memcpy(dst, ring + idx, first);
+	memcpy(dst + first, ring, len - first);
+}
+
+// records the client has not read are overwritten already,
+// returns -1 if the client has to be disconnected
+int GpsdServer::lagging(client *c)
+{
+	if (c->pos >= tail)
+		return 0;
+
+	if (policy == GPSD_SLOW_DISCONNECT) {
+		ndisconnected++;
+		return -1;
+	}
+	ndropped++;
+	// terminate partially sent line
+	if (c->off)
+		reply(c, "\r\n", 2);
+	c->pos = tail;
+	c->off = 0;
+	return 0;
+}
+
+// send pending replies and ring records, returns -1 if client is gone
+int GpsdServer::send_client(client *c)
+{
+	if (lagging(c) < 0)
+		return -1;
+
+	if (c->outoff < c->outlen) {
+		ssize_t n = send(c->fd, c->out + c->outoff, c->outlen - c->outoff, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				return -1;
+			n = 0;
+		}
+		c->outoff += n;
+		if (c->outoff < c->outlen) {
+			set_events(c, EPOLLIN | EPOLLOUT);
+			return 0;
+		}
+		c->outoff = c->outlen = 0;
+	}
+
+	if (c->watch == 0 || c->pos == head) {
+		c->pos = head;
+		set_events(c, EPOLLIN);
+		return 0;
+	}
+
+	struct iovec iov[MAX_IOV];
+	uint64_t rec_pos[MAX_IOV]; // records being sent and their payload size
+	uint32_t rec_len[MAX_IOV];
+	int niov = 0, nrec = 0;
+	uint32_t off = c->off;
+	uint64_t pos;
+
+	for(pos = c->pos; pos < head && niov < (MAX_IOV - 1); ) {
+		uint8_t hdr[REC_HDR];
+		ring_copy((char *)hdr, pos, REC_HDR);
+		uint32_t len = hdr[0] | (hdr[1] << 8);
+		if (hdr[2] & c->watch) {
+			// payload might wrap around the ring end
+			uint32_t idx = (pos + REC_HDR + off) & RING_MASK;
+			uint32_t size = len - off;
+			uint32_t first = GPSD_RING_SIZE - idx;
+			if (first > size)
+				first = size;
+			iov[niov].iov_base = ring + idx;
+			iov[niov++].iov_len = first;
+			if (first < size) {
+				iov[niov].iov_base = ring;
+				iov[niov++].iov_len = size - first;
+			}
+			rec_pos[nrec] = pos;
+			rec_len[nrec++] = len;
+		}
+		pos += REC_HDR + len;
+		off = 0;
+	}
+
+	if (niov == 0) {
+		c->pos = pos;
+		c->off = 0;
+		return (pos < head) ? send_client(c) : 0;
+	}
+
+	struct msghdr mh;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = niov;
+	ssize_t n = sendmsg(c->fd, &mh, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (n < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			return -1;
+		n = 0;
+	}
+
+	// advance client position over what was sent
+	uint32_t sent = n;
+	off = c->off;
+	int i;
+	for(i = 0; i < nrec; i++) {
+		uint32_t remain = rec_len[i] - off;
+		if (sent < remain) {
+			c->pos = rec_pos[i];
+			c->off = off + sent;
+			break;
+		}
+		sent -= remain;
+		off = 0;
+	}
+	if (i == nrec) {
+		c->pos = pos;
+		c->off = 0;
+	}
+
+	set_events(c, (c->pos < head) ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+	return 0;
+}
+
+void GpsdServer::flush(void)
+{
+	for(int i = 0; i < GPSD_MAX_CLIENTS; i++) {
+		client *c = clients[i];
+		// clients waiting for EPOLLOUT will be served by poll()
+		if (c && c->watch && !(c->events & EPOLLOUT)) {
+			if (send_client(c) < 0)
+				drop(c);
+		}
+	}
+}
+
+void GpsdServer::publish(uint32_t kind, const char *data, uint32_t len)
+{
+	if (ring == NULL || len > 0xFFFF || (len + REC_HDR) > GPSD_RING_SIZE/4)
+		return;
+
+	uint32_t rec = REC_HDR + len;
+	// free space by dropping the oldest records
+	while((head + rec - tail) > GPSD_RING_SIZE) {
+		uint8_t hdr[REC_HDR];
+		ring_copy((char *)hdr, tail, REC_HDR);
+		tail += REC_HDR + (hdr[0] | (hdr[1] << 8));
+	}
+
+	char hdr[REC_HDR];
+	hdr[0] = len & 0xFF;
+	hdr[1] = len >> 8;
+	hdr[2] = kind;
+	hdr[3] = 0;
+
+	for(uint32_t i = 0; i < rec; i++) {
+		ring[(head + i) & RING_MASK] = (i < REC_HDR) ? hdr[i] : data[i - REC_HDR];
+	}
+	head += rec;
+
+	for(int i = 0; i < GPSD_MAX_CLIENTS; i++) {
+		if (clients[i] && clients[i]->watch && lagging(clients[i]) < 0)
+			drop(clients[i]);
+	}
+	flush();
+}
+
+void GpsdServer::publish_nmea(const char *nmea)
+{
+	char line[MAX_NMEA_LEN + 2];
+	uint32_t len = strlen(nmea);
+
+	while(len && (nmea[len - 1] == '\r' || nmea[len - 1] == '\n'))
+		len--;
+	if (len > MAX_NMEA_LEN)
+		return;
+	memcpy(line, nmea, len);
+	line[len++] = '\r';
+	line[len++] = '\n';
+
+	publish(GPSD_NMEA, line, len);
+}
+
+void GpsdServer::publish_tpv(MtkGps *gps)
+{
+	char ts[GPS_ISO8601_LEN];
+	jbuf_t j = { last_tpv, last_tpv + sizeof(last_tpv) - 1 };
+
+	// 0 - unknown, 1 - no fix, 2 - 2D, 3 - 3D
+	int mode = 0;
+	if (gps->isValid(NMEA_SEN_GSA) && gps->gsa.fix >= NMEA_GSA_NO_FIX && gps->gsa.fix <= NMEA_GSA_3D_FIX)
+		mode = gps->gsa.fix - '0';
+	else if (gps->isValid(NMEA_SEN_RMC))
+		mode = (gps->rmc.flags & NMEA_VALID) ? 2 : 1;
+
+	j_raw(&j, "{\"class\":\"TPV\"");
+	j_str(&j, "device", device);
+	j_key(&j, "mode");
+	j_int(&j, mode);
+	if (gps->getFixTimeStr(ts) > 0)
+		j_str(&j, "time", ts);
+	if (mode >= 2) {
+		j_key(&j, "lat");
+		j_fixed(&j, gps->latitude, 9);
+		j_key(&j, "lon");
+		j_fixed(&j, gps->longitude, 9);
+		if (mode == 3 && gps->isValid(NMEA_SEN_GGA)) {
+			j_key(&j, "alt");
+			j_fixed(&j, gps->gga.altitude, 3);
+		}
+		if (gps->isValid(NMEA_SEN_RMC)) {
+			j_key(&j, "track");
+			j_fixed(&j, gps->rmc.course, 4);
+			j_key(&j, "speed");
+			j_fixed(&j, gps->rmc.speed * KNOTS_TO_MS, 3);
+		}
+	}
+	j_raw(&j, "}");
+	*j.ptr = '\0';
+
+	uint32_t len = j_len(&j, last_tpv);
+	char line[sizeof(last_tpv) + 2];
+	memcpy(line, last_tpv, len);
+	line[len++] = '\r';
+	line[len++] = '\n';
+	publish(GPSD_JSON, line, len);
+}
+
+void GpsdServer::publish_sky(MtkGps *gps)
+{
+	jbuf_t j = { last_sky, last_sky + sizeof(last_sky) - 1 };
+
+	j_raw(&j, "{\"class\":\"SKY\"");
+	j_str(&j, "device", device);
+	if (gps->isValid(NMEA_SEN_GSA)) {
+		j_key(&j, "hdop");
+		j_fixed(&j, gps->gsa.hdop, 2);
+		j_key(&j, "vdop");
+		j_fixed(&j, gps->gsa.vdop, 2);
+		j_key(&j, "pdop");
+		j_fixed(&j, gps->gsa.pdop, 2);
+	}
+	j_raw(&j, ",\"satellites\":[");
+	for(int i = 0, n = 0; i < gps->ngsv && i < NMEA_MAX_GSV; i++) {
+		gpgsv_t *sv = &gps->gsv[i];
+		if (sv->prn == 0)
+			continue;
+		int used = 0;
+		for(int k = 0; k < NMEA_GSA_MAX_PRN; k++) {
+			if (gps->gsa.prn[k] == sv->prn)
+				used = 1;
+		}
+		j_raw(&j, n++ ? ",{\"PRN\":" : "{\"PRN\":");
+		j_int(&j, sv->prn);
+		j_key(&j, "el");
+		j_int(&j, sv->elevation);
+		j_key(&j, "az");
+		j_int(&j, sv->azimuth);
+		j_key(&j, "ss");
+		j_int(&j, sv->snr);
+		j_key(&j, "used");
+		j_raw(&j, used ? "true}" : "false}");
+	}
+	j_raw(&j, "]}");
+	*j.ptr = '\0';
+
+	uint32_t len = j_len(&j, last_sky);
+	char line[sizeof(last_sky) + 2];
+	memcpy(line, last_sky, len);
+	line[len++] = '\r';
+	line[len++] = '\n';
+	publish(GPSD_JSON, line, len);
+}
+
+int GpsdServer::poll(int timeout)
+{
+	struct epoll_event ev[GPSD_MAX_CLIENTS + 1];
+
+	if (efd < 0)
+		return -1;
+
+	int n = epoll_wait(efd, ev, GPSD_MAX_CLIENTS + 1, timeout);
+	if (n < 0)
+		return (errno == EINTR) ? 0 : -1;
+
+	for(int i = 0; i < n; i++) {
+		uint32_t idx = ev[i].data.u32;
+		if (idx == LISTENER) {
+			accept_clients();
+			continue;
+		}
+
+		client *c = clients[idx];
+		if (c == NULL)
+			continue;
+		int ret = 0;
+		if (ev[i].events & (EPOLLERR | EPOLLHUP))
+			ret = -1;
+		if (ret == 0 && (ev[i].events & EPOLLIN))
+			ret = read_client(c);
+		// send replies and pending data
+		if (ret == 0)
+			ret = send_client(c);
+		if (ret < 0)
+			drop(c);
+	}
+
+	return n;
+}
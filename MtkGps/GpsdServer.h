@@ -0,0 +1,125 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifndef __MTK_GPSD_SERVER_H__
+#define __MTK_GPSD_SERVER_H__
+
+/*
+	Minimal gpsd compatible TCP server: streams TPV, SKY and raw NMEA
+	to clients using gpsd JSON protocol (?WATCH, ?POLL, ?VERSION, ?DEVICES).
+	http://www.catb.org/gpsd/gpsd_json.html
+
+	Published data goes to one shared ring buffer, every client has its own
+	read position in it. Sockets are non-blocking, so a slow client never
+	blocks publishing: it either skips data it has not read in time or it
+	is disconnected, see GPSD_SLOW_*.
+*/
+
+#include "MtkGps.h"
+
+#define GPSD_PORT        2947
+#define GPSD_MAX_CLIENTS 32
+#define GPSD_RING_SIZE   (64*1024) // power of 2
+#define GPSD_MAX_CMD     256
+#define GPSD_MAX_REPLY   4096
+
+// slow client policy
+#define GPSD_SLOW_DROP       0 // skip data the client has not read yet
+#define GPSD_SLOW_DISCONNECT 1 // close the client connection
+
+// published data kinds, clients select them with ?WATCH
+#define GPSD_JSON 0x01 // TPV and SKY
+#define GPSD_NMEA 0x02 // raw NMEA sentences
+
+class GpsdServer {
+public:
+	GpsdServer(uint32_t policy = GPSD_SLOW_DROP);
+	~GpsdServer(void);
+
+	// listen on port, any IPv4 address if ip_addr is NULL
+	int  begin(uint16_t port = GPSD_PORT, const char *ip_addr = NULL);
+	void end(void);
+	// device path reported to clients
+	void setDevice(const char *path);
+
+	// epoll descriptor, can be waited on by an outer event loop
+	int fd(void) { return efd; }
+	// wait up to timeout msec for client activity and serve it
+	int poll(int timeout);
+
+	// publish data to watching clients
+	void publish_nmea(const char *nmea);
+	void publish_tpv(MtkGps *gps);
+	void publish_sky(MtkGps *gps);
+
+	uint32_t count(void) { return nclients; }
+	uint32_t dropped(void) { return ndropped; }           // times a slow client skipped unread data
+	uint32_t disconnected(void) { return ndisconnected; } // slow clients disconnected
+
+private:
+	struct client {
+		int      fd;
+		uint32_t watch;  // GPSD_JSON | GPSD_NMEA, 0 - not watching
+		uint64_t pos;    // ring position of the next record to send
+		uint32_t off;    // bytes of that record already sent
+		uint32_t events; // registered epoll events
+		uint32_t inlen;
+		uint32_t outlen;
+		uint32_t outoff;
+		char in[GPSD_MAX_CMD];     // partial command line
+		char out[GPSD_MAX_REPLY];  // replies to commands, sent before ring data
+	};
+
+	int lsock;
+	int efd;
+	uint32_t policy;
+	uint32_t nclients;
+	uint32_t ndropped;
+	uint32_t ndisconnected;
+	uint64_t head; // next write position
+	uint64_t tail; // oldest record
+	char device[64];
+	char *ring;
+	char last_tpv[GPSD_MAX_REPLY/2];
+	char last_sky[GPSD_MAX_REPLY/2];
+	client *clients[GPSD_MAX_CLIENTS];
+
+	void publish(uint32_t kind, const char *data, uint32_t len);
+	void flush(void);
+	void accept_clients(void);
+	void drop(client *c);
+	int  read_client(client *c);
+	int  send_client(client *c);
+	int  lagging(client *c);
+	void set_events(client *c, uint32_t events);
+	void command(client *c, char *cmd);
+	void reply(client *c, const char *str, uint32_t len);
+	void ring_copy(char *dst, uint64_t at, uint32_t len);
+};
+
+#endif
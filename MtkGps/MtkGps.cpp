@@ -26,8 +26,28 @@
 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
 */
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
 #include "MtkGps.h"
 
+#ifndef __ARDUINO_X86__
+// host build, Arduino timing the library uses
+static uint32_t millis(void)
+{
+	return (uint32_t)(lat_clock() / 1000000);
+}
+
+static void delay(uint32_t msec)
+{
+	usleep(msec * 1000);
+}
+#endif
+
 /*
 	Galileo library for GPS units compatible with MediaTek PMTK protocol,
 	tested with the Adafruit Ultimate GPS GTop module using MTK3399 chipset
@@ -35,19 +55,29 @@
 	https://learn.adafruit.com/adafruit-ultimate-gps
 */
 
+// counters have only one writer, the thread reading GPS serial port,
+// so relaxed load and store are enough to keep readers consistent
+#define STAT_ADD(x, n) __atomic_store_n(&(x), __atomic_load_n(&(x), __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+#define STAT_INC(x) STAT_ADD(x, 1)
+
 static const char *bin_off = "\x24\x0E\x00\xFD\x00\x00\x00\x00\x00\x00\xF3\x0D\x0A";
 
 MtkGps::MtkGps(int tzone)
 {
 	cidx = 0;
 	brate = PMTK_BR_INVALID;
-	gpsSerial = NULL;
+	port = NULL;
+	rlen = roff = 0;
+	recorder = NULL;
 	release = NULL;
 	latitude = longitude = 0.0;
 	valid = 0;
-	rx = tx = 0;
+	trunc = 0;
+	memset(&stat, 0, sizeof(stat));
 	fix_date = fix_time = fix_msec = 0;
 	this->tzone = tzone;
+	tcache.date = 0;
+	tcache.days = 0;
 
 	memset(&rmc, 0, sizeof(rmc));
 	memset(&gga, 0, sizeof(gga));
@@ -61,19 +91,60 @@ MtkGps::MtkGps(int tzone)
 
 	memset(cmd, 0, MAX_NMEA_LEN);
 	memset(nmea, 0, MAX_NMEA_LEN);
+
+	handler = NULL;
+	hdata = NULL;
+	filter = NULL;
+	t_sof = t_eol = t_parsed = 0;
+	resetLatency();
+
+	qhead = qsent = qtail = 0;
+	qwindow = PMTK_WINDOW;
+	qtimeout = PMTK_REPLY_MSEC;
+	qfailed = 0;
+	cmd_delay = 10;
+	qhandler = NULL;
+	qdata = NULL;
 }
 
+#ifdef __ARDUINO_X86__
 TTYUARTClass *MtkGps::attach(TTYUARTClass *ser)
 {
-	TTYUARTClass *curPort = gpsSerial;
-	gpsSerial = ser;
+	TTYUARTClass *curPort = uartPort.attach(ser);
+	attach(ser ? &uartPort : NULL);
 	return curPort;
 }
+#endif
+
+int MtkGps::attach(int fd)
+{
+	int curFd = ttyPort.attach(fd);
+	if (fd >= 0)
+		attach(&ttyPort);
+	else if (port == &ttyPort)
+		attach((GpsPort *)NULL);
+	return curFd;
+}
+
+GpsPort *MtkGps::attach(GpsPort *port)
+{
+	GpsPort *curPort = this->port;
+	this->port = port;
+	rlen = roff = 0;
+	return curPort;
+}
+
 void MtkGps::setTimeZone(int tzone)
 {
 	this->tzone = tzone;
 }
 
+void MtkGps::setHandler(nmeaHandler *handler, void *data)
+{
+	this->handler = handler;
+	hdata = data;
+}
+
 // 14400 commented out as some strange things happened
 // when this speed was used
 static uint32_t brates[] = {
@@ -86,10 +157,8 @@ int MtkGps::begin(uint32_t baud)
 {
 	for(int i = 0; brates[i] != PMTK_BR_INVALID; i++) {
 		if (baud == brates[i]) {
-			if (gpsSerial) {
-				gpsSerial->begin(baud);
-				delay(10);
-			}
+			if (port)
+				port->begin(baud);
 			brate = baud;
 			return 0;
 		}
@@ -97,14 +166,24 @@ int MtkGps::begin(uint32_t baud)
 	return -1;
 }
 
+#ifdef __ARDUINO_X86__
 uint32_t MtkGps::detect(TTYUARTClass *ser)
+{
+	if (ser == NULL)
+		return PMTK_BR_INVALID;
+
+	GpsUartPort uart(ser);
+	return detect(&uart);
+}
+#endif
+
+uint32_t MtkGps::detect(GpsPort *ser)
 {
 	if (ser == NULL)
 		return PMTK_BR_INVALID;
 	
-	// store current serial port
-	TTYUARTClass *gps = gpsSerial;
-	gpsSerial = ser;
+	// store current port
+	GpsPort *gps = attach(ser);
 	uint32_t rate = brate;
 
 	int br;
@@ -125,8 +204,8 @@ uint32_t MtkGps::detect(TTYUARTClass *ser)
 	}
 
 found:
-	// restore original serial port
-	gpsSerial = gps;
+	// restore original port
+	attach(gps);
 	begin(rate);
 	
 	return brates[br];
@@ -178,10 +257,49 @@ int MtkGps::getMtkPType(const char *nmea)
 
 int MtkGps::parse_nmea(const char *str) 
 {
-	if (!nmea_is_valid(str))
+	if (!nmea_is_valid(str)) {
+		STAT_INC(stat.crc_errors);
 		return -1;
+	}
+
+	int nmea_type = nmea_get_type(str);
+	int idx = nmea_type_index(nmea_type);
+	// read stage is known only for sentences assembled by read()
+	bool own = (str == nmea);
+	uint64_t t_start = own ? t_eol : lat_clock();
 
-	int ret, nmea_type = nmea_get_type(str);
+	int ret = parse(str, nmea_type);
+	t_parsed = lat_clock();
+	if (ret != 0) {
+		STAT_INC(stat.parse_errors[idx]);
+		return ret;
+	}
+	if (nmea_type == NMEA_INVALID)
+		STAT_INC(stat.unknown);
+	else
+		STAT_INC(stat.sentences[idx]);
+
+	lat_hist_t *lat = latency[idx];
+	if (own)
+		lat_hist_add_span(&lat[LAT_READ], t_sof, t_eol);
+	lat_hist_add_span(&lat[LAT_PARSE], t_start, t_parsed);
+
+	if (handler && (filter == NULL || filter->update(this, nmea_type))) {
+		handler(this, nmea_type, hdata);
+		uint64_t t_done = lat_clock();
+		lat_hist_add_span(&lat[LAT_CALLBACK], t_parsed, t_done);
+		if (own)
+			lat_hist_add_span(&lat[LAT_TOTAL], t_sof, t_done);
+	}
+	else if (own)
+		lat_hist_add_span(&lat[LAT_TOTAL], t_sof, t_parsed);
+
+	return 0;
+}
+
+int MtkGps::parse(const char *str, int nmea_type)
+{
+	int ret;
 
 	if (nmea_type == NMEA_SEN_GGA) {
 		ret = nmea_parse_gpgga(str, &gga);
@@ -267,7 +385,9 @@ int MtkGps::parse_nmea(const char *str)
 
 	// firmware release info
 	if (nmea_type == NMEA_SEN_MTK) {
-		int type = getMtkPType(nmea);
+		int type = getMtkPType(str);
+		if (qsent != qtail)
+			reply(str, type);
 		if (type == PMTK_DT_RELEASE) {
 			if (release != NULL)
 				free((void *)release);
@@ -283,31 +403,78 @@ int MtkGps::parse_nmea(const char *str)
 
 const char *MtkGps::read(void)
 {
-	if (gpsSerial == NULL || !gpsSerial->available())
-		return NULL;
+	serveCommands();
+
+	// read in blocks, one sentence per call
+	while(1) {
+		if (roff == rlen) {
+			int len = port ? port->read(rbuf, sizeof(rbuf)) : 0;
+			if (len <= 0)
+				return NULL;
+			if (recorder)
+				gpsrec_write(recorder, rbuf, len);
+			rlen = len;
+			roff = 0;
+		}
+		while(roff < rlen) {
+			const char *str = frame(rbuf[roff++]);
+			if (str)
+				return str;
+		}
+	}
+}
 
-	char c = gpsSerial->read();
-	rx++;
+const char *MtkGps::frame(char c)
+{
+	STAT_INC(stat.rx);
 	// reset line if '$' received from MTK3339
-	if (c == '$')
+	if (c == '$') {
+		// previous line was not terminated
+		if (cidx)
+			STAT_ADD(stat.discarded, cidx);
 		cidx = 0;
+		trunc = 0;
+		t_sof = lat_clock();
+	}
+	else if (cidx == 0) {
+		// not inside of '$'...EOL
+		STAT_INC(stat.discarded);
+		return NULL;
+	}
 
 	// EOL received, return full nmea line ready to be parsed
 	if (c == '\n') {
+		t_eol = lat_clock();
 		nmea[cidx] = '\0';
 		cidx = 0;
+		if (trunc) {
+			STAT_INC(stat.truncated);
+			trunc = 0;
+			return NULL;
+		}
 		return nmea;
 	}
 
 	if (cidx < (MAX_NMEA_LEN - 1))
 		nmea[cidx++] = c;
+	else
+		trunc = 1;
 
 	return NULL;
 }
 
+int MtkGps::sendStr(const char *str)
+{
+	if (send_str(str) != 0)
+		return -1;
+	if (cmd_delay)
+		delay(cmd_delay);
+	return 0;
+}
+
 // copy str to internal last command buffer,
 // calculate CRC, append to the string and send to serial port
-int MtkGps::sendStr(const char *str)
+int MtkGps::send_str(const char *str)
 {
 	if (*str != '$')
 		return -1;
@@ -319,13 +486,17 @@ int MtkGps::sendStr(const char *str)
 	for(int i = 1; *str && i < (sizeof(cmd) - 4); i++) {
 		crc ^= *str;
 		*ptr++ = *str++;
-		tx++;
 	}
-	sprintf(ptr, "*%02X", crc);
-	tx += 5; // '*XX<CR><LF>
-	if (gpsSerial) {
-		gpsSerial->println(cmd);
-		delay(10);
+	ptr += sprintf(ptr, "*%02X", crc);
+	STAT_ADD(stat.tx, (ptr - cmd) + 2); // <CR><LF>
+	if (port) {
+		// one write, so the command is not split
+		char line[MAX_NMEA_LEN + 2];
+		int len = ptr - cmd;
+		memcpy(line, cmd, len);
+		line[len++] = '\r';
+		line[len++] = '\n';
+		port->write(line, len);
 	}
 
 	return 0;
@@ -333,27 +504,31 @@ int MtkGps::sendStr(const char *str)
 
 int MtkGps::write(const void *data, uint32_t len)
 {
-	if (gpsSerial)
-		return gpsSerial->write((const uint8_t *)data, len);
-	tx += len;
+	STAT_ADD(stat.tx, len);
+	if (port)
+		return port->write(data, len);
 	return 0;
 }
 
 void MtkGps::getPortStat(uint32_t *rxstat, uint32_t *txstat)
 {
 	if (rxstat)
-		*rxstat = rx;
+		*rxstat = __atomic_load_n(&stat.rx, __ATOMIC_RELAXED);
 	if (txstat)
-		*txstat = tx;
+		*txstat = __atomic_load_n(&stat.tx, __ATOMIC_RELAXED);
 }
 
-// arg >= 0, not used if  < 0
-char *MtkGps::sendCommand(unsigned cmd, int arg)
+void MtkGps::getStat(gps_stat_t *snap)
 {
-	char str[64];
+	const uint32_t *src = (const uint32_t *)&stat;
+	uint32_t *dst = (uint32_t *)snap;
 
-	if (cmd > 999)
-		return "Invalid command\n";
+	for(uint32_t i = 0; i < sizeof(gps_stat_t)/sizeof(uint32_t); i++)
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+}
+
+static void format_cmd(char *str, unsigned cmd, int arg)
+{
 	if (cmd == PCMD_ANTENNA)
 		sprintf(str, "$PGCMD,%d,%d", cmd, arg);
 	else {
@@ -362,11 +537,184 @@ char *MtkGps::sendCommand(unsigned cmd, int arg)
 		else
 			sprintf(str, "$PMTK%03d", cmd);
 	}
+}
+
+// arg >= 0, not used if  < 0
+char *MtkGps::sendCommand(unsigned cmd, int arg)
+{
+	char str[64];
+
+	if (cmd > 999)
+		return "Invalid command\n";
+	format_cmd(str, cmd, arg);
 
 	sendStr(str);
 	return str;
 }
 
+#define QUEUE_MASK  (PMTK_QUEUE_LEN - 1)
+#define REQ_WAITING -2
+
+// PMTK number of the reply to the command, 0 if there is no reply
+static uint16_t pmtk_reply(unsigned cmd)
+{
+	// restart commands reply with PMTK010 system message
+	if (cmd >= PMTK_CMD_HOT_START && cmd <= PMTK_CMD_FACTORY_RESET)
+		return 0;
+	// reply comes at the new baud rate
+	if (cmd == PMTK_SET_NMEA_BAUD_RATE)
+		return 0;
+	// queries are replied with data, PMTK4xx -> PMTK5xx, PMTK6xx -> PMTK7xx
+	if ((cmd >= 400 && cmd < 500) || (cmd >= 600 && cmd < 700))
+		return cmd + 100;
+	return PMTK_ACK;
+}
+
+int MtkGps::queueStr(const char *str)
+{
+	pmtk_req *req;
+
+	if (*str != '$' || strlen(str) >= sizeof(req->str))
+		return -1;
+	if (pendingCommands() >= PMTK_QUEUE_LEN)
+		return -1;
+
+	req = &queue[qhead & QUEUE_MASK];
+	strcpy(req->str, str);
+	if (strncmp(str, "$PMTK", 5) == 0 && isdigit(str[5])) {
+		req->cmd = atoi(str + 5);
+		req->reply = pmtk_reply(req->cmd);
+	}
+	else {
+		// $PGCMD and others, not acknowledged
+		req->cmd = 0;
+		req->reply = 0;
+	}
+	req->retries = 0;
+	req->ack = REQ_WAITING;
+	qhead++;
+
+	serve_queue();
+	return 0;
+}
+
+int MtkGps::queueCommand(unsigned cmd, int arg)
+{
+	char str[64];
+
+	if (cmd > 999)
+		return -1;
+	format_cmd(str, cmd, arg);
+	return queueStr(str);
+}
+
+void MtkGps::setCommandWindow(uint8_t window, uint32_t timeout)
+{
+	if (window == 0)
+		window = 1;
+	if (window > PMTK_QUEUE_LEN)
+		window = PMTK_QUEUE_LEN;
+	qwindow = window;
+	qtimeout = timeout;
+}
+
+void MtkGps::setCommandHandler(pmtkHandler *handler, void *data)
+{
+	qhandler = handler;
+	qdata = data;
+}
+
+void MtkGps::done(pmtk_req *req, int ack)
+{
+	req->ack = ack;
+	if (ack != PMTK_ACK_OK)
+		qfailed++;
+	if (qhandler)
+		qhandler(this, req->str, ack, qdata);
+}
+
+void MtkGps::serve_queue(void)
+{
+	uint32_t now = millis();
+	pmtk_req *req;
+	uint8_t i;
+
+	// resend or fail commands not replied in time
+	for(i = qtail; i != qsent; i++) {
+		req = &queue[i & QUEUE_MASK];
+		if (req->ack != REQ_WAITING || (now - req->sent) < qtimeout)
+			continue;
+		if (req->retries < PMTK_RETRIES) {
+			req->retries++;
+			req->sent = now;
+			send_str(req->str);
+		}
+		else
+			done(req, PMTK_ACK_TIMEOUT);
+	}
+
+	while(1) {
+		while(qtail != qsent && queue[qtail & QUEUE_MASK].ack != REQ_WAITING)
+			qtail++;
+		if (qsent == qhead || (uint8_t)(qsent - qtail) >= qwindow)
+			break;
+		req = &queue[qsent & QUEUE_MASK];
+		req->sent = now;
+		send_str(req->str);
+		qsent++;
+		if (req->reply == 0)
+			done(req, PMTK_ACK_OK);
+	}
+}
+
+// PMTK001 or query reply received
+void MtkGps::reply(const char *str, int type)
+{
+	const char *arg;
+	unsigned cmd = 0;
+	int ack = PMTK_ACK_OK;
+	pmtk_req *req;
+	uint8_t i;
+
+	if (type == PMTK_ACK) {
+		// $PMTK001,cmd,flag
+		if ((arg = strchr(str, ',')) == NULL)
+			return;
+		cmd = atoi(arg + 1);
+		if ((arg = strchr(arg + 1, ',')) != NULL)
+			ack = atoi(arg + 1);
+	}
+
+	for(i = qtail; i != qsent; i++) {
+		req = &queue[i & QUEUE_MASK];
+		if (req->ack != REQ_WAITING || req->reply != type)
+			continue;
+		if (type != PMTK_ACK || req->cmd == cmd) {
+			done(req, ack);
+			break;
+		}
+	}
+	serve_queue();
+}
+
+int MtkGps::waitCommands(uint32_t timeout)
+{
+	uint32_t start = millis();
+	int ret;
+
+	while(pendingCommands() && (millis() - start) < timeout) {
+		const char *str = read();
+		if (str)
+			parse_nmea(str);
+		else if (port == NULL || !port->available())
+			delay(1);
+	}
+
+	ret = (pendingCommands() || qfailed) ? -1 : 0;
+	qfailed = 0;
+	return ret;
+}
+
 #define MTK3339_NMEA 19
 
 static const uint32_t output_mask[MTK3339_NMEA] = {
@@ -472,6 +820,21 @@ int MtkGps::setEasyMode(uint8_t arg)
 	return 0;
 }
 
+const lat_hist_t *MtkGps::getLatency(int nmea_type, int stage)
+{
+	if (stage < 0 || stage >= LAT_STAGES)
+		return NULL;
+	return &latency[nmea_type_index(nmea_type)][stage];
+}
+
+void MtkGps::resetLatency(void)
+{
+	for(int i = 0; i < NMEA_NTYPES; i++) {
+		for(int n = 0; n < LAT_STAGES; n++)
+			lat_hist_reset(&latency[i][n]);
+	}
+}
+
 const char *MtkGps::getFWrelease(void)
 {
 	if (release == NULL)
@@ -481,17 +844,45 @@ const char *MtkGps::getFWrelease(void)
 
 void MtkGps::getFixTime(struct tm *fix, uint16_t *millis)
 {
-	fix->tm_hour = fix_time / 10000;
-	fix->tm_min  = (fix_time % 10000) / 100;
-	fix->tm_min  += tzone;
-	fix->tm_sec  = (fix_time % 100);
-	fix->tm_mday = fix_date / 10000;
-	fix->tm_mon  = (fix_date % 10000) / 100;
-	fix->tm_year = (fix_date % 100);
-
-	if (tzone)
-		mktime(fix);
+	if (fix_date) {
+		int64_t ns = gps_time_ns(&tcache, fix_date, fix_time, 0);
+		gps_time_tm(ns + tzone * GPS_NSEC_PER_MIN, fix);
+		// keep NMEA style month and year
+		fix->tm_mon += 1;
+		fix->tm_year %= 100;
+	}
+	else {
+		// no date, apply time zone offset to the time of day only
+		int32_t sec = (fix_time / 10000) * 3600 + ((fix_time / 100) % 100) * 60 +
+			fix_time % 100 + tzone * 60;
+		sec %= 86400;
+		if (sec < 0)
+			sec += 86400;
+		memset(fix, 0, sizeof(struct tm));
+		fix->tm_hour = sec / 3600;
+		fix->tm_min  = (sec / 60) % 60;
+		fix->tm_sec  = sec % 60;
+	}
 
 	if (millis)
 		*millis = fix_msec;
 }
+
+int64_t MtkGps::getFixTimeNs(void)
+{
+	if (fix_date == 0)
+		return 0;
+	return gps_time_ns(&tcache, fix_date, fix_time, fix_msec);
+}
+
+int MtkGps::getFixTimeStr(char *buf, bool local)
+{
+	int64_t ns = getFixTimeNs();
+
+	// no RMC/ZDA date yet, do not pretend it is 1970
+	if (ns == 0) {
+		buf[0] = '\0';
+		return -1;
+	}
+	return gps_time_iso8601(buf, ns, local ? tzone : 0, 3);
+}
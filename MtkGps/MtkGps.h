@@ -36,9 +36,15 @@
 	https://learn.adafruit.com/adafruit-ultimate-gps
 */
 
-#include <Arduino.h>
-#include "TTYUART.h"
+#include <stdint.h>
+#include <time.h>
+
+#include "GpsPort.h"
 #include "nmea.h"
+#include "lathist.h"
+#include "gpstime.h"
+#include "gpsrec.h"
+#include "GpsFilter.h"
 
 // ON/OFF arguments
 #define PMTK_ARG_ON		1
@@ -153,26 +159,87 @@
 #define PMTK_DT_LOCUS_LOG	   1000 // reserved for $PMTKLOG
 
 #define MAX_NMEA_LEN 256
+#define GPS_READ_LEN 1024 // port is read in blocks up to this size
+
+// latency histogram stages, see getLatency()
+#define LAT_READ     0 // '$' received to EOL received
+#define LAT_PARSE    1 // EOL received to parsing done
+#define LAT_CALLBACK 2 // time spent in nmeaHandler
+#define LAT_TOTAL    3 // '$' received to nmeaHandler returned
+#define LAT_STAGES   4
+
+// receiver and parser counters, see getStat()
+// all fields are uint32_t so a snapshot can be taken field by field
+typedef struct gps_stat_s
+{
+	uint32_t rx;          // received bytes
+	uint32_t tx;          // transmitted bytes
+	uint32_t discarded;   // bytes received outside of '$'...EOL
+	uint32_t truncated;   // lines longer than MAX_NMEA_LEN
+	uint32_t crc_errors;  // sentences with invalid checksum
+	uint32_t unknown;     // valid sentences of unsupported type
+	uint32_t sentences[NMEA_NTYPES];    // parsed sentences by NMEA_IDX_*
+	uint32_t parse_errors[NMEA_NTYPES]; // nmea_parse_* failures by NMEA_IDX_*
+} gps_stat_t;
+
+// PMTK001 acknowledge flags, PMTK_ACK_TIMEOUT if there was no reply
+#define PMTK_ACK_INVALID     0 // invalid command
+#define PMTK_ACK_UNSUPPORTED 1 // unsupported command
+#define PMTK_ACK_FAILED      2 // valid command, but action failed
+#define PMTK_ACK_OK          3 // valid command, action succeeded
+#define PMTK_ACK_TIMEOUT    -1
+
+// command queue, see queueCommand()
+#define PMTK_QUEUE_LEN    16   // queued commands, power of 2
+#define PMTK_WINDOW       4    // default commands waiting for reply
+#define PMTK_REPLY_MSEC   1000 // default reply timeout
+#define PMTK_RETRIES      1    // resend commands not replied in time
+
+class MtkGps;
+
+// called for every successfully parsed sentence, nmea_type is NMEA_SEN_*
+typedef void nmeaHandler(MtkGps *gps, int nmea_type, void *data);
+// called for every queued command replied or timed out, ack is PMTK_ACK_*
+typedef void pmtkHandler(MtkGps *gps, const char *cmd, int ack, void *data);
 
 class MtkGps {
 public:
 	// initializations only, use attach() to select serial port
 	MtkGps(int tzone = 0); // time zone offset from UTC in minutes
 
+#ifdef __ARDUINO_X86__
 	// attach to a serial port 
 	// on Galileo Serial is USB, Serial1 is RX0/TX1, Serial2 RS232/TTL headers
 	TTYUARTClass *attach(TTYUARTClass *ser);
+#endif
+	// attach to a serial port file descriptor, see tty_open()
+	// returns previous descriptor or -1
+	int attach(int fd);
+	// attach to any transport, see GpsPort.h; returns previous port
+	GpsPort *attach(GpsPort *port);
+	GpsPort *getPort(void) { return port; }
+	// attached file descriptor or -1
+	int fd(void) { return port ? port->fd() : -1; }
 	
 	// time zone offset from UTC in minutes
 	void setTimeZone(int tzone);
 	// get last fix date/time in struct tm and milliseconds to msec
 	// date valid only if RMC/ZDA sentences are configured for NMEA output
+	// note: tm_mon is 1-12 and tm_year is two digits year as in NMEA
 	void getFixTime(struct tm *fix, uint16_t *msec = NULL);
+	// get last fix date/time as UTC nanoseconds since Epoch, 0 if no date
+	int64_t getFixTimeNs(void);
+	// get last fix date/time as ISO-8601 string, buf size is GPS_ISO8601_LEN
+	// returns string length, -1 and empty string if no date yet
+	int getFixTimeStr(char *buf, bool local = false);
 
 	// set serial port baud rate
 	int begin(uint32_t baud);
 	// detect if MTK is attached, returns baud rate detected or PMTK_BR_INVALID
+	uint32_t detect(GpsPort *port);
+#ifdef __ARDUINO_X86__
 	uint32_t detect(TTYUARTClass *ser);
+#endif
 	// set GPS communication speed
 	int setNmeaBaudRate(uint32_t baud);
 	// get GPS communication speed
@@ -182,12 +249,38 @@ public:
 
 	// get RX/TX statistics
 	void getPortStat(uint32_t *rxstat, uint32_t *txstat = NULL);
+	// snapshot of receiver and parser counters, safe to call from any thread
+	void getStat(gps_stat_t *snap);
 	// str checksum will be calculated while sending
 	int sendStr(const char *str);
 	// write whatever to GPS module...
 	int write(const void *data, uint32_t len);
 	// send PMTK_* command with an argument
 	char *sendCommand(unsigned cmd, int arg = -1);
+	// delay after sendStr()/sendCommand(), 10 msec by default
+	void setCommandDelay(uint32_t msec) { cmd_delay = msec; }
+
+	// queued commands are sent without delays: up to 'window' commands
+	// are waiting for PMTK001 or query reply, next one is sent as soon as
+	// a reply arrives; not replied in 'timeout' msec are resent once.
+	// Queue is served by read(), returns 0 or -1 if queue is full
+	int queueStr(const char *str);
+	// resend timed out and send next queued commands, called by read();
+	// if port is read by other means (frame(), GpsEngine, event loop)
+	// call it periodically, for example from a timer
+	void serveCommands(void) { if (qhead != qtail) serve_queue(); }
+	int queueCommand(unsigned cmd, int arg = -1);
+	void setCommandWindow(uint8_t window, uint32_t timeout = PMTK_REPLY_MSEC);
+	uint8_t  getCommandWindow(void) { return qwindow; }
+	uint32_t getCommandTimeout(void) { return qtimeout; }
+	// called for every queued command done
+	void setCommandHandler(pmtkHandler *handler, void *data = NULL);
+	// commands queued or waiting for reply
+	unsigned pendingCommands(void) { return (uint8_t)(qhead - qtail); }
+	// read GPS until all queued commands are replied, up to timeout msec;
+	// returns 0 if all commands since the last call succeeded
+	int waitCommands(uint32_t timeout);
+
 	// output configuration, each mask presents which NMEA_SEN_* should be
 	// generated every 1, 2, 3, 4 or 5 position fixes
 	char *setOutput(uint32_t mask1, uint32_t mask2 = 0, uint32_t mask3 = 0, uint32_t mask4 = 0, uint32_t mask5 = 0);
@@ -200,10 +293,23 @@ public:
 	// get fix quality as a string
 	const char *getFixQuality(void);
 
-	// read serial port, returns NULL or nmea sentence read
+	// read attached port, returns NULL or nmea sentence read
 	const char *read(void);
+	// process one byte received from GPS module, returns NULL or nmea sentence
+	// use it if serial port is read by other means than read()
+	const char *frame(char c);
+	// record raw data read by read() to 'rec', NULL to stop recording;
+	// if serial port is read by other means pass blocks read to record()
+	void setRecorder(gpsrec_t *rec) { recorder = rec; }
+	gpsrec_t *getRecorder(void) { return recorder; }
+	void record(const void *data, unsigned len) { if (recorder) gpsrec_write(recorder, data, len); }
 	// parses nmea sentence
 	int parse_nmea(const char *nmea);
+	// set handler to be called for every parsed sentence
+	void setHandler(nmeaHandler *handler, void *data = NULL);
+	// call handler only for sentences passed by 'filter', NULL to call it always
+	void setFilter(GpsFilter *filter) { this->filter = filter; }
+	GpsFilter *getFilter(void) { return filter; }
 	// get PMTP packet type from the string
 	int getMtkPType(const char *nmea);
 	// check if NMEA_SEN_* type  data is populated
@@ -213,6 +319,14 @@ public:
 	// get firmware release information string
 	const char *getFWrelease(void);
 
+	// CLOCK_MONOTONIC nanoseconds when '$' of the last sentence was
+	// received and when parsing of the last sentence was finished
+	uint64_t getArrivalTime(void) { return t_sof; }
+	uint64_t getParsedTime(void) { return t_parsed; }
+	// latency histogram for NMEA_SEN_* type and LAT_* stage
+	const lat_hist_t *getLatency(int nmea_type, int stage);
+	void resetLatency(void);
+
 	// lat and lon in signed degree format DDD.dddddddd
 	double latitude, longitude;
 
@@ -225,25 +339,71 @@ public:
 	gpzda_t  zda;
 	uint16_t ngsv;
 	gpgsv_t  gsv[NMEA_MAX_GSV];
+	// GSV satellites parsed so far, ngsv when the group is complete
+	uint16_t getGsvIndex(void) { return igsv; }
 	mtkchn_t chn[MTK_MAX_CHN];
 
 	char cmd[MAX_NMEA_LEN]; // last command sent to GPS module
 
 private:
-	// serial port GPS module is attached to
-	TTYUARTClass *gpsSerial;
+	int parse(const char *nmea, int nmea_type);
+
+	// port GPS module is attached to, one of own ports or user's
+	GpsPort *port;
+	GpsTtyPort ttyPort;
+#ifdef __ARDUINO_X86__
+	GpsUartPort uartPort;
+#endif
+	uint16_t rlen; // data read from port but not framed yet
+	uint16_t roff;
+	char rbuf[GPS_READ_LEN];
+	gpsrec_t *recorder;
 	uint32_t fix_date; // latest fix date/time
 	uint32_t fix_time;
 	uint32_t fix_msec;
 	int      tzone;	// offset to UTC in minutes
+	gpstime_t tcache; // last fix date to days conversion
 	uint32_t valid; // mask of populated nmea sentences
 	uint32_t brate;	// serial port baud rate
-	uint32_t rx;	// received bytes
-	uint32_t tx;	// transmitted bytes
+	gps_stat_t stat;
 	uint32_t cidx;	// nmea string holder 
+	uint32_t trunc; // current line is longer than MAX_NMEA_LEN
 	uint16_t igsv;	// GSV parsing index
 	const char *release;
 	char nmea[MAX_NMEA_LEN]; // last nmea sentence received from GPS module
+
+	nmeaHandler *handler;
+	void *hdata;
+	GpsFilter *filter;
+
+	// queued command, reply is PMTK number expected in reply to it
+	struct pmtk_req {
+		uint16_t cmd;
+		uint16_t reply;
+		uint8_t  retries;
+		int8_t   ack;
+		uint32_t sent;
+		char str[64];
+	};
+	pmtk_req queue[PMTK_QUEUE_LEN];
+	uint8_t  qhead; // next free
+	uint8_t  qsent; // next to send
+	uint8_t  qtail; // oldest not replied
+	uint8_t  qwindow;
+	uint32_t qtimeout;
+	uint32_t qfailed; // failed commands since waitCommands()
+	uint32_t cmd_delay;
+	pmtkHandler *qhandler;
+	void *qdata;
+
+	int  send_str(const char *str);
+	void serve_queue(void);
+	void reply(const char *str, int type);
+	void done(pmtk_req *req, int ack);
+	uint64_t t_sof;    // '$' received
+	uint64_t t_eol;    // EOL received
+	uint64_t t_parsed; // parsing done
+	lat_hist_t latency[NMEA_NTYPES][LAT_STAGES];
 };
 
 #endif
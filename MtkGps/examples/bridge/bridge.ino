@@ -30,6 +30,10 @@
 
 #include <MtkGps.h>
 #include <SerialTerminal.h>
+#include <ttyfd.h>
+#include <eventloop.h>
+#include <serialbridge.h>
+#include <logring.h>
 
 /* 
 	Bridge RX0/TX1 serial ports to USB serial for connecting to skyplot software
@@ -40,18 +44,39 @@
 
 MtkGps gps;
 
+#define GPS_DEV "/dev/ttyS0" // Serial1, RX0/TX1
+#define USB_DEV "/dev/ttyGS0" // Serial, USB
+
+// loop sleeps until one of the ports has data
+EventLoop evloop;
+// moves data between GPS (A) and USB (B) in blocks
+SerialBridge bridge;
+
 // default baud rate for skyplot is 38400
 // for firmware update and EPO use PMTK_BR_9600
 #define BRIDGE_BAUD PMTK_BR_38400
 
-// set to 1 to monitor bridge data on RS232/TTL serial port
-// set it to 0 for firmware update or for EPO uploading 
-// to avoid a lot binary dumps on monitoring terminal
+// set to 1 to monitor bridge data on RS232/TTL serial port;
+// monitoring never slows the bridge down, if the monitoring thread
+// falls behind data is dropped from the log and the gap is reported,
+// so it can be left on for firmware update or EPO uploading
 #define MONITOR_BRIDGE 1
 
 #if MONITOR_BRIDGE
 
 #define MAX_MONITOR_LEN 256
+#define STAT_PERIOD 10000 // msec, bridge statistics on monitoring port
+#define MONITOR_LOG 65536 // bytes of bridge data monitoring thread may lag behind
+#define MONITOR_NICE 10   // monitoring thread priority, relative to the loop
+#define MONITOR_STAT 2    // log chunk with bridge statistics, 0 and 1 are directions
+
+void on_monitor(int dir, const char *block, unsigned len, void *data);
+void on_log(const logchunk_t *chunk, const char *data, void *arg);
+int  on_stat(void *data);
+wtimer_t stat_timer(on_stat);
+
+// bridge data to monitoring thread
+logring_t mlog;
 
 SerialTerminal term(MAX_MONITOR_LEN+2);
 
@@ -66,18 +91,22 @@ char str_sw[MAX_MONITOR_LEN+2];
 
 void setup()
 {
-	Serial.begin(BRIDGE_BAUD); // Galileo USB serial, connected to external SW
 #if MONITOR_BRIDGE
 	term.attach(&Serial2);
 	term.begin(PMTK_BR_115200); // RS232/TTL headers for monitoring
+	// 115200 baud shows about 2.5KB of binary data per second as hex dump,
+	// skip the rest rather than fall behind the bridge
+	term.dumpRate(2048);
+	logring_init(&mlog, MONITOR_LOG);
 #endif
 	// detect MTK baud rate
 	uint32_t gpsbr = gps.detect(&Serial1);
 	if (gpsbr == PMTK_BR_INVALID)
 		gpsbr = PMTK_BR_9600;
 
-	Serial1.begin(gpsbr);
-	gps.attach(&Serial1);
+	// talk to GPS through non-blocking descriptor, so the loop can wait on it
+	Serial1.end();
+	gps.attach(tty_open(GPS_DEV, gpsbr));
 	// set default bridge baud rate
 	if (gpsbr != BRIDGE_BAUD) {
 		gps.setNmeaBaudRate(BRIDGE_BAUD);
@@ -88,90 +117,150 @@ void setup()
 	gps.setEasyMode(PMTK_ARG_ON);
 	gps.setOutput(NMEA_SEN_RMC | NMEA_SEN_GSA | NMEA_SEN_VTG | NMEA_SEN_GGA, 0, 0, NMEA_SEN_GSV);
 	gps.sendCommand(PMTK_SET_DGPS_MODE, PMTK_DGPS_WAAS);
+
+	// Galileo USB serial, connected to external SW; opened directly
+	// rather than through Serial so the bridge can wait on it
+	int usb = tty_open(USB_DEV, BRIDGE_BAUD);
+
+	evloop.begin();
+	bridge.begin(&evloop, gps.fd(), usb);
+#if MONITOR_BRIDGE
+	// terminal is used only by monitoring thread from now on
+	logring_start(&mlog, on_log, NULL, MONITOR_NICE);
+	bridge.setMonitor(on_monitor);
+	evloop.start(&stat_timer, STAT_PERIOD, STAT_PERIOD);
+#endif
 }
 
 int binary = 0;
 
-void loop()
+#if MONITOR_BRIDGE
+// clone data from GPS to monitoring port
+static void monitor_gps(char c)
 {
-	char c;
+	if (c == '$')
+		igps = 0;
+	// check for EOL
+	if (c == 0x0A) {
+		if (binary && (igps > 0) && str_gps[igps-1] != 0x0D)
+			goto insert_gps;
+		str_gps[igps++] = c;
+		str_gps[igps] = '\0';
 
-	// copy data from gps to the second serial port
-	while(Serial1.available()) {
-		c = Serial1.read();
-		Serial.print(c);
-#if MONITOR_BRIDGE
-		if (c == '$')
-			igps = 0;
-		// check for EOL
-		if (c == 0x0A) {
-			if (binary && (igps > 0) && str_gps[igps-1] != 0x0D)
-				goto insert_gps;
-			str_gps[igps++] = c;
-			str_gps[igps] = '\0';
-
-			// turn off binary if PMTK text received
-			if (binary && (nmea_get_type(str_gps) == NMEA_SEN_MTK))
-				binary = 0;
-			// clone output to monitoring port
-			if (!binary)
-				term.print(">%s", str_gps); // clone output to monitoring port
-			else
-				term.dump(">", str_gps, igps);
-			igps = 0;
-			continue;
-		}
-insert_gps:
-		if (c != 0x0D && !isprint(c) && !binary)
-			c = '.';
-		if (igps < MAX_MONITOR_LEN)
-			str_gps[igps++] = c; {
-			continue;
-		}
+		// turn off binary if PMTK text received
+		if (binary && (nmea_get_type(str_gps) == NMEA_SEN_MTK))
+			binary = 0;
 		// clone output to monitoring port
 		if (!binary)
-			term.print(">%s\n", str_gps); // clone output to monitoring port
+			term.print(">%s", str_gps); // clone output to monitoring port
 		else
 			term.dump(">", str_gps, igps);
 		igps = 0;
-#endif
+		return;
 	}
-	// copy data from the second serial port to gps
-	while(Serial.available()) {
-		c = Serial.read();
-		Serial1.print(c);
-#if MONITOR_BRIDGE
-		if (c == '$')
-			isw = 0;
-		// check for EOL
-		if (c == 0x0A) {
-			if (binary && (isw > 0) && (str_sw[isw-1] != 0x0D))
-				goto insert_sw;
-			str_sw[isw++] = c;
-			str_sw[isw] = '\0';
-			if (!binary) {
-				if (isw > 1) // some GPS utilities add extra 0x0A at the end, skip it
-					term.print("<%s", str_sw); // clone output to USB serial for monitoring
-			}
-			else
-				term.dump("<", str_sw, isw);
-			if (strncmp(str_sw, "$PMTK253,1,", 11) == 0)
-				binary = 1;
-			isw = 0;
-			continue;
+insert_gps:
+	if (c != 0x0D && !isprint(c) && !binary)
+		c = '.';
+	if (igps < MAX_MONITOR_LEN) {
+		str_gps[igps++] = c;
+		return;
+	}
+	// clone output to monitoring port
+	if (!binary)
+		term.print(">%s\n", str_gps); // clone output to monitoring port
+	else
+		term.dump(">", str_gps, igps);
+	igps = 0;
+}
+
+// clone data from external SW to monitoring port
+static void monitor_sw(char c)
+{
+	if (c == '$')
+		isw = 0;
+	// check for EOL
+	if (c == 0x0A) {
+		if (binary && (isw > 0) && (str_sw[isw-1] != 0x0D))
+			goto insert_sw;
+		str_sw[isw++] = c;
+		str_sw[isw] = '\0';
+		if (!binary) {
+			if (isw > 1) // some GPS utilities add extra 0x0A at the end, skip it
+				term.print("<%s", str_sw); // clone output to USB serial for monitoring
 		}
+		else
+			term.dump("<", str_sw, isw);
+		if (strncmp(str_sw, "$PMTK253,1,", 11) == 0)
+			binary = 1;
+		isw = 0;
+		return;
+	}
 insert_sw:
-		if (c != 0x0D && !isprint(c) && !binary)
-			c = '.';
-		if (isw < MAX_MONITOR_LEN)
-			str_sw[isw++] = c;
-		else {
-			if (!binary)
-				term.print("<%s\n", str_sw); // clone output to USB serial for monitoring
-			else
-				term.dump("<", str_sw, isw);
-			isw = 0;
-		}
+	if (c != 0x0D && !isprint(c) && !binary)
+		c = '.';
+	if (isw < MAX_MONITOR_LEN)
+		str_sw[isw++] = c;
+	else {
+		if (!binary)
+			term.print("<%s\n", str_sw); // clone output to USB serial for monitoring
+		else
+			term.dump("<", str_sw, isw);
+		isw = 0;
+	}
+}
 #endif
+
+#if MONITOR_BRIDGE
+// blocks forwarded by the bridge, A is GPS, B is USB; called on the
+// forwarding path, so only queue them for the monitoring thread
+void on_monitor(int dir, const char *block, unsigned len, void *data)
+{
+	logring_put(&mlog, dir, EventLoop::now(), block, len);
+}
+
+// queue statistics as well, terminal belongs to the monitoring thread
+int on_stat(void *data)
+{
+	bridge_stat_t st[2];
+
+	bridge.getStat(BRIDGE_A2B, &st[BRIDGE_A2B]);
+	bridge.getStat(BRIDGE_B2A, &st[BRIDGE_B2A]);
+	logring_put(&mlog, MONITOR_STAT, EventLoop::now(), st, sizeof(st));
+	return 0;
+}
+
+// monitoring thread, formats and prints the log
+void on_log(const logchunk_t *chunk, const char *data, void *arg)
+{
+	if (chunk->dropped) {
+		// partial lines are useless after a gap
+		igps = isw = 0;
+		term.print("%u: monitor dropped %lu bytes (%lu total)\n",
+			chunk->ts, (unsigned long)chunk->dropped, (unsigned long)mlog.dropped);
+	}
+
+	if (chunk->tag == MONITOR_STAT) {
+		const bridge_stat_t *st = (const bridge_stat_t *)data;
+		for(int dir = BRIDGE_A2B; dir <= BRIDGE_B2A; dir++, st++) {
+			term.print("%u: %s %lu bytes %lu B/s stalls %lu errors %lu latency %lu/%lu/%lu usec\n",
+				chunk->ts, dir == BRIDGE_A2B ? "gps>usb" : "usb>gps",
+				(unsigned long)st->bytes, (unsigned long)st->rate,
+				(unsigned long)st->stalls, (unsigned long)st->errors,
+				(unsigned long)st->lat_min, (unsigned long)st->lat_avg, (unsigned long)st->lat_max);
+		}
+		return;
+	}
+
+	for(unsigned i = 0; i < chunk->len; i++) {
+		if (chunk->tag == BRIDGE_A2B)
+			monitor_gps(data[i]);
+		else
+			monitor_sw(data[i]);
 	}
 }
+#endif
+
+void loop()
+{
+	evloop.run();
+}
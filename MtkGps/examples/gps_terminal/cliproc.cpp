@@ -30,6 +30,9 @@
 
 #include <MtkGps.h>
 #include <SimpleCli.h>
+#include <netsampler.h>
+#include <eventloop.h>
+#include <subproc.h>
 
 /*
 	CLI for testing MTK3339 GPS unit
@@ -40,152 +43,334 @@ extern MtkGps gps;
 extern int nmea_echo;
 extern int pmtk_echo;
 extern int show_data;
+extern EventLoop evloop;
+extern SimpleCli cli;
 static int gps_standby = 0;
 
 #define LINE_MAX 512
 
-// list of supported commands 
-const char *cmd_list[] = {
-	"gps data [on|off]",
-	"gps nmea [on|off]",
-	"gps pmtk [on|off]",
-	"gps standby [on|off]",
-	"gps baud [4800, 9600, 19200, 38400, 57600, 115200]",
-	"gps release [get]",
-	"pmtk command",
-	"set time",
-	"system [cmd]",
-};
+// on|off argument helper
+static int on_off(cli_args_t *args, PrintTerminal *term, int *flag, const char *name)
+{
+	if (args->argc == 0)
+		term->print("%s is %s\n", name, *flag ? "on" : "off");
+	else
+		*flag = cmd_is(args->argv[0], "on");
+	return 0;
+}
 
-// called by terminal for every new command line
-int cli_handler(char *buf, PrintTerminal *term)
+static int gps_data(cli_args_t *args, PrintTerminal *term)
 {
-	char *arg;
-	char cmd[CMD_LEN + 1];
-	char wline[LINE_MAX];
+	return on_off(args, term, &show_data, "gps data");
+}
 
-	memcpy(cmd, buf, sizeof(cmd));
+static int gps_nmea(cli_args_t *args, PrintTerminal *term)
+{
+	return on_off(args, term, &nmea_echo, "nmea echo");
+}
+
+static int gps_pmtk(cli_args_t *args, PrintTerminal *term)
+{
+	return on_off(args, term, &pmtk_echo, "pmtk echo");
+}
 
-	if (cmd_is(cmd, "help")) {
-		term->print("List of supported commands:\n");
-		for(uint8_t i = 0; i < sizeof(cmd_list)/sizeof(cmd_list[0]); i++)
-			term->print("   %s\n", cmd_list[i]);
+static int gps_standby_cmd(cli_args_t *args, PrintTerminal *term)
+{
+	if (args->argc) {
+		gps_standby = cmd_is(args->argv[0], "on");
+		gps.sendCommand(PMTK_CMD_STANDBY_MODE, gps_standby ? PMTK_ARG_ON : PMTK_ARG_OFF);
+		if (pmtk_echo) term->print(">%s\n", gps.cmd);
 		return 0;
 	}
+	return on_off(args, term, &gps_standby, "gps standby");
+}
 
-	if (cmd_is(cmd, "set time")) {
-		struct tm fixt;
-		gps.getFixTime(&fixt);
-		sprintf(wline, "date --set=\"%d-%02d-%02d %02d:%02d:%02d\"",
-			fixt.tm_year + 2000, fixt.tm_mon, fixt.tm_mday,
-			fixt.tm_hour, fixt.tm_min, fixt.tm_sec);
-		term->print("%s\n", wline);
-		system(wline);
+static int gps_baud(cli_args_t *args, PrintTerminal *term)
+{
+	if (args->argc == 0) {
+		term->print("gps baud rate %u\n", gps.getNmeaBaudRate());
 		return 0;
 	}
-
-	if (cmd_arg(cmd, "gps nmea", &arg)) {
-		if (cmd_is(arg, "on"))
-			nmea_echo = 1;
-		if (cmd_is(arg, "off"))
-			nmea_echo = 0;
-		if (*arg == '\0')
-			term->print("nmea echo is %s\n", nmea_echo ? "on" : "off");
+	uint32_t baud = (uint32_t)atoi(args->argv[0]);
+	if (gps.setNmeaBaudRate(baud) == 0) {
+		if (pmtk_echo) term->print(">%s\n", gps.cmd);
+		gps.begin(baud);
+		term->print("gps baud rate set to %u\n", baud);
 		return 0;
 	}
+	term->print("baud rate %u not supported\n", baud);
+	return -1;
+}
 
-	if (cmd_arg(cmd, "gps data", &arg)) {
-		if (cmd_is(arg, "on"))
-			show_data = 1;
-		if (cmd_is(arg, "off"))
-			show_data = 0;
-		if (*arg == '\0')
-			term->print("gps data is %s\n", show_data ? "on" : "off");
-		return 0;
+static int gps_release(cli_args_t *args, PrintTerminal *term)
+{
+	if (args->argc == 0)
+		term->print("%s\n", gps.getFWrelease());
+	else {
+		gps.sendCommand(PMTK_Q_RELEASE);
+		if (pmtk_echo) term->print(">%s\n", gps.cmd);
 	}
+	return 0;
+}
 
-	if (cmd_arg(cmd, "gps pmtk", &arg)) {
-		if (cmd_is(arg, "on"))
-			pmtk_echo = 1;
-		if (cmd_is(arg, "off"))
-			pmtk_echo = 0;
-		if (*arg == '\0')
-			term->print("pmtk echo is %s\n", pmtk_echo ? "on" : "off");
+static int gps_latency(cli_args_t *args, PrintTerminal *term)
+{
+	if (args->argc) {
+		gps.resetLatency();
 		return 0;
 	}
+	static const int types[] = {
+		NMEA_SEN_GLL, NMEA_SEN_RMC, NMEA_SEN_VTG, NMEA_SEN_GGA,
+		NMEA_SEN_GSA, NMEA_SEN_GSV, NMEA_SEN_ZDA, NMEA_SEN_MCHN,
+		NMEA_SEN_MTK, NMEA_SEN_PGACK, NMEA_SEN_PGTOP, NMEA_INVALID
+	};
+	static const char *stage[LAT_STAGES] = { "read", "parse", "callback", "total" };
+	term->print("type  stage       count     p50     p90     p99     max usec\n");
+	for(uint8_t i = 0; i < sizeof(types)/sizeof(types[0]); i++) {
+		for(int n = 0; n < LAT_STAGES; n++) {
+			const lat_hist_t *lat = gps.getLatency(types[i], n);
+			if (lat->count == 0)
+				continue;
+			term->print("%-5s %-8s %8u %7u %7u %7u %7u\n",
+				nmea_type_name(nmea_type_index(types[i])), stage[n], lat->count,
+				lat_hist_percentile(lat, 50), lat_hist_percentile(lat, 90),
+				lat_hist_percentile(lat, 99), lat->max);
+		}
+	}
+	return 0;
+}
+
+static int gps_stat(cli_args_t *args, PrintTerminal *term)
+{
+	gps_stat_t st;
+	gps.getStat(&st);
+	term->print("rx %u tx %u discarded %u truncated %u crc %u unknown %u\n",
+		st.rx, st.tx, st.discarded, st.truncated, st.crc_errors, st.unknown);
+	for(int i = 0; i < NMEA_NTYPES; i++) {
+		if (st.sentences[i] || st.parse_errors[i])
+			term->print("%-5s %8u parse errors %u\n", nmea_type_name(i),
+				st.sentences[i], st.parse_errors[i]);
+	}
+	return 0;
+}
 
-	if (cmd_arg(cmd, "gps release", &arg)) {
-		if (*arg == '\0')
-			term->print("%s\n", gps.getFWrelease());
-		else {
-			gps.sendCommand(PMTK_Q_RELEASE);
-			if (pmtk_echo) term->print(">%s\n", gps.cmd);
+static int net(cli_args_t *args, PrintTerminal *term)
+{
+	char names[NETIF_MAX][IFNAMSIZ];
+	netrate_t rx, tx;
+	const char *arg = args->argc ? args->argv[0] : NULL;
+	int n = netsampler_list(names, NETIF_MAX);
+
+	if (arg) {
+		netif_t netif;
+		if (get_netif_info(arg, &netif) != 0) {
+			term->print("unknown interface '%s'\n", arg);
+			return -1;
 		}
+		term->print("%s HW %s inet %s inet6 %s\n", netif.name, netif.hwas, netif.ip4as, netif.ip6as);
+		term->print("rx %llu bytes %llu packets %llu errors %llu dropped\n",
+			netif.rx.bytes, netif.rx.packets, netif.rx.errors, netif.rx.dropped);
+		term->print("tx %llu bytes %llu packets %llu errors %llu dropped\n",
+			netif.tx.bytes, netif.tx.packets, netif.tx.errors, netif.tx.dropped);
+	}
+	term->print("if        rx kB/s  pkt/s err/s drop/s   tx kB/s  pkt/s err/s drop/s\n");
+	for(int i = 0; i < n; i++) {
+		if (arg && strcmp(arg, names[i]))
+			continue;
+		if (netsampler_rate(names[i], &rx, &tx) != 0)
+			continue;
+		term->print("%-8s %9.2f %6.1f %5.1f %6.1f %9.2f %6.1f %5.1f %6.1f\n", names[i],
+			rx.bytes / 1024, rx.packets, rx.errors, rx.dropped,
+			tx.bytes / 1024, tx.packets, tx.errors, tx.dropped);
+	}
+	return 0;
+}
+
+static int pmtk(cli_args_t *args, PrintTerminal *term)
+{
+	char wline[LINE_MAX];
+	const char *arg = args->argv[0];
+
+	if (*arg == 'A') {
+		gps.sendCommand(PCMD_ANTENNA, PCMD_ANTENNA_OFF);
+		term->print("<%s\n", gps.cmd);
 		return 0;
 	}
+	if (*arg == '$')
+		snprintf(wline, sizeof(wline), "%s", arg);
+	else
+		snprintf(wline, sizeof(wline), "$PMTK%s", arg);
+	// queued, so scripts are not waiting for each command to be replied
+	if (gps.queueStr(wline) != 0) {
+		term->print("unable to queue '%s'\n", wline);
+		return -1;
+	}
+	if (pmtk_echo) term->print("<%s\n", wline);
+	return 0;
+}
 
-	if (cmd_arg(cmd, "gps baud", &arg)) {
-		if (*arg == '\0') {
-			term->print("gps baud rate %u\n", gps.getNmeaBaudRate());
-			return 0;
+static int gps_queue(cli_args_t *args, PrintTerminal *term)
+{
+	if (args->argc)
+		gps.setCommandWindow(atoi(args->argv[0]),
+			args->argc > 1 ? atoi(args->argv[1]) : gps.getCommandTimeout());
+	term->print("window %u timeout %u msec pending %u\n", gps.getCommandWindow(),
+		gps.getCommandTimeout(), gps.pendingCommands());
+	return 0;
+}
+
+static int gps_wait(cli_args_t *args, PrintTerminal *term)
+{
+	uint32_t timeout = args->argc ? atoi(args->argv[0]) : 5000;
+	return gps.waitCommands(timeout);
+}
+
+// raw GPS data recording, replay it on a PC with extras/replay
+static gpsrec_t gpsrec;
+
+static int gps_record(cli_args_t *args, PrintTerminal *term)
+{
+	if (args->argc) {
+		if (gps.getRecorder()) {
+			gps.setRecorder(NULL);
+			gpsrec_close(&gpsrec);
+			term->print("%u chunks %llu bytes recorded\n", gpsrec.chunks, gpsrec.bytes);
 		}
-		uint32_t baud = (uint32_t)atoi(arg);
-		if (gps.setNmeaBaudRate(baud) == 0) {
-			if (pmtk_echo) term->print(">%s\n", gps.cmd);
-			gps.begin(baud);
-			term->print("gps baud rate set to %u\n", baud);
+		if (cmd_is(args->argv[0], "off"))
 			return 0;
+		if (gpsrec_create(&gpsrec, args->argv[0], gps.getNmeaBaudRate()) != 0) {
+			term->print("unable to create '%s'\n", args->argv[0]);
+			return -1;
 		}
-		term->print("baud rate %u not supported\n", baud);
-		return -1;
+		gps.setRecorder(&gpsrec);
 	}
+	if (gps.getRecorder())
+		term->print("recording, %u chunks %llu bytes\n", gpsrec.chunks, gpsrec.bytes);
+	else
+		term->print("not recording\n");
+	return 0;
+}
 
-	if (cmd_arg(cmd, "gps standby", &arg)) {
-		if (cmd_is(arg, "on")) {
-			gps.sendCommand(PMTK_CMD_STANDBY_MODE, PMTK_ARG_ON);
-			if (pmtk_echo) term->print(">%s\n", gps.cmd);
-			gps_standby = 1;
+// change detection, 'gps nmea' echoes only sentences passed by the filter
+static GpsFilter filter;
+
+static int gps_filter(cli_args_t *args, PrintTerminal *term)
+{
+	if (args->argc) {
+		if (cmd_is(args->argv[0], "off")) {
+			gps.setFilter(NULL);
+			return 0;
 		}
-		if (cmd_is(arg, "off")) {
-			gps.sendCommand(PMTK_CMD_STANDBY_MODE, PMTK_ARG_OFF);
-			if (pmtk_echo) term->print(">%s\n", gps.cmd);
-			gps_standby = 0;
+		if (!cmd_is(args->argv[0], "on")) {
+			filter.setPosition(atof(args->argv[0]));
+			if (args->argc > 1)
+				filter.setSpeed(atof(args->argv[1]));
+			if (args->argc > 2)
+				filter.setCourse(atof(args->argv[2]));
+			if (args->argc > 3)
+				filter.setSilence(atoi(args->argv[3]));
 		}
-		if (*arg == '\0')
-			term->print("gps standby is %s\n", gps_standby ? "on" : "off");
+		filter.reset();
+		gps.setFilter(&filter);
 		return 0;
 	}
+	term->print("filter is %s: %.1f m %.2f knots %.1f degrees silence %u msec\n",
+		gps.getFilter() ? "on" : "off", filter.getPosition(), filter.getSpeed(),
+		filter.getCourse(), filter.getSilence());
+	for(int i = 0; i < NMEA_NTYPES; i++) {
+		uint32_t total = filter.passed[i] + filter.suppressed[i];
+		if (total)
+			term->print("%-5s %8u passed %8u suppressed %3u%%\n", nmea_type_name(i),
+				filter.passed[i], filter.suppressed[i], filter.suppressed[i] * 100 / total);
+	}
+	return 0;
+}
 
-	if (cmd_arg(cmd, "pmtk", &arg)) {
-		if (*arg != '\0') {
-			if (*arg == 'A') {
-				gps.sendCommand(PCMD_ANTENNA, PCMD_ANTENNA_OFF);
-				term->print("<%s\n", gps.cmd);
-				return 0;
-			}
-			if (*arg == '$')
-				strcpy(wline, arg);
-			else
-				sprintf(wline, "$PMTK%s", arg);
-			gps.sendStr(wline);
-			term->print("<%s\n", gps.cmd);
-			return 0;
-		}
+static int set_time(cli_args_t *args, PrintTerminal *term)
+{
+	char wline[LINE_MAX];
+	struct tm fixt;
+	gps.getFixTime(&fixt);
+	sprintf(wline, "date --set=\"%d-%02d-%02d %02d:%02d:%02d\"",
+		fixt.tm_year + 2000, fixt.tm_mon, fixt.tm_mday,
+		fixt.tm_hour, fixt.tm_min, fixt.tm_sec);
+	term->print("%s\n", wline);
+	system(wline);
+	return 0;
+}
+
+// 'system' runs in background, output is sent to the terminal by the event loop
+static subproc_t sysproc = { 0, -1, -1 };
+
+static void system_cancel(void *data)
+{
+	subproc_kill(&sysproc, SIGINT);
+}
+
+static void system_output(int fd, uint32_t events, void *data)
+{
+	PrintTerminal *term = (PrintTerminal *)data;
+	char buf[256];
+	int n;
+
+	// one chunk per wake up, so gps is never waiting for a chatty command
+	n = subproc_read(&sysproc, buf, sizeof(buf));
+	if (n > 0) {
+		term->write(buf, n);
+		return;
 	}
+	if (n == 0)
+		return;
 
-	if (cmd_arg(cmd, "system", &arg)) {
-		if (*arg == '\0')
-			arg = "uname -a";
+	evloop.remove(fd);
+	cli.setCancel(NULL);
+	n = subproc_wait(&sysproc);
+	if (n != 0)
+		term->print("exit status %d\n", n);
+	term->flush();
+}
 
-		FILE *pf = popen(arg, "r");
-		if (pf) {
-			while (fgets(wline, LINE_MAX, pf) != NULL)
-				term->print("%s", wline);
-			pclose(pf);
-		}
-		return 0;
+static int system_cmd(cli_args_t *args, PrintTerminal *term)
+{
+	const char *arg = args->argc ? args->argv[0] : "uname -a";
+
+	if (subproc_running(&sysproc)) {
+		term->print("'system' is still running, Ctrl-C to stop it\n");
+		return -1;
+	}
+	if (subproc_start(&sysproc, arg) < 0 ||
+		evloop.add(sysproc.fd, system_output, term) < 0) {
+		term->print("unable to run '%s'\n", arg);
+		subproc_kill(&sysproc, SIGKILL);
+		subproc_wait(&sysproc);
+		return -1;
 	}
+	cli.setCancel(system_cancel);
+	return 0;
+}
 
-	term->print("Unknown command '%s'\n", buf);
-	return -1;
+// supported commands
+static const cli_cmd_t cli_table[] = {
+	{ "gps data",    "[on|off]", gps_data, "print GPS data every 2 seconds" },
+	{ "gps nmea",    "[on|off]", gps_nmea, "echo received NMEA sentences" },
+	{ "gps pmtk",    "[on|off]", gps_pmtk, "echo sent PMTK commands" },
+	{ "gps standby", "[on|off]", gps_standby_cmd, "GPS standby mode" },
+	{ "gps baud",    "[4800|9600|19200|38400|57600|115200]", gps_baud, "GPS baud rate" },
+	{ "gps release", "[get]", gps_release, "firmware release, 'get' queries GPS" },
+	{ "gps latency", "[reset]", gps_latency, "NMEA processing latency" },
+	{ "gps stat",    NULL, gps_stat, "NMEA statistics" },
+	{ "gps queue",   "[<window> [<msec>]]", gps_queue, "PMTK commands waiting for reply and reply timeout" },
+	{ "gps wait",    "[<msec>]", gps_wait, "wait for queued PMTK commands, fails if any failed" },
+	{ "gps record",  "[<file>]", gps_record, "record raw GPS data to file, 'off' to stop" },
+	{ "gps filter",  "[on|off|<metres> [<knots> [<degrees> [<msec>]]]]", gps_filter, "pass only changed sentences, or after msec of silence" },
+	{ "net",         "[<interface>]", net, "network interfaces rates" },
+	{ "pmtk",        "<command...>", pmtk, "queue PMTK command, 220,500 or $PMTK220,500" },
+	{ "set time",    NULL, set_time, "set system time from GPS" },
+	{ "system",      "[<cmd...>]", system_cmd, "run shell command, Ctrl-C to stop" },
+};
+
+// register commands with the terminal cli
+int cli_init(SimpleCli *cli)
+{
+	return cli->commands(cli_table, sizeof(cli_table)/sizeof(cli_table[0]));
 }
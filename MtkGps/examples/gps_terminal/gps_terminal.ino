@@ -30,12 +30,22 @@
 
 #include <MtkGps.h>
 #include <SerialTerminal.h>
+#include <TermFormat.h>
 #include <SimpleCli.h>
 #include <led.h>
-#include <ticker.h>
+#include <ttyfd.h>
+#include <eventloop.h>
+#include <netsampler.h>
+#include <unistd.h>
 
 #define UTC_OFFSET 60
 
+#define GPS_DEV  "/dev/ttyS0"  // Serial1, RX0/TX1
+#define TERM_DEV "/dev/ttyGS0" // Serial, USB
+
+// startup profile, GPS configuration commands for SimpleCli
+#define GPS_PROFILE "/media/card/gps.rc"
+
 MtkGps gps;
 
 // LED to blink on every NMEA sentence
@@ -51,18 +61,27 @@ int show_data = 0;
 
 SerialTerminal term(MAX_TERM_STR_LEN);
 
-extern int cli_handler(char *buf, PrintTerminal *term);
-SimpleCli cli(&term, cli_handler);
+extern int cli_init(SimpleCli *cli);
+SimpleCli cli(&term, NULL);
+
+// loop sleeps until GPS data, terminal input or timer
+EventLoop evloop;
 
 // 2 seconds timer to print GPS data
 int ticker(void *data);
-ticker_t timer(2000, ticker);
+wtimer_t timer(ticker);
+
+void on_gps(int fd, uint32_t events, void *data);
+void on_term(void *data);
+void on_pmtk(MtkGps *gps, const char *cmd, int ack, void *data);
+void on_nmea(MtkGps *gps, int nmea_type, void *data);
 
 void setup()
 {
 	// use USB serial as a terminal
 	term.attach(&Serial);
 	term.begin(PMTK_BR_115200);
+	cli_init(&cli);
 
 	// attach debugging led to flush on every NMEA sentence
 	gps_led.attach(13);
@@ -82,62 +101,106 @@ void setup()
 	term.print("gps nmea echo is %s\n", nmea_echo ? "on" : "off");
 	term.print("gps pmtk echo is %s\n", nmea_echo ? "on" : "off");
 
-	gps.attach(&Serial1);
+	// talk to GPS through non-blocking descriptor, so the loop can wait on it
+	Serial1.end();
+	gps.attach(tty_open(GPS_DEV, gpsbr));
 	gps.begin(gpsbr);
-	// gps unit initialization
-	// enable RMC and GGA output; GGA every forth poll 
-	gps.setOutput(NMEA_SEN_RMC, 0, 0, NMEA_SEN_GGA);
-	if (nmea_echo) term.print("<%s\n", gps.cmd);
-	// works with update rate 1Hz only
-	gps.setEasyMode(PMTK_ARG_OFF);
-	if (nmea_echo) term.print("<%s\n", gps.cmd);
-	// Set the update rate 2Hz
-	gps.setUpdateRate(2);
-	if (nmea_echo) term.print("<%s\n", gps.cmd);
-	// turn on some MTK features for better satellites tracking
-	gps.sendCommand(PMTK_SET_AIC_MODE, PMTK_ARG_ON);
-	if (nmea_echo) term.print("<%s\n", gps.cmd);
-	gps.sendCommand(PMTK_SET_SBAS_ENABLE, PMTK_ARG_ON);
-	if (nmea_echo) term.print("<%s\n", gps.cmd);
-	gps.sendCommand(PMTK_SET_DGPS_MODE, PMTK_DGPS_WAAS);
-	if (nmea_echo) term.print("<%s\n", gps.cmd);
-	// set navigation speed threshold 0.2 m/s
-	gps.setNavThreshold(PMTK_NAV_THRESHOLD_02);
-	if (nmea_echo) term.print("<%s\n", gps.cmd);
-	// request firmware release information
-	gps.sendCommand(PMTK_Q_RELEASE);
-	if (nmea_echo) term.print("<%s\n", gps.cmd);
+	gps.setCommandHandler(on_pmtk);
+	gps.setHandler(on_nmea);
+	// gps unit initialization from the profile, if there is one
+	if (access(GPS_PROFILE, R_OK) == 0) {
+		term.print("Running %s...\n", GPS_PROFILE);
+		cli.script(GPS_PROFILE);
+	}
+	else {
+		// enable RMC and GGA output; GGA every forth poll 
+		gps.setOutput(NMEA_SEN_RMC, 0, 0, NMEA_SEN_GGA);
+		if (nmea_echo) term.print("<%s\n", gps.cmd);
+		// works with update rate 1Hz only
+		gps.setEasyMode(PMTK_ARG_OFF);
+		if (nmea_echo) term.print("<%s\n", gps.cmd);
+		// Set the update rate 2Hz
+		gps.setUpdateRate(2);
+		if (nmea_echo) term.print("<%s\n", gps.cmd);
+		// turn on some MTK features for better satellites tracking
+		gps.sendCommand(PMTK_SET_AIC_MODE, PMTK_ARG_ON);
+		if (nmea_echo) term.print("<%s\n", gps.cmd);
+		gps.sendCommand(PMTK_SET_SBAS_ENABLE, PMTK_ARG_ON);
+		if (nmea_echo) term.print("<%s\n", gps.cmd);
+		gps.sendCommand(PMTK_SET_DGPS_MODE, PMTK_DGPS_WAAS);
+		if (nmea_echo) term.print("<%s\n", gps.cmd);
+		// set navigation speed threshold 0.2 m/s
+		gps.setNavThreshold(PMTK_NAV_THRESHOLD_02);
+		if (nmea_echo) term.print("<%s\n", gps.cmd);
+		// request firmware release information
+		gps.sendCommand(PMTK_Q_RELEASE);
+		if (nmea_echo) term.print("<%s\n", gps.cmd);
+	}
 	// it is still summer time in Ireland, add 1 hour to UTC...
 	gps.setTimeZone(UTC_OFFSET);
+
+	// network interfaces rates for 'net' command
+	netsampler_start(1000, 0.3);
+
+	evloop.begin();
+	evloop.add(gps.fd(), on_gps);
+	// USB serial is read by SerialTerminal, the loop only watches the device
+	evloop.addPoller(on_term, NULL, 100, TERM_DEV);
+	evloop.start(&timer, 2000, 2000);
 }
 
 void loop()
+{
+	evloop.run();
+}
+
+// check terminal input
+void on_term(void *data)
 {
 	int ch;
+
+	while((ch = term.getch()) != 0)
+		cli.interact(ch);
+}
+
+// set by on_nmea() if the sentence parsed was passed by 'gps filter'
+static int passed;
+
+// check gps unit for new nmea sentences
+void on_gps(int fd, uint32_t events, void *data)
+{
 	const char *nmea;
-	unsigned long tstamp;
-
-	while(1) {
-		// check terminal input
-		if ((ch = term.getch()) != 0)
-			cli.interact(ch);
-		// check gps unit for new nmea sentences
-		if ((nmea = gps.read()) != NULL) {
-			gps_led.on();
-			if (nmea_echo && nmea[1] == 'G')
-				term.print(">%s\n", nmea);
-			if (pmtk_echo && nmea[1] == 'P')
-				term.print(">%s\n", nmea);
-			gps.parse_nmea(nmea);
-			gps_led.off();
-		}
-
-		// read milliseconds for timer(s) processing
-		tstamp = millis();
-		timer.tick(tstamp, NULL);
+
+	while((nmea = gps.read()) != NULL) {
+		gps_led.on();
+		if (pmtk_echo && nmea[1] == 'P')
+			term.print(">%s\n", nmea);
+		passed = 0;
+		gps.parse_nmea(nmea);
+		if (nmea_echo && nmea[1] == 'G' && (passed || gps.getFilter() == NULL))
+			term.print(">%s\n", nmea);
+		gps_led.off();
 	}
 }
 
+// parsed sentence, with 'gps filter' on only changed ones
+void on_nmea(MtkGps *gps, int nmea_type, void *data)
+{
+	passed = 1;
+}
+
+// result of a queued PMTK command
+void on_pmtk(MtkGps *gps, const char *cmd, int ack, void *data)
+{
+	static const char *status[] = { "invalid", "unsupported", "failed", "ok" };
+
+	if (ack == PMTK_ACK_OK) {
+		if (pmtk_echo) term.print(">%s ok\n", cmd);
+	}
+	else
+		term.print("%s: %s\n", cmd, (ack == PMTK_ACK_TIMEOUT) ? "no reply" : status[ack]);
+}
+
 // 2 seconds timer ticker procedure
 int ticker(void *data)
 {
@@ -147,15 +210,15 @@ int ticker(void *data)
 	if (show_data && gps.isValid(NMEA_SEN_RMC)) {
 		gps.getFixTime(&tfix, &msec);
 
-		term.print("%02d/%02d/20%02d ", tfix.tm_mday, tfix.tm_mon, tfix.tm_year);
-		term.print("%02d:%02d:%02d.%03d ", tfix.tm_hour, tfix.tm_min, tfix.tm_sec, msec);
-		term.print("lat: %.8f lon: %.8f ", gps.latitude, gps.longitude);
-		term.print("spd: %.2fN %.2fK ", gps.rmc.speed, gps.rmc.speed * 1.852);
-		term.print("dir: %6.2f ", gps.rmc.course);
-		term.print("alt: %5.2f ", gps.gga.altitude);
-		term.print("nsat: %2d ", gps.gga.nsat);
+		TPRINT(term, "%02d/%02d/20%02d ", tfix.tm_mday, tfix.tm_mon, tfix.tm_year);
+		TPRINT(term, "%02d:%02d:%02d.%03d ", tfix.tm_hour, tfix.tm_min, tfix.tm_sec, msec);
+		TPRINT(term, "lat: %.8f lon: %.8f ", gps.latitude, gps.longitude);
+		TPRINT(term, "spd: %.2fN %.2fK ", gps.rmc.speed, gps.rmc.speed * 1.852);
+		TPRINT(term, "dir: %6.2f ", gps.rmc.course);
+		TPRINT(term, "alt: %5.2f ", gps.gga.altitude);
+		TPRINT(term, "nsat: %2d ", gps.gga.nsat);
 
-		term.print("fix: %d quality: %d %s\n", gps.rmc.flags & NMEA_VALID, gps.gga.quality, gps.getFixQuality());
+		TPRINT(term, "fix: %d quality: %d %s\n", gps.rmc.flags & NMEA_VALID, gps.gga.quality, gps.getFixQuality());
 	}
 
 	return 0;
@@ -0,0 +1,103 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <Arduino.h>
+
+#include <MtkGps.h>
+#include <GpsdServer.h>
+#include <ttyfd.h>
+#include <eventloop.h>
+
+/*
+	Serves GPS data to gpsd clients (cgps, gpsmon, OpenCPN, ...) over TCP.
+	Connect with 'cgps <galileo ip>' or 'telnet <galileo ip> 2947' and
+	type ?WATCH={"enable":true,"json":true};
+*/
+
+#define GPS_DEV "/dev/ttyS0" // Serial1, RX0/TX1
+
+MtkGps gps;
+GpsdServer gpsd(GPSD_SLOW_DROP);
+
+// loop sleeps until GPS data or client activity
+EventLoop evloop;
+
+void on_gps(int fd, uint32_t events, void *data);
+void on_gpsd(int fd, uint32_t events, void *data);
+
+// RMC is the first sentence of every fix cycle, report position on it
+void onNmea(MtkGps *gps, int nmea_type, void *data)
+{
+	if (nmea_type == NMEA_SEN_RMC) {
+		gpsd.publish_tpv(gps);
+		gpsd.publish_sky(gps);
+	}
+}
+
+void setup()
+{
+	uint32_t gpsbr = gps.detect(&Serial1);
+	if (gpsbr == PMTK_BR_INVALID)
+		gpsbr = PMTK_BR_9600;
+
+	// talk to GPS through non-blocking descriptor, so the loop can wait on it
+	Serial1.end();
+	gps.attach(tty_open(GPS_DEV, gpsbr));
+	gps.begin(gpsbr);
+	gps.setOutput(NMEA_SEN_RMC | NMEA_SEN_GGA | NMEA_SEN_GSA, 0, 0, 0, NMEA_SEN_GSV);
+	gps.setHandler(onNmea);
+
+	gpsd.setDevice(GPS_DEV);
+	gpsd.begin(GPSD_PORT);
+
+	evloop.begin();
+	evloop.add(gps.fd(), on_gps);
+	// server epoll descriptor is readable when any client needs serving
+	evloop.add(gpsd.fd(), on_gpsd);
+}
+
+void loop()
+{
+	evloop.run();
+}
+
+void on_gps(int fd, uint32_t events, void *data)
+{
+	const char *nmea;
+
+	while((nmea = gps.read()) != NULL) {
+		gpsd.publish_nmea(nmea);
+		gps.parse_nmea(nmea);
+	}
+}
+
+// serve clients which are ready, without waiting
+void on_gpsd(int fd, uint32_t events, void *data)
+{
+	gpsd.poll(0);
+}
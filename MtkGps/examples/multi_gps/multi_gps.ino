@@ -0,0 +1,93 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <Arduino.h>
+
+#include <MtkGps.h>
+#include <GpsEngine.h>
+#include <SerialTerminal.h>
+
+/*
+	Serves a few GPS receivers from one loop, for example one on RX0/TX1
+	and a few USB GPS modules, and prints every new fix tagged with receiver ID.
+	Loop sleeps in epoll until any of the receivers sends something.
+*/
+
+#define MAX_TERM_STR_LEN 256
+#define GPS_BAUD PMTK_BR_9600
+
+static const char *gps_dev[] = {
+	"/dev/ttyS0",   // Serial1, RX0/TX1
+	"/dev/ttyUSB0",
+	"/dev/ttyUSB1",
+	"/dev/ttyUSB2"
+};
+
+#define NUM_GPS (sizeof(gps_dev)/sizeof(gps_dev[0]))
+
+MtkGps gps[NUM_GPS];
+
+SerialTerminal term(MAX_TERM_STR_LEN);
+
+void on_fix(int id, MtkGps *pgps, int nmea_type, void *data);
+GpsEngine engine(on_fix);
+
+void setup()
+{
+	term.attach(&Serial);
+	term.begin(PMTK_BR_115200);
+
+	for(unsigned i = 0; i < NUM_GPS; i++) {
+		int id = engine.add(&gps[i], gps_dev[i], GPS_BAUD);
+		if (id < 0) {
+			term.print("unable to open %s\n", gps_dev[i]);
+			continue;
+		}
+		term.print("receiver %d on %s\n", id, gps_dev[i]);
+		gps[i].setOutput(NMEA_SEN_RMC | NMEA_SEN_GGA);
+		gps[i].setUpdateRate(1);
+	}
+}
+
+void loop()
+{
+	// nothing to do until one of receivers sends data
+	engine.poll(1000);
+}
+
+void on_fix(int id, MtkGps *pgps, int nmea_type, void *data)
+{
+	if (nmea_type != NMEA_SEN_RMC)
+		return;
+
+	char ts[GPS_ISO8601_LEN];
+	if (pgps->getFixTimeStr(ts) < 0)
+		strcpy(ts, "no date");
+	term.print("%d %s lat: %.8f lon: %.8f fix: %d\n", id, ts,
+		pgps->latitude, pgps->longitude, pgps->rmc.flags & NMEA_VALID);
+}
@@ -0,0 +1,106 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <Arduino.h>
+
+#include <MtkGps.h>
+#include <udpfanout.h>
+#include <ttyfd.h>
+#include <eventloop.h>
+
+/*
+	Redistributes NMEA sentences from GPS module to LAN: multicast group
+	plus a few unicast subscribers. Sentences of one fix are coalesced
+	into one datagram, so every subscriber gets one packet per update.
+*/
+
+#define NMEA_GROUP "239.255.0.183"
+#define NMEA_PORT  10110 // NMEA-0183 over IP
+
+#define GPS_DEV "/dev/ttyS0" // Serial1, RX0/TX1
+
+static const char *unicast[] = {
+	"192.168.1.10",
+	"192.168.1.11"
+};
+
+MtkGps gps;
+UdpFanout fanout;
+
+// loop sleeps until GPS data or timer
+EventLoop evloop;
+
+// flush coalesced sentences every 100 msec
+int flush(void *data);
+wtimer_t timer(flush);
+
+void on_gps(int fd, uint32_t events, void *data);
+
+void setup()
+{
+	uint32_t gpsbr = gps.detect(&Serial1);
+	if (gpsbr == PMTK_BR_INVALID)
+		gpsbr = PMTK_BR_9600;
+
+	// talk to GPS through non-blocking descriptor, so the loop can wait on it
+	Serial1.end();
+	gps.attach(tty_open(GPS_DEV, gpsbr));
+	gps.begin(gpsbr);
+	gps.setOutput(NMEA_SEN_RMC | NMEA_SEN_GGA | NMEA_SEN_GSA, 0, 0, 0, NMEA_SEN_GSV);
+
+	fanout.begin();
+	fanout.subscribe(NMEA_GROUP, NMEA_PORT);
+	for(unsigned i = 0; i < sizeof(unicast)/sizeof(unicast[0]); i++)
+		fanout.subscribe(unicast[i], NMEA_PORT);
+	fanout.coalesce(FANOUT_MAX_DGRAM);
+
+	evloop.begin();
+	evloop.add(gps.fd(), on_gps);
+	evloop.start(&timer, 100, 100);
+}
+
+void loop()
+{
+	evloop.run();
+}
+
+void on_gps(int fd, uint32_t events, void *data)
+{
+	const char *nmea;
+
+	while((nmea = gps.read()) != NULL) {
+		if (gps.parse_nmea(nmea) == 0)
+			fanout.publish_nmea(nmea);
+	}
+}
+
+int flush(void *data)
+{
+	fanout.flush();
+	return 0;
+}
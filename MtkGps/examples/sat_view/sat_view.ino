@@ -30,13 +30,17 @@
 
 #include <MtkGps.h>
 #include <SerialTerminal.h>
-#include <ticker.h>
+#include <VirtualScreen.h>
+#include <ttyfd.h>
+#include <eventloop.h>
 
 #define GPS_BAUD PMTK_BR_9600
 #define MAX_TERM_STR_LEN 256
 
 #define UTC_OFFSET 60
 
+#define GPS_DEV "/dev/ttyS0" // Serial1, RX0/TX1
+
 MtkGps gps;
 
 // set to 1 to close NMEA output to USB serial
@@ -49,16 +53,17 @@ SerialTerminal usb(MAX_TERM_STR_LEN);
 
 // our serial terminal
 SerialTerminal term(MAX_TERM_STR_LEN);
+// satellites table is drawn here, only changes are sent to the terminal
+VirtualScreen screen(&term, 40, 80);
 
-// some vt100 codes 
-const char cdwn[]  = { 27, '[', 'J', '\0' }; // clear down
-const char ceol[]  = { 27, '[', '0', 'K', '\0' }; // clear to EOL
-const char gotop[] = { 27, '[', '1', ';', '1', 'H','\0' }; // top left
-const char civis[] = { 27, '[', '?', '2', '5', 'l','\0' }; // invisible cursor
+// loop sleeps until GPS data or timer
+EventLoop evloop;
 
 // 1 second timer to print satellites data
 int ticker(void *data);
-ticker_t timer(1000, ticker);
+wtimer_t timer(ticker, gps.gsv);
+
+void on_gps(int fd, uint32_t events, void *data);
 
 void setup()
 {
@@ -69,9 +74,10 @@ void setup()
 
 	term.attach(&Serial2);
 	term.begin(PMTK_BR_115200);   // RS232/TTL headers for monitoring
+	// screen changes go out in one write, see screen.flush() in ticker()
+	term.buffering(4096, 0, false);
 
-	term.puts(gotop); // go to 0,0
-	term.puts(cdwn);  // clear screen
+	screen.begin(); // clear screen
 	// print initial header
 	ticker(gps.gsv);
 
@@ -80,8 +86,9 @@ void setup()
 	if (gpsbr == PMTK_BR_INVALID)
 		gpsbr = PMTK_BR_9600;
 
-	Serial1.begin(gpsbr);
-	gps.attach(&Serial1);
+	// talk to GPS through non-blocking descriptor, so the loop can wait on it
+	Serial1.end();
+	gps.attach(tty_open(GPS_DEV, gpsbr));
 
 	// set default bridge baud rate to 9600 as we are going to use NMEA_SEN_MCHN
 	gps.setNmeaBaudRate(GPS_BAUD);
@@ -100,28 +107,30 @@ void setup()
 	// NMEA_SEN_GSA  - fix type and satellites in use
 	// NMEA_SEN_MCHN - idle, search, track info
 	gps.setOutput(NMEA_SEN_ZDA, NMEA_SEN_GSV | NMEA_SEN_GSA, 0, 0, NMEA_SEN_MCHN);
+
+	evloop.begin();
+	evloop.add(gps.fd(), on_gps);
+	evloop.start(&timer, 1000, 1000);
 }
 
 void loop()
 {
-	const char *nmea;
-	unsigned long tstamp, pstamp;
-
-	pstamp = millis();
+	evloop.run();
+}
 
-	while(1) {
-		// read milliseconds for timer(s) processing
-		tstamp = millis();
-		timer.tick(tstamp, gps.gsv);
+// check gps module for a new nmea sentences
+void on_gps(int fd, uint32_t events, void *data)
+{
+	const char *nmea;
+	static uint32_t pstamp;
+	uint32_t tstamp = EventLoop::now();
 
-		// check gps module for a new nmea sentences
-		if ((nmea = gps.read()) != NULL) {
-			gps.parse_nmea(nmea);
+	while((nmea = gps.read()) != NULL) {
+		gps.parse_nmea(nmea);
 #if CLONE_NMEA
-			usb.print("%4u %u %s\n", tstamp - pstamp, tstamp, nmea);
+		usb.print("%4u %u %s\n", tstamp - pstamp, tstamp, nmea);
 #endif
-			pstamp = tstamp;
-		}
+		pstamp = tstamp;
 	}
 }
 
@@ -153,9 +162,8 @@ int ticker(void *data)
 	gpgsv_t *gsv = (gpgsv_t *)data;
 	const char *fixtype[3] = { " ", "2D", "3D" };
 
-	term.puts(gotop); // go to 0,0 position
-	term.puts(civis); // hide cursor
-	term.print("  # | SID | ELE | AZIM | CNR ");
+	screen.home(); // go to 0,0 position
+	screen.print("  # | SID | ELE | AZIM | CNR ");
 	// print last fix time if available
 	if (gps.isValid(NMEA_SEN_ZDA)) {
 		uint8_t fix = 0;
@@ -165,28 +173,26 @@ int ticker(void *data)
 				fix = gps.gsa.fix - NMEA_GSA_NO_FIX;
 		}
 		gps.getFixTime(&fixtm);
-		term.print(" Fix %s: %02d:%02d:%02d %d/%02d/%02d",
+		screen.print(" Fix %s: %02d:%02d:%02d %d/%02d/%02d",
 			fixtype[fix],
 			fixtm.tm_hour, fixtm.tm_min, fixtm.tm_sec,
 			fixtm.tm_year+2000, fixtm.tm_mon, fixtm.tm_mday);
 	}
 	else
-		term.print("searching...");
-	// clean to the end on the line
-	term.puts(ceol);
-	term.puts("\n");
+		screen.print("searching...");
+	// new line cleans to the end on the line
+	screen.puts("\n");
 	
 	// print visible satellites info and count statistics
 	int nidle = 0, ntrack = 0, nsearch = 0, nused = 0;
 	for(int sat = 1, i = 0; i < gps.ngsv; i++) {
 		if (gsv[i].prn != 0) {
-			term.print(" %2d |  %2d |  %2d |  %3d |", sat++, gsv[i].prn, gsv[i].elevation, gsv[i].azimuth);
-			for(int n = 0; n < gsv[i].snr; n++)
-				term.putch('=');
+			screen.print(" %2d |  %2d |  %2d |  %3d |", sat++, gsv[i].prn, gsv[i].elevation, gsv[i].azimuth);
+			screen.fill('=', gsv[i].snr);
 			if (gsv[i].snr)
-				term.print(" %2d", gsv[i].snr);
+				screen.print(" %2d", gsv[i].snr);
 			else
-				term.putch('-');
+				screen.putch('-');
 			char track = get_sat_tracking(gsv[i].prn);
 			char state = get_sat_state(gsv[i].prn);
 			if (state)
@@ -198,25 +204,25 @@ int ticker(void *data)
 			else if (track == 'I')
 				nidle++;
 
-			term.print(" %c%c", track, state);
-			term.puts(ceol);
-			term.puts("\n");
+			screen.print(" %c%c", track, state);
+			screen.puts("\n");
 		}
 	}
 	uint32_t rx;
 	gps.getPortStat(&rx);
-	term.print("  rx: %-10u        ", rx);
+	screen.print("  rx: %-10u        ", rx);
 	// print satellites statistics
 	if (gps.isValid(NMEA_SEN_ZDA)) {
 		if (nused)
-			term.print("Used: %d ", nused);
+			screen.print("Used: %d ", nused);
 		if (ntrack)
-			term.print("Tracking: %d ", ntrack);
+			screen.print("Tracking: %d ", ntrack);
 		if (nidle)
-			term.print("Idle: %d ", nidle);
+			screen.print("Idle: %d ", nidle);
 		if (nsearch)
-			term.print("Searching: %d", nsearch);
+			screen.print("Searching: %d", nsearch);
 	}
-	term.puts(cdwn);
+	screen.clearDown();
+	screen.flush();
 	return 0;
 }
@@ -0,0 +1,162 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+/*
+	MtkGps on a Linux host: reads a USB GPS module, serial port or pty
+	through GpsTtyPort and prints statistics every few seconds.
+	By default the port is non-blocking and waited on by GpsEngine;
+	with -m/-t it is read in blocking mode with VMIN/VTIME instead.
+
+	g++ -O2 -I../.. -o gps_tty gps_tty.cpp ../../MtkGps.cpp ../../GpsPort.cpp \
+		../../GpsFilter.cpp ../../GpsEngine.cpp ../../nmea.c ../../gpstime.c \
+		../../lathist.c ../../gpsrec.c ../../ttyfd.c
+	./gps_tty [-b baud] [-m vmin] [-t vtime] [-i sec] [-v] /dev/ttyUSB0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <MtkGps.h>
+#include <GpsEngine.h>
+
+static MtkGps gps;
+static volatile int running = 1;
+static int verbose;
+static uint64_t nsentences;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static void on_nmea(MtkGps *gps, int nmea_type)
+{
+	(void)gps;
+	nsentences++;
+	if (verbose)
+		printf("%s\n", nmea_type_name(nmea_type_index(nmea_type)));
+}
+
+static void on_engine(int id, MtkGps *gps, int nmea_type, void *data)
+{
+	(void)id;
+	(void)data;
+	on_nmea(gps, nmea_type);
+}
+
+static void on_gps(MtkGps *gps, int nmea_type, void *data)
+{
+	(void)data;
+	on_nmea(gps, nmea_type);
+}
+
+static void print_stat(double sec)
+{
+	gps_stat_t st;
+	const lat_hist_t *lat = gps.getLatency(NMEA_SEN_RMC, LAT_TOTAL);
+
+	gps.getStat(&st);
+	printf("%.1f sec: rx %u sentences %llu crc %u discarded %u, RMC total p50/p99 %u/%u usec",
+		sec, st.rx, (unsigned long long)nsentences, st.crc_errors, st.discarded,
+		lat_hist_percentile(lat, 50), lat_hist_percentile(lat, 99));
+	if (gps.isValid(NMEA_SEN_RMC))
+		printf(", %.6f %.6f", gps.latitude, gps.longitude);
+	printf("\n");
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-b baud] [-m vmin] [-t vtime] [-i sec] [-v] device\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t baud = PMTK_BR_9600;
+	int vmin = 0, vtime = 0;
+	int interval = 5;
+	int opt;
+
+	while((opt = getopt(argc, argv, "b:m:t:i:v")) != -1) {
+		switch(opt) {
+		case 'b': baud = atoi(optarg); break;
+		case 'm': vmin = atoi(optarg); break;
+		case 't': vtime = atoi(optarg); break;
+		case 'i': interval = atoi(optarg); break;
+		case 'v': verbose = 1; break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind >= argc || interval < 1)
+		usage(argv[0]);
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	uint64_t start = lat_clock();
+	uint64_t next = start + interval * 1000000000ull;
+	GpsTtyPort tty;
+	GpsEngine engine(on_engine);
+
+	if (vmin || vtime) {
+		// blocking reads, returns after vmin bytes or vtime of silence
+		if (tty.open(argv[optind], baud, vmin, vtime) < 0) {
+			perror(argv[optind]);
+			return 1;
+		}
+		gps.attach(&tty);
+		gps.begin(baud);
+		gps.setHandler(on_gps);
+	}
+	else if (engine.add(&gps, argv[optind], baud) < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	while(running) {
+		if (vmin || vtime) {
+			const char *nmea = gps.read();
+			if (nmea)
+				gps.parse_nmea(nmea);
+		}
+		else if (engine.poll(100) < 0)
+			break;
+
+		uint64_t now = lat_clock();
+		if (now >= next) {
+			print_stat((now - start) / 1e9);
+			next += interval * 1000000000ull;
+		}
+	}
+	print_stat((lat_clock() - start) / 1e9);
+	return 0;
+}
@@ -0,0 +1,194 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+/*
+	Load generator for GpsdServer (or a real gpsd): opens N client
+	connections, enables watch mode and reports per-client throughput
+	and the longest gap between lines. Optional slow clients enable watch
+	mode but never read, to check they do not stall the others.
+
+	gcc -O2 -o gpsd_bench gpsd_bench.c
+	./gpsd_bench [-c clients] [-s slow] [-t seconds] [-n] host [port]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define MAX_CLIENTS 1024
+
+typedef struct bench_s
+{
+	int      fd;
+	uint64_t bytes;
+	uint64_t lines;
+	uint64_t last;    // last line arrival time, nsec
+	uint64_t max_gap; // longest time between two lines, nsec
+} bench_t;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int connect_to(const char *host, const char *port)
+{
+	struct addrinfo hints, *res, *ai;
+	int fd = -1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, port, &hints, &res) != 0)
+		return -1;
+
+	for(ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	return fd;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [-c clients] [-s slow] [-t seconds] [-n] host [port]\n", name);
+	printf("  -c  number of reading clients, default 8\n");
+	printf("  -s  number of clients that never read, default 0\n");
+	printf("  -t  test duration in seconds, default 10\n");
+	printf("  -n  watch NMEA instead of JSON\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	static bench_t bench[MAX_CLIENTS];
+	static int slow[MAX_CLIENTS];
+	int nclients = 8, nslow = 0, duration = 10, nmea = 0;
+	const char *port = "2947";
+	int opt;
+
+	while((opt = getopt(argc, argv, "c:s:t:n")) != -1) {
+		switch(opt) {
+		case 'c': nclients = atoi(optarg); break;
+		case 's': nslow = atoi(optarg); break;
+		case 't': duration = atoi(optarg); break;
+		case 'n': nmea = 1; break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind >= argc || nclients < 1 || nclients > MAX_CLIENTS || nslow < 0 || nslow > MAX_CLIENTS)
+		usage(argv[0]);
+	if ((optind + 1) < argc)
+		port = argv[optind + 1];
+
+	const char *watch = nmea ? "?WATCH={\"enable\":true,\"nmea\":true};\n" :
+		"?WATCH={\"enable\":true,\"json\":true};\n";
+
+	int efd = epoll_create1(0);
+	for(int i = 0; i < nclients + nslow; i++) {
+		int fd = connect_to(argv[optind], port);
+		if (fd < 0) {
+			fprintf(stderr, "client %d: unable to connect\n", i);
+			return 1;
+		}
+		write(fd, watch, strlen(watch));
+		if (i >= nclients) {
+			// small receive buffer to make it fall behind sooner
+			int size = 4096;
+			setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+			slow[i - nclients] = fd;
+			continue;
+		}
+		bench[i].fd = fd;
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev);
+	}
+
+	uint64_t start = now_ns();
+	uint64_t stop = start + (uint64_t)duration * 1000000000ull;
+	int active = nclients;
+	char buf[65536];
+
+	while(active && now_ns() < stop) {
+		struct epoll_event ev[64];
+		int n = epoll_wait(efd, ev, 64, 100);
+		uint64_t ts = now_ns();
+		for(int i = 0; i < n; i++) {
+			bench_t *b = &bench[ev[i].data.u32];
+			ssize_t len = read(b->fd, buf, sizeof(buf));
+			if (len <= 0) {
+				epoll_ctl(efd, EPOLL_CTL_DEL, b->fd, NULL);
+				close(b->fd);
+				b->fd = -1;
+				active--;
+				continue;
+			}
+			b->bytes += len;
+			for(ssize_t k = 0; k < len; k++) {
+				if (buf[k] != '\n')
+					continue;
+				if (b->last && (ts - b->last) > b->max_gap)
+					b->max_gap = ts - b->last;
+				b->last = ts;
+				b->lines++;
+			}
+		}
+	}
+
+	double secs = (now_ns() - start) / 1e9;
+	uint64_t total = 0, worst = 0;
+	printf("client    lines   lines/s   bytes/s  max gap ms\n");
+	for(int i = 0; i < nclients; i++) {
+		bench_t *b = &bench[i];
+		printf("%6d %8llu %9.1f %9.0f %11.1f%s\n", i, (unsigned long long)b->lines,
+			b->lines / secs, b->bytes / secs, b->max_gap / 1e6, b->fd < 0 ? " closed" : "");
+		total += b->bytes;
+		if (b->max_gap > worst)
+			worst = b->max_gap;
+	}
+	printf("total %.0f bytes/s, worst gap %.1f ms, %d slow clients\n", total / secs, worst / 1e6, nslow);
+
+	for(int i = 0; i < nslow; i++)
+		close(slow[i]);
+	return 0;
+}
@@ -0,0 +1,965 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+/*
+	MTK3339 receiver simulator on a pty, for load and protocol testing
+	of MtkGps without hardware and at rates real modules can't reach.
+
+	Emits GLL, RMC, VTG, GGA, GSA, GSV, ZDA and PMTKCHN along a scripted
+	trajectory at up to 10 Hz, acknowledges PMTK commands with PMTK001
+	and answers queries (PMTK500/501/513/514/519/527/530/705/707...),
+	honors PMTK220 update rate, PMTK314 output, PMTK251 baud rate and
+	PMTK161 standby. Output is paced to the current baud rate and the
+	reader's termios speed must match it, as with a real serial port,
+	so detect() can be tested. Faults are injected on request.
+
+	gcc -O2 -o mtksim mtksim.c -lm
+	./mtksim [-b baud] [-r hz] [-s script] [-l link] [-u] [-a] [-q]
+
+	Script lines, '#' starts a comment:
+	  <sec> <lat> <lon> <alt>   trajectory waypoint, replayed in a loop
+	  @<sec> <command>          command at the given time
+	Commands (also read from stdin):
+	  crc <pct>       corrupt checksum of pct% sentences
+	  trunc <pct>     truncate pct% sentences
+	  drop <sec>      no output for sec seconds
+	  fix on|off      position fix available
+	  rate <hz>       update rate, as PMTK220
+	  baud <baud>     switch baud rate, as PMTK251
+	  stat            print counters
+	  quit
+*/
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+
+#define SIM_NMEA     19    // PMTK314 fields
+#define SIM_OUT      65536 // output queue
+#define SIM_LINE     256
+#define SIM_WAYPTS   1024
+#define SIM_EVENTS   256
+#define SIM_SATS     16
+#define SIM_CHN      32    // PMTKCHN channels
+
+// PMTK314 field order
+enum { OUT_GLL, OUT_RMC, OUT_VTG, OUT_GGA, OUT_GSA, OUT_GSV, OUT_ZDA = 17, OUT_MCHN = 18 };
+
+// PMTK001 flags
+#define ACK_INVALID     0
+#define ACK_UNSUPPORTED 1
+#define ACK_FAILED      2
+#define ACK_OK          3
+
+typedef struct waypt_s
+{
+	double t; // seconds
+	double lat;
+	double lon;
+	double alt;
+} waypt_t;
+
+typedef struct event_s
+{
+	double t;
+	char   cmd[64];
+} event_t;
+
+typedef struct sat_s
+{
+	int    prn;
+	double az;    // degrees at t = 0
+	double phase; // elevation phase
+} sat_t;
+
+typedef struct counters_s
+{
+	uint64_t epochs;
+	uint64_t sentences;
+	uint64_t bytes;
+	uint64_t overruns;  // epochs skipped, baud rate too low for output
+	uint64_t commands;
+	uint64_t acks[4];
+	uint64_t replies;   // query replies
+	uint64_t crc;       // injected faults
+	uint64_t trunc;
+	uint64_t dropped;   // sentences not sent during dropout
+	uint64_t garbage;   // bytes sent or received at mismatched baud rate
+} counters_t;
+
+typedef struct sim_s
+{
+	int      master;
+	int      slave;     // kept open, so the pty survives reader restarts
+	uint32_t baud;
+	int      unlimited; // no baud pacing
+	int      anybaud;   // ignore reader's termios speed
+	int      quiet;
+	uint32_t fix_ms;    // PMTK220
+	uint8_t  out[SIM_NMEA];
+	int      dgps;
+	int      sbas;
+	int      datum;
+	int      nav_thr;
+	int      easy;
+	int      standby;
+	int      fix;
+	double   fix_at;    // fix is acquired at this time after cold start
+	double   crc_pct;
+	double   trunc_pct;
+	double   drop_until;
+
+	// output queue, paced by baud rate
+	char     obuf[SIM_OUT];
+	unsigned ohead;
+	unsigned otail;
+	double   tokens;
+	double   t_tokens;
+
+	char     line[SIM_LINE]; // command being received
+	unsigned ilen;
+
+	waypt_t  wp[SIM_WAYPTS];
+	int      nwp;
+	event_t  ev[SIM_EVENTS];
+	int      nev;
+	int      iev;
+	sat_t    sat[SIM_SATS];
+
+	time_t   utc0;  // UTC at t = 0
+	double   t0;    // CLOCK_MONOTONIC at start
+	uint64_t epoch; // next epoch number
+	counters_t cnt;
+} sim_t;
+
+static volatile int running = 1;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double frand(void)
+{
+	return rand() / (RAND_MAX + 1.0);
+}
+
+static speed_t tty_speed(uint32_t baud)
+{
+	switch(baud) {
+	case 4800:   return B4800;
+	case 9600:   return B9600;
+	case 19200:  return B19200;
+	case 38400:  return B38400;
+	case 57600:  return B57600;
+	case 115200: return B115200;
+	}
+	return B0;
+}
+
+static void defaults(sim_t *sim)
+{
+	memset(sim->out, 0, sizeof(sim->out));
+	sim->out[OUT_RMC] = 1;
+	sim->out[OUT_VTG] = 1;
+	sim->out[OUT_GGA] = 1;
+	sim->out[OUT_GSA] = 1;
+	sim->out[OUT_GSV] = 5;
+	sim->fix_ms = 1000;
+	sim->dgps = 0;
+	sim->sbas = 0;
+	sim->datum = 0;
+	sim->nav_thr = 0;
+	sim->easy = 1;
+}
+
+/* output */
+
+// reader's speed must match ours, otherwise both sides see garbage
+static int baud_ok(sim_t *sim)
+{
+	struct termios tio;
+
+	if (sim->anybaud || tcgetattr(sim->slave, &tio) < 0)
+		return 1;
+	return cfgetospeed(&tio) == tty_speed(sim->baud);
+}
+
+static unsigned queued(sim_t *sim)
+{
+	return sim->ohead - sim->otail;
+}
+
+static void put(sim_t *sim, const char *data, unsigned len)
+{
+	if (len > (SIM_OUT - queued(sim)))
+		return;
+	for(unsigned i = 0; i < len; i++)
+		sim->obuf[(sim->ohead + i) % SIM_OUT] = data[i];
+	sim->ohead += len;
+	sim->cnt.bytes += len;
+}
+
+// add checksum and CRLF, apply injected faults
+static void emit(sim_t *sim, int fault, const char *fmt, ...)
+{
+	char str[SIM_LINE];
+	uint8_t crc = 0;
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(str + 1, sizeof(str) - 8, fmt, ap);
+	va_end(ap);
+	if (len < 0)
+		return;
+	if (len > (int)sizeof(str) - 9)
+		len = sizeof(str) - 9;
+	str[0] = '$';
+	for(int i = 1; i <= len; i++)
+		crc ^= str[i];
+	len += sprintf(str + len + 1, "*%02X\r\n", crc) + 1;
+
+	if (fault) {
+		if (sim->drop_until > now_sec() - sim->t0) {
+			sim->cnt.dropped++;
+			return;
+		}
+		if (sim->crc_pct > 0 && frand() * 100 < sim->crc_pct) {
+			str[len - 3] = (str[len - 3] == '0') ? '1' : '0';
+			sim->cnt.crc++;
+		}
+		else if (sim->trunc_pct > 0 && frand() * 100 < sim->trunc_pct) {
+			len = 1 + rand() % (len - 3);
+			sim->cnt.trunc++;
+		}
+	}
+	put(sim, str, len);
+	sim->cnt.sentences++;
+}
+
+static void flush_out(sim_t *sim, double now)
+{
+	char buf[4096];
+	unsigned len = queued(sim);
+	int ok = baud_ok(sim);
+
+	if (!sim->unlimited) {
+		// 10 bits per byte, at most 100 msec worth of burst
+		double rate = sim->baud / 10.0;
+		sim->tokens += (now - sim->t_tokens) * rate;
+		if (sim->tokens > rate / 10)
+			sim->tokens = rate / 10;
+		sim->t_tokens = now;
+		if (sim->tokens < 1)
+			return;
+		if (len > sim->tokens)
+			len = (unsigned)sim->tokens;
+	}
+	if (len > sizeof(buf))
+		len = sizeof(buf);
+	if (len == 0)
+		return;
+
+	for(unsigned i = 0; i < len; i++) {
+		buf[i] = sim->obuf[(sim->otail + i) % SIM_OUT];
+		if (!ok)
+			buf[i] ^= 0x55 + (i & 0x0F);
+	}
+	ssize_t n = write(sim->master, buf, len);
+	if (n <= 0)
+		return;
+	if (!ok)
+		sim->cnt.garbage += n;
+	sim->otail += n;
+	if (!sim->unlimited)
+		sim->tokens -= n;
+}
+
+/* trajectory and satellites */
+
+static void position(sim_t *sim, double t, double *lat, double *lon, double *alt)
+{
+	if (sim->nwp == 0) {
+		// 200 m circle in two minutes
+		double a = t * 2 * M_PI / 120.0;
+		*lat = 53.3613 + 0.0018 * sin(a);
+		*lon = -6.5056 + 0.0030 * cos(a);
+		*alt = 61.7 + 5 * sin(a / 3);
+		return;
+	}
+	if (sim->nwp == 1) {
+		*lat = sim->wp[0].lat;
+		*lon = sim->wp[0].lon;
+		*alt = sim->wp[0].alt;
+		return;
+	}
+
+	double span = sim->wp[sim->nwp - 1].t - sim->wp[0].t;
+	t = sim->wp[0].t + (span > 0 ? fmod(t, span) : 0);
+	int i = 1;
+	while(i < sim->nwp - 1 && sim->wp[i].t < t)
+		i++;
+	const waypt_t *a = &sim->wp[i - 1], *b = &sim->wp[i];
+	double k = (b->t > a->t) ? (t - a->t) / (b->t - a->t) : 1;
+	if (k < 0) k = 0;
+	if (k > 1) k = 1;
+	*lat = a->lat + (b->lat - a->lat) * k;
+	*lon = a->lon + (b->lon - a->lon) * k;
+	*alt = a->alt + (b->alt - a->alt) * k;
+}
+
+// speed in knots and course over ground from two close positions
+static void motion(sim_t *sim, double t, double *knots, double *course)
+{
+	double lat1, lon1, lat2, lon2, alt;
+
+	position(sim, t, &lat1, &lon1, &alt);
+	position(sim, t + 0.5, &lat2, &lon2, &alt);
+	double dn = (lat2 - lat1) * 60.0;
+	double de = (lon2 - lon1) * 60.0 * cos(lat1 * M_PI / 180.0);
+	*knots = sqrt(dn * dn + de * de) / 0.5 * 3600.0;
+	*course = atan2(de, dn) * 180.0 / M_PI;
+	if (*course < 0)
+		*course += 360.0;
+}
+
+static void sat_pos(const sat_t *s, double t, double *el, double *az, int *snr)
+{
+	*el = 75.0 * fabs(sin(s->phase + t / 900.0)) - 5.0;
+	*az = fmod(s->az + t / 60.0, 360.0);
+	*snr = (*el > 0) ? 18 + (int)(*el / 3.0) + rand() % 5 : 0;
+}
+
+/* sentences */
+
+static void fmt_latlon(char *buf, double lat, double lon)
+{
+	double alat = fabs(lat), alon = fabs(lon);
+	int dlat = (int)alat, dlon = (int)alon;
+
+	sprintf(buf, "%02d%07.4f,%c,%03d%07.4f,%c",
+		dlat, (alat - dlat) * 60.0, lat < 0 ? 'S' : 'N',
+		dlon, (alon - dlon) * 60.0, lon < 0 ? 'W' : 'E');
+}
+
+static void epoch(sim_t *sim, double t)
+{
+	uint64_t n = sim->epoch++;
+	double lat, lon, alt, knots, course;
+	char pos[64], hms[32], dmy[32];
+	int ms = (int)(n * sim->fix_ms % 1000);
+	time_t sec = sim->utc0 + (time_t)(n * sim->fix_ms / 1000);
+	struct tm tm;
+	int fix = sim->fix && t >= sim->fix_at;
+
+	sim->cnt.epochs++;
+	if (sim->standby)
+		return;
+	// real modules skip output which does not fit, so do we
+	if (!sim->unlimited && queued(sim) > sim->baud / 10) {
+		sim->cnt.overruns++;
+		return;
+	}
+
+	gmtime_r(&sec, &tm);
+	sprintf(hms, "%02d%02d%02d.%03d", tm.tm_hour, tm.tm_min, tm.tm_sec, ms);
+	sprintf(dmy, "%02d%02d%02d", tm.tm_mday, tm.tm_mon + 1, tm.tm_year % 100);
+	position(sim, t, &lat, &lon, &alt);
+	motion(sim, t, &knots, &course);
+	if (fix)
+		fmt_latlon(pos, lat, lon);
+	else
+		strcpy(pos, ",,,");
+
+	// satellites in view and used
+	int used[12], nused = 0, nview = 0;
+	int prn[SIM_SATS], snr[SIM_SATS], el[SIM_SATS], az[SIM_SATS];
+	for(int i = 0; i < SIM_SATS; i++) {
+		double e, a;
+		int s;
+		sat_pos(&sim->sat[i], t, &e, &a, &s);
+		if (e <= 0)
+			continue;
+		prn[nview] = sim->sat[i].prn;
+		el[nview] = (int)e;
+		az[nview] = (int)a;
+		snr[nview] = fix ? s : 0;
+		if (fix && e > 10 && nused < 12)
+			used[nused++] = sim->sat[i].prn;
+		nview++;
+	}
+
+	#define DUE(o) (sim->out[o] && (n % sim->out[o]) == 0)
+	if (DUE(OUT_GLL))
+		emit(sim, 1, "GPGLL,%s,%s,%c,%c", pos, hms, fix ? 'A' : 'V', fix ? 'A' : 'N');
+	if (DUE(OUT_RMC)) {
+		if (fix)
+			emit(sim, 1, "GPRMC,%s,A,%s,%.2f,%.2f,%s,,,%c", hms, pos, knots, course, dmy, sim->dgps ? 'D' : 'A');
+		else
+			emit(sim, 1, "GPRMC,%s,V,%s,,,%s,,,N", hms, pos, dmy);
+	}
+	if (DUE(OUT_VTG)) {
+		if (fix)
+			emit(sim, 1, "GPVTG,%.2f,T,,M,%.2f,N,%.2f,K,A", course, knots, knots * 1.852);
+		else
+			emit(sim, 1, "GPVTG,,T,,M,,N,,K,N");
+	}
+	if (DUE(OUT_GGA)) {
+		if (fix)
+			emit(sim, 1, "GPGGA,%s,%s,%d,%d,1.03,%.1f,M,55.2,M,,", hms, pos, sim->dgps ? 2 : 1, nused, alt);
+		else
+			emit(sim, 1, "GPGGA,%s,,,,,0,0,,,M,,M,,", hms);
+	}
+	if (DUE(OUT_GSA)) {
+		char list[64] = "";
+		for(int i = 0; i < 12; i++) {
+			char item[8];
+			if (i < nused)
+				sprintf(item, "%02d,", used[i]);
+			else
+				strcpy(item, ",");
+			strcat(list, item);
+		}
+		if (fix)
+			emit(sim, 1, "GPGSA,A,3,%s1.72,1.03,1.38", list);
+		else
+			emit(sim, 1, "GPGSA,A,1,%s,,", list);
+	}
+	if (DUE(OUT_GSV)) {
+		int nmsg = (nview + 3) / 4;
+		if (nmsg == 0)
+			emit(sim, 1, "GPGSV,1,1,00");
+		for(int m = 0; m < nmsg; m++) {
+			char list[80] = "";
+			for(int i = m * 4; i < nview && i < m * 4 + 4; i++) {
+				char item[20];
+				if (snr[i])
+					sprintf(item, ",%02d,%02d,%03d,%02d", prn[i], el[i], az[i], snr[i]);
+				else
+					sprintf(item, ",%02d,%02d,%03d,", prn[i], el[i], az[i]);
+				strcat(list, item);
+			}
+			emit(sim, 1, "GPGSV,%d,%d,%02d%s", nmsg, m + 1, nview, list);
+		}
+	}
+	if (DUE(OUT_ZDA))
+		emit(sim, 1, "GPZDA,%s,%02d,%02d,%04d,,", hms, tm.tm_mday, tm.tm_mon + 1, tm.tm_year + 1900);
+	if (DUE(OUT_MCHN)) {
+		char list[SIM_CHN * 7 + 1] = "";
+		for(int i = 0; i < SIM_CHN; i++) {
+			char item[8];
+			if (i < nview)
+				sprintf(item, ",%02d%02d%d", prn[i], snr[i], (fix && el[i] > 10) ? 2 : 1);
+			else
+				strcpy(item, ",00000");
+			strcat(list, item);
+		}
+		emit(sim, 1, "PMTKCHN%s", list);
+	}
+}
+
+/* commands */
+
+static void ack(sim_t *sim, int cmd, int flag)
+{
+	emit(sim, 0, "PMTK001,%d,%d", cmd, flag);
+	sim->cnt.acks[flag]++;
+}
+
+static void reply(sim_t *sim, const char *fmt, ...)
+{
+	char str[SIM_LINE];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(str, sizeof(str), fmt, ap);
+	va_end(ap);
+	emit(sim, 0, "%s", str);
+	sim->cnt.replies++;
+}
+
+static void restart(sim_t *sim, int cmd, double t)
+{
+	if (cmd == 104)
+		defaults(sim);
+	sim->standby = 0;
+	sim->ohead = sim->otail;
+	// hot start keeps the fix, warm and cold take a while
+	sim->fix_at = t + (cmd == 101 ? 1 : (cmd == 102 ? 5 : 15));
+	emit(sim, 0, "PMTK010,001");
+	emit(sim, 0, "PMTK011,MTKGPS");
+	emit(sim, 0, "PMTK010,002");
+}
+
+static int args(char *str, int *argv, int max)
+{
+	int argc = 0;
+	char *p = strchr(str, ',');
+
+	while(p && argc < max) {
+		argv[argc++] = atoi(p + 1);
+		p = strchr(p + 1, ',');
+	}
+	return argc;
+}
+
+static void pmtk(sim_t *sim, char *str, double t)
+{
+	int cmd = atoi(str + 5);
+	int argv[SIM_NMEA + 1];
+	int argc = args(str, argv, SIM_NMEA + 1);
+
+	switch(cmd) {
+	case 0: // test
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 101: case 102: case 103: case 104:
+		restart(sim, cmd, t);
+		break;
+	case 161:
+		sim->standby = (argc > 0 && argv[0] == 0);
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 184: case 185: case 186: case 187:
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 220:
+		if (argc < 1 || argv[0] < 100 || argv[0] > 10000) {
+			ack(sim, cmd, ACK_INVALID);
+			break;
+		}
+		sim->fix_ms = argv[0];
+		sim->epoch = (uint64_t)(t * 1000.0 / sim->fix_ms) + 1;
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 251: {
+		uint32_t baud = (argc > 0) ? argv[0] : 0;
+		if (baud == 0)
+			baud = 9600;
+		if (tty_speed(baud) == B0) {
+			ack(sim, cmd, ACK_FAILED);
+			break;
+		}
+		// whatever is queued goes out at the old rate, reply at the new one
+		sim->ohead = sim->otail;
+		sim->baud = baud;
+		ack(sim, cmd, ACK_OK);
+		break;
+	}
+	case 253:
+		// binary protocol is not simulated
+		ack(sim, cmd, (argc > 0 && argv[0] == 0) ? ACK_OK : ACK_UNSUPPORTED);
+		break;
+	case 286:
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 300:
+		if (argc < 1 || argv[0] < 100 || argv[0] > 10000) {
+			ack(sim, cmd, ACK_INVALID);
+			break;
+		}
+		sim->fix_ms = argv[0];
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 301:
+		if (argc < 1 || argv[0] < 0 || argv[0] > 2) {
+			ack(sim, cmd, ACK_INVALID);
+			break;
+		}
+		sim->dgps = argv[0];
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 313:
+		sim->sbas = (argc > 0 && argv[0]);
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 314:
+		if (argc == 1 && argv[0] == -1)
+			defaults(sim);
+		else if (argc < SIM_NMEA) {
+			ack(sim, cmd, ACK_INVALID);
+			break;
+		}
+		else {
+			for(int i = 0; i < SIM_NMEA; i++)
+				sim->out[i] = (argv[i] >= 0 && argv[i] <= 5) ? argv[i] : 0;
+		}
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 319:
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 330:
+		if (argc < 1 || argv[0] < 0 || argv[0] > 222) {
+			ack(sim, cmd, ACK_INVALID);
+			break;
+		}
+		sim->datum = argv[0];
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 386:
+		if (argc < 1) {
+			ack(sim, cmd, ACK_INVALID);
+			break;
+		}
+		sim->nav_thr = argv[0];
+		ack(sim, cmd, ACK_OK);
+		break;
+	case 400:
+		reply(sim, "PMTK500,%u,0,0,0.0,0.0", sim->fix_ms);
+		break;
+	case 401:
+		reply(sim, "PMTK501,%d", sim->dgps);
+		break;
+	case 413:
+		reply(sim, "PMTK513,%d", sim->sbas);
+		break;
+	case 414: {
+		char list[SIM_NMEA * 2 + 1] = "";
+		for(int i = 0; i < SIM_NMEA; i++)
+			sprintf(list + i * 2, ",%d", sim->out[i]);
+		reply(sim, "PMTK514%s", list);
+		break;
+	}
+	case 419:
+		reply(sim, "PMTK519,%d", sim->sbas);
+		break;
+	case 430:
+		reply(sim, "PMTK530,%d", sim->datum);
+		break;
+	case 447:
+		reply(sim, "PMTK527,%.2f", sim->nav_thr * 0.2);
+		break;
+	case 605:
+		reply(sim, "PMTK705,AXN_2.31_3339_13101700,5632,PA6H,1.0");
+		break;
+	case 607:
+		reply(sim, "PMTK707,0,0,0,0,0,0,0,0,0");
+		break;
+	case 869:
+		if (argc > 0 && argv[0] == 0) {
+			reply(sim, "PMTK869,2,%d,0", sim->easy);
+			break;
+		}
+		if (argc > 1 && argv[0] == 1)
+			sim->easy = argv[1] ? 1 : 0;
+		ack(sim, cmd, ACK_OK);
+		break;
+	default:
+		ack(sim, cmd, ACK_UNSUPPORTED);
+	}
+}
+
+// one line received from the reader
+static void command(sim_t *sim, char *str, double t)
+{
+	char *star = strrchr(str, '*');
+	uint8_t crc = 0;
+
+	if (str[0] != '$')
+		return;
+	sim->cnt.commands++;
+
+	int valid = (star != NULL);
+	if (valid) {
+		for(char *p = str + 1; p < star; p++)
+			crc ^= *p;
+		valid = (strtol(star + 1, NULL, 16) == crc && isxdigit(star[1]));
+		*star = '\0';
+	}
+
+	if (strncmp(str, "$PMTK", 5) == 0) {
+		if (!valid)
+			ack(sim, atoi(str + 5), ACK_INVALID);
+		else
+			pmtk(sim, str, t);
+	}
+	else if (strncmp(str, "$PGCMD,33,", 10) == 0 && valid)
+		emit(sim, 0, "PGACK,33,%d", atoi(str + 10));
+}
+
+static void receive(sim_t *sim, double t)
+{
+	char buf[1024];
+	ssize_t n = read(sim->master, buf, sizeof(buf));
+	int ok = baud_ok(sim);
+
+	for(ssize_t i = 0; i < n; i++) {
+		// any byte wakes the module up, but is lost
+		if (sim->standby) {
+			sim->standby = 0;
+			continue;
+		}
+		if (!ok) {
+			sim->cnt.garbage++;
+			sim->ilen = 0;
+			continue;
+		}
+		char c = buf[i];
+		if (c == '$')
+			sim->ilen = 0;
+		if (c == '\r' || c == '\n') {
+			if (sim->ilen) {
+				sim->line[sim->ilen] = '\0';
+				command(sim, sim->line, t);
+			}
+			sim->ilen = 0;
+			continue;
+		}
+		if (sim->ilen < SIM_LINE - 1)
+			sim->line[sim->ilen++] = c;
+	}
+}
+
+/* control */
+
+static void print_stat(sim_t *sim)
+{
+	counters_t *c = &sim->cnt;
+
+	fprintf(stderr, "baud %u rate %u ms: epochs %llu overruns %llu sentences %llu bytes %llu\n",
+		sim->baud, sim->fix_ms, (unsigned long long)c->epochs, (unsigned long long)c->overruns,
+		(unsigned long long)c->sentences, (unsigned long long)c->bytes);
+	fprintf(stderr, "commands %llu ack invalid %llu unsupported %llu failed %llu ok %llu replies %llu\n",
+		(unsigned long long)c->commands, (unsigned long long)c->acks[0], (unsigned long long)c->acks[1],
+		(unsigned long long)c->acks[2], (unsigned long long)c->acks[3], (unsigned long long)c->replies);
+	fprintf(stderr, "injected crc %llu trunc %llu dropped %llu, garbage bytes %llu\n",
+		(unsigned long long)c->crc, (unsigned long long)c->trunc,
+		(unsigned long long)c->dropped, (unsigned long long)c->garbage);
+}
+
+static void control(sim_t *sim, const char *str, double t)
+{
+	char cmd[16], arg[32] = "";
+
+	if (sscanf(str, "%15s %31s", cmd, arg) < 1)
+		return;
+	if (!strcmp(cmd, "crc"))
+		sim->crc_pct = atof(arg);
+	else if (!strcmp(cmd, "trunc"))
+		sim->trunc_pct = atof(arg);
+	else if (!strcmp(cmd, "drop"))
+		sim->drop_until = t + atof(arg);
+	else if (!strcmp(cmd, "fix")) {
+		sim->fix = !strcmp(arg, "on");
+		sim->fix_at = t;
+	}
+	else if (!strcmp(cmd, "rate") && atoi(arg) >= 1 && atoi(arg) <= 10) {
+		sim->fix_ms = 1000 / atoi(arg);
+		sim->epoch = (uint64_t)(t * 1000.0 / sim->fix_ms) + 1;
+	}
+	else if (!strcmp(cmd, "baud") && tty_speed(atoi(arg)) != B0)
+		sim->baud = atoi(arg);
+	else if (!strcmp(cmd, "stat"))
+		print_stat(sim);
+	else if (!strcmp(cmd, "quit"))
+		running = 0;
+	else {
+		fprintf(stderr, "unknown command '%s'\n", str);
+		return;
+	}
+	if (!sim->quiet)
+		fprintf(stderr, "%.1f: %s", t, str);
+}
+
+static int load_script(sim_t *sim, const char *path)
+{
+	char line[256];
+	FILE *fp = fopen(path, "r");
+
+	if (fp == NULL)
+		return -1;
+	while(fgets(line, sizeof(line), fp)) {
+		char *p = line + strspn(line, " \t");
+		if (*p == '#' || *p == '\n' || *p == '\0')
+			continue;
+		if (*p == '@' && sim->nev < SIM_EVENTS) {
+			event_t *e = &sim->ev[sim->nev];
+			int n;
+			if (sscanf(p + 1, "%lf %n", &e->t, &n) == 1) {
+				snprintf(e->cmd, sizeof(e->cmd), "%s", p + 1 + n);
+				sim->nev++;
+			}
+			continue;
+		}
+		waypt_t *w = &sim->wp[sim->nwp];
+		if (sim->nwp < SIM_WAYPTS && sscanf(p, "%lf %lf %lf %lf", &w->t, &w->lat, &w->lon, &w->alt) == 4)
+			sim->nwp++;
+	}
+	fclose(fp);
+	return 0;
+}
+
+static int open_pty(sim_t *sim, const char *link)
+{
+	struct termios tio;
+
+	sim->master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (sim->master < 0 || grantpt(sim->master) < 0 || unlockpt(sim->master) < 0)
+		return -1;
+	const char *name = ptsname(sim->master);
+	sim->slave = open(name, O_RDWR | O_NOCTTY);
+	if (sim->slave < 0 || tcgetattr(sim->slave, &tio) < 0)
+		return -1;
+	// raw at our baud rate until the reader sets its own
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, tty_speed(sim->baud));
+	cfsetospeed(&tio, tty_speed(sim->baud));
+	tcsetattr(sim->slave, TCSANOW, &tio);
+	fcntl(sim->master, F_SETFL, O_NONBLOCK);
+
+	if (link) {
+		unlink(link);
+		if (symlink(name, link) < 0)
+			return -1;
+	}
+	printf("%s\n", link ? link : name);
+	fflush(stdout);
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [-b baud] [-r hz] [-s script] [-l link] [-u] [-a] [-q]\n", name);
+	printf("  -b  initial baud rate, default 9600\n");
+	printf("  -r  update rate 1-10 Hz, default 1\n");
+	printf("  -s  trajectory and events script\n");
+	printf("  -l  symlink to the pty, e.g. /tmp/gps\n");
+	printf("  -u  unlimited output, do not pace to baud rate\n");
+	printf("  -a  accept any reader baud rate\n");
+	printf("  -q  do not echo commands\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	static sim_t sim;
+	const char *script = NULL, *link = NULL;
+	int hz = 1;
+	int opt;
+
+	sim.baud = 9600;
+	while((opt = getopt(argc, argv, "b:r:s:l:uaq")) != -1) {
+		switch(opt) {
+		case 'b': sim.baud = atoi(optarg); break;
+		case 'r': hz = atoi(optarg); break;
+		case 's': script = optarg; break;
+		case 'l': link = optarg; break;
+		case 'u': sim.unlimited = 1; break;
+		case 'a': sim.anybaud = 1; break;
+		case 'q': sim.quiet = 1; break;
+		default: usage(argv[0]);
+		}
+	}
+	if (tty_speed(sim.baud) == B0 || hz < 1 || hz > 10)
+		usage(argv[0]);
+
+	defaults(&sim);
+	sim.fix_ms = 1000 / hz;
+	sim.fix = 1;
+	for(int i = 0; i < SIM_SATS; i++) {
+		sim.sat[i].prn = (i * 7) % 32 + 1;
+		sim.sat[i].az = i * 360.0 / SIM_SATS;
+		sim.sat[i].phase = i * 0.9;
+	}
+	if (script && load_script(&sim, script) < 0) {
+		perror(script);
+		return 1;
+	}
+	if (open_pty(&sim, link) < 0) {
+		perror("pty");
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	srand(time(NULL));
+	sim.utc0 = time(NULL);
+	sim.t0 = now_sec();
+
+	while(running) {
+		double t = now_sec() - sim.t0;
+		double next = sim.epoch * sim.fix_ms / 1000.0;
+		int timeout = (int)((next - t) * 1000) + 1;
+
+		// pacing needs to wake up while there is output
+		if (queued(&sim) && (timeout > 5 || timeout < 0))
+			timeout = 5;
+		if (timeout < 0)
+			timeout = 0;
+
+		struct pollfd pfd[2];
+		pfd[0].fd = sim.master;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = STDIN_FILENO;
+		pfd[1].events = POLLIN;
+		if (poll(pfd, 2, timeout) < 0 && errno != EINTR)
+			break;
+
+		t = now_sec() - sim.t0;
+		if (pfd[0].revents & POLLIN)
+			receive(&sim, t);
+		if (pfd[1].revents & POLLIN) {
+			char line[128];
+			if (fgets(line, sizeof(line), stdin))
+				control(&sim, line, t);
+			else
+				pfd[1].fd = -1;
+		}
+		while(sim.iev < sim.nev && sim.ev[sim.iev].t <= t)
+			control(&sim, sim.ev[sim.iev++].cmd, t);
+		if (t >= sim.epoch * sim.fix_ms / 1000.0)
+			epoch(&sim, t);
+		flush_out(&sim, now_sec() - sim.t0);
+	}
+
+	print_stat(&sim);
+	if (link)
+		unlink(link);
+	return 0;
+}
@@ -0,0 +1,183 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+/*
+	Replays raw GPS recording (see gpsrec.h, 'gps record' in gps_terminal)
+	through MtkGps attached to an in-memory GpsMemPort, with the
+	original timing, N times faster or as fast as possible. At maximum
+	speed it is a benchmark of the whole read, frame, parse and callback
+	path on real receiver data.
+
+	g++ -O2 -I../.. -o gps_replay gps_replay.cpp ../../MtkGps.cpp ../../GpsPort.cpp \
+		../../GpsFilter.cpp ../../nmea.c ../../gpstime.c ../../lathist.c \
+		../../gpsrec.c ../../ttyfd.c
+	./gps_replay [-s speed|max] [-l loops] [-v] recording
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <MtkGps.h>
+
+#define REPLAY_BUF 65536
+
+static GpsMemPort port;
+static MtkGps gps;
+static int verbose;
+static uint64_t nsentences;
+
+static void on_nmea(MtkGps *gps, int nmea_type, void *data)
+{
+	(void)gps;
+	(void)nmea_type;
+	(void)data;
+	nsentences++;
+}
+
+static uint64_t now_us(void)
+{
+	return lat_clock() / 1000;
+}
+
+static void wait_until(uint64_t usec)
+{
+	struct timespec ts;
+	ts.tv_sec = usec / 1000000;
+	ts.tv_nsec = (usec % 1000000) * 1000;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0);
+}
+
+// one pass over the recording, returns 0 or -1 on error
+static int replay(const char *path, double speed, uint64_t *duration)
+{
+	static char buf[REPLAY_BUF];
+	gpsrec_t rec;
+	uint64_t usec, start;
+	int len;
+
+	if (gpsrec_open(&rec, path) != 0) {
+		fprintf(stderr, "%s: not a GPS recording\n", path);
+		return -1;
+	}
+
+	start = now_us();
+	while((len = gpsrec_read(&rec, &usec, buf, sizeof(buf))) > 0) {
+		if (speed > 0)
+			wait_until(start + (uint64_t)(usec / speed));
+		port.feed(buf, len);
+		const char *nmea;
+		while((nmea = gps.read()) != NULL) {
+			if (verbose)
+				printf("%s\n", nmea);
+			gps.parse_nmea(nmea);
+		}
+	}
+	*duration = rec.t_last;
+	gpsrec_close(&rec);
+	if (len < 0) {
+		fprintf(stderr, "%s: broken recording\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-s speed|max] [-l loops] [-v] recording\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	double speed = 1.0;
+	int loops = 1;
+	int opt;
+
+	while((opt = getopt(argc, argv, "s:l:v")) != -1) {
+		switch(opt) {
+		case 's':
+			speed = strcmp(optarg, "max") ? atof(optarg) : 0;
+			if (speed < 0)
+				usage(argv[0]);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind >= argc || loops < 1)
+		usage(argv[0]);
+
+	gps.attach(&port);
+	gps.setHandler(on_nmea);
+
+	uint64_t duration = 0;
+	uint64_t t_start = now_us();
+	for(int i = 0; i < loops; i++) {
+		if (replay(argv[optind], speed, &duration) != 0)
+			return 1;
+	}
+	uint64_t elapsed = now_us() - t_start;
+	if (elapsed == 0)
+		elapsed = 1;
+
+	gps_stat_t st;
+	gps.getStat(&st);
+	printf("recording %.3f sec, replayed %d times in %.3f sec, x%.1f\n",
+		duration / 1e6, loops, elapsed / 1e6, (double)duration * loops / elapsed);
+	printf("%u bytes %llu sentences: %.2f MB/s %.0f sentences/s %.0f nsec/sentence\n",
+		st.rx, (unsigned long long)nsentences, st.rx / (double)elapsed,
+		nsentences * 1e6 / elapsed, nsentences ? elapsed * 1e3 / nsentences : 0.0);
+	printf("discarded %u truncated %u crc %u unknown %u\n",
+		st.discarded, st.truncated, st.crc_errors, st.unknown);
+
+	static const int types[] = {
+		NMEA_SEN_GLL, NMEA_SEN_RMC, NMEA_SEN_VTG, NMEA_SEN_GGA,
+		NMEA_SEN_GSA, NMEA_SEN_GSV, NMEA_SEN_ZDA, NMEA_SEN_MCHN,
+		NMEA_SEN_MTK, NMEA_SEN_PGACK, NMEA_SEN_PGTOP, NMEA_INVALID
+	};
+	printf("type     count  errors  parse p50/p99  total p50/p99 usec\n");
+	for(unsigned i = 0; i < sizeof(types)/sizeof(types[0]); i++) {
+		int idx = nmea_type_index(types[i]);
+		const lat_hist_t *parse = gps.getLatency(types[i], LAT_PARSE);
+		const lat_hist_t *total = gps.getLatency(types[i], LAT_TOTAL);
+		if (st.sentences[idx] == 0 && st.parse_errors[idx] == 0)
+			continue;
+		printf("%-5s %8u %7u %7u/%-7u %7u/%-7u\n", nmea_type_name(idx),
+			st.sentences[idx], st.parse_errors[idx],
+			lat_hist_percentile(parse, 50), lat_hist_percentile(parse, 99),
+			lat_hist_percentile(total, 50), lat_hist_percentile(total, 99));
+	}
+	return 0;
+}
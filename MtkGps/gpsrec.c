@@ -0,0 +1,182 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <time.h>
+#include <string.h>
+
+#include "gpsrec.h"
+#include "lathist.h"
+
+static const char magic[6] = { 'M', 'T', 'K', 'R', 'E', 'C' };
+
+static void put_le(uint8_t *buf, uint64_t val, int len)
+{
+	int i;
+	for(i = 0; i < len; i++, val >>= 8)
+		buf[i] = (uint8_t)val;
+}
+
+static uint64_t get_le(const uint8_t *buf, int len)
+{
+	uint64_t val = 0;
+	while(len--)
+		val = (val << 8) | buf[len];
+	return val;
+}
+
+static int put_varint(uint8_t *buf, uint64_t val)
+{
+	int len = 0;
+	while(val >= 0x80) {
+		buf[len++] = (uint8_t)val | 0x80;
+		val >>= 7;
+	}
+	buf[len++] = (uint8_t)val;
+	return len;
+}
+
+static int get_varint(FILE *fp, uint64_t *val)
+{
+	int c, shift = 0;
+
+	*val = 0;
+	do {
+		if ((c = getc(fp)) == EOF || shift > 63)
+			return -1;
+		*val |= (uint64_t)(c & 0x7F) << shift;
+		shift += 7;
+	} while(c & 0x80);
+
+	return 0;
+}
+
+int gpsrec_create(gpsrec_t *rec, const char *path, uint32_t baud)
+{
+	uint8_t hdr[GPSREC_HDR_LEN];
+	struct timespec ts;
+
+	memset(rec, 0, sizeof(gpsrec_t));
+	rec->fp = fopen(path, "wb");
+	if (rec->fp == NULL)
+		return -1;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	rec->rec = 1;
+	rec->baud = baud;
+	rec->start = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	rec->t_last = rec->t_flush = lat_clock() / 1000;
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, magic, sizeof(magic));
+	hdr[6] = GPSREC_VERSION;
+	put_le(hdr + 8, baud, 4);
+	put_le(hdr + 16, rec->start, 8);
+	if (fwrite(hdr, sizeof(hdr), 1, rec->fp) != 1) {
+		gpsrec_close(rec);
+		return -1;
+	}
+	return 0;
+}
+
+int gpsrec_write(gpsrec_t *rec, const void *data, unsigned len)
+{
+	uint8_t hdr[20];
+	uint64_t now;
+	int n;
+
+	if (rec->fp == NULL || !rec->rec)
+		return -1;
+
+	now = lat_clock() / 1000;
+	n = put_varint(hdr, now - rec->t_last);
+	n += put_varint(hdr + n, len);
+	rec->t_last = now;
+
+	if (fwrite(hdr, n, 1, rec->fp) != 1 || fwrite(data, len, 1, rec->fp) != 1)
+		return -1;
+	rec->chunks++;
+	rec->bytes += len;
+
+	// do not lose much if power is cut in the field
+	if ((now - rec->t_flush) >= GPSREC_FLUSH) {
+		rec->t_flush = now;
+		fflush(rec->fp);
+	}
+	return 0;
+}
+
+int gpsrec_open(gpsrec_t *rec, const char *path)
+{
+	uint8_t hdr[GPSREC_HDR_LEN];
+
+	memset(rec, 0, sizeof(gpsrec_t));
+	rec->fp = fopen(path, "rb");
+	if (rec->fp == NULL)
+		return -1;
+
+	if (fread(hdr, sizeof(hdr), 1, rec->fp) != 1 ||
+		memcmp(hdr, magic, sizeof(magic)) != 0 || hdr[6] != GPSREC_VERSION) {
+		gpsrec_close(rec);
+		return -1;
+	}
+	rec->baud = (uint32_t)get_le(hdr + 8, 4);
+	rec->start = get_le(hdr + 16, 8);
+	return 0;
+}
+
+int gpsrec_read(gpsrec_t *rec, uint64_t *usec, void *buf, unsigned size)
+{
+	uint64_t delta, len;
+
+	if (rec->fp == NULL || rec->rec)
+		return -1;
+
+	if (get_varint(rec->fp, &delta) != 0)
+		return feof(rec->fp) ? 0 : -1;
+	if (get_varint(rec->fp, &len) != 0 || len > size)
+		return -1;
+	if (len && fread(buf, len, 1, rec->fp) != 1)
+		return -1;
+
+	rec->t_last += delta;
+	rec->chunks++;
+	rec->bytes += len;
+	*usec = rec->t_last;
+	return (int)len;
+}
+
+int gpsrec_close(gpsrec_t *rec)
+{
+	int ret = 0;
+
+	if (rec->fp) {
+		ret = fclose(rec->fp);
+		rec->fp = NULL;
+	}
+	return ret ? -1 : 0;
+}
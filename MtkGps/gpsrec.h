@@ -0,0 +1,88 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifndef __MTK_GPS_REC_H__
+#define __MTK_GPS_REC_H__
+
+/*
+	Raw GPS stream recording: every block of bytes read from the receiver
+	is stored with CLOCK_MONOTONIC time elapsed since the previous block,
+	so a recording can be replayed with the original timing.
+
+	File format, all numbers little endian:
+	  header: "MTKREC" version(1) flags(1) baud(4) reserved(4) start(8)
+	          start is CLOCK_REALTIME nanoseconds of gpsrec_create()
+	  chunk:  delta usec (varint) length (varint) data
+	varint is 7 bits per byte, least significant first, high bit set
+	if more bytes follow; typical chunk overhead is 3-4 bytes
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define GPSREC_VERSION 1
+#define GPSREC_HDR_LEN 24
+#define GPSREC_FLUSH   1000000 // usec, recording is flushed at least that often
+
+typedef struct gpsrec_s
+{
+	FILE    *fp;
+	int      rec;    // 1 if recording, 0 if opened for replay
+	uint32_t baud;   // receiver baud rate at the time of recording
+	uint64_t start;  // realtime nanoseconds when recording started
+	uint64_t t_last; // usec, last chunk time: monotonic if recording,
+	                 // since start of recording if replaying
+	uint64_t t_flush;
+	uint32_t chunks;
+	uint64_t bytes;
+} gpsrec_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* create new recording, returns 0 or -1 */
+int gpsrec_create(gpsrec_t *rec, const char *path, uint32_t baud);
+/* add a block of received data, returns 0 or -1 on write error */
+int gpsrec_write(gpsrec_t *rec, const void *data, unsigned len);
+
+/* open recording for replay, returns 0 or -1 if not a recording */
+int gpsrec_open(gpsrec_t *rec, const char *path);
+/* read next block, usec is set to its time since the start of recording;
+   returns block length, 0 at the end of recording, -1 on error or
+   if the block is longer than size */
+int gpsrec_read(gpsrec_t *rec, uint64_t *usec, void *buf, unsigned size);
+
+/* flush and close either */
+int gpsrec_close(gpsrec_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,174 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <stddef.h>
+
+#include "gpstime.h"
+
+int32_t gps_days_from_civil(int32_t y, uint32_t m, uint32_t d)
+{
+	y -= m <= 2;
+	int32_t  era = (y >= 0 ? y : y - 399) / 400;
+	uint32_t yoe = (uint32_t)(y - era * 400);                   // [0, 399]
+	uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1; // [0, 365]
+	uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;       // [0, 146096]
+	return era * 146097 + (int32_t)doe - 719468;
+}
+
+void gps_civil_from_days(int32_t days, int32_t *y, uint32_t *m, uint32_t *d)
+{
+	days += 719468;
+	int32_t  era = (days >= 0 ? days : days - 146096) / 146097;
+	uint32_t doe = (uint32_t)(days - era * 146097);
+	uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	uint32_t mp  = (5 * doy + 2) / 153;
+
+	*d = doy - (153 * mp + 2) / 5 + 1;
+	*m = mp < 10 ? mp + 3 : mp - 9;
+	*y = (int32_t)yoe + era * 400 + (*m <= 2);
+}
+
+int64_t gps_time_ns(gpstime_t *cache, uint32_t ddmmyy, uint32_t hhmmss, uint32_t msec)
+{
+	int32_t days;
+
+	if (cache && cache->date == ddmmyy)
+		days = cache->days;
+	else {
+		uint32_t yy = ddmmyy % 100;
+		// NMEA has two digits year only
+		days = gps_days_from_civil(yy < 80 ? 2000 + yy : 1900 + yy,
+			(ddmmyy / 100) % 100, ddmmyy / 10000);
+		if (cache) {
+			cache->date = ddmmyy;
+			cache->days = days;
+		}
+	}
+
+	uint32_t sec = (hhmmss / 10000) * 3600 + ((hhmmss / 100) % 100) * 60 + hhmmss % 100;
+	return (int64_t)days * GPS_NSEC_PER_DAY + (int64_t)sec * GPS_NSEC_PER_SEC +
+		(int64_t)msec * 1000000;
+}
+
+void gps_time_tm(int64_t ns, struct tm *tm)
+{
+	int64_t days = ns / GPS_NSEC_PER_DAY;
+	int64_t rem  = ns % GPS_NSEC_PER_DAY;
+	if (rem < 0) {
+		rem += GPS_NSEC_PER_DAY;
+		days--;
+	}
+
+	int32_t  y;
+	uint32_t m, d;
+	gps_civil_from_days((int32_t)days, &y, &m, &d);
+
+	uint32_t sec = (uint32_t)(rem / GPS_NSEC_PER_SEC);
+	tm->tm_sec   = sec % 60;
+	tm->tm_min   = (sec / 60) % 60;
+	tm->tm_hour  = sec / 3600;
+	tm->tm_mday  = d;
+	tm->tm_mon   = m - 1;
+	tm->tm_year  = y - 1900;
+	// 1970-01-01 was Thursday
+	tm->tm_wday  = (int)((days % 7 + 11) % 7);
+	tm->tm_yday  = (int)(days - gps_days_from_civil(y, 1, 1));
+	tm->tm_isdst = 0;
+}
+
+static const char digits2[] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static inline char *put2(char *buf, uint32_t val)
+{
+	const char *src = &digits2[(val % 100) * 2];
+	buf[0] = src[0];
+	buf[1] = src[1];
+	return buf + 2;
+}
+
+int gps_time_iso8601(char *buf, int64_t ns, int tzone, int digits)
+{
+	struct tm tm;
+	char *out = buf;
+
+	gps_time_tm(ns + tzone * GPS_NSEC_PER_MIN, &tm);
+
+	uint32_t year = tm.tm_year + 1900;
+	out = put2(out, year / 100);
+	out = put2(out, year);
+	*out++ = '-';
+	out = put2(out, tm.tm_mon + 1);
+	*out++ = '-';
+	out = put2(out, tm.tm_mday);
+	*out++ = 'T';
+	out = put2(out, tm.tm_hour);
+	*out++ = ':';
+	out = put2(out, tm.tm_min);
+	*out++ = ':';
+	out = put2(out, tm.tm_sec);
+
+	if (digits > 0) {
+		if (digits > 9)
+			digits = 9;
+		int i;
+		int64_t frac = ns % GPS_NSEC_PER_SEC;
+		if (frac < 0)
+			frac += GPS_NSEC_PER_SEC;
+		*out++ = '.';
+		for(i = digits; i < 9; i++)
+			frac /= 10;
+		for(i = digits - 1; i >= 0; i--) {
+			out[i] = '0' + frac % 10;
+			frac /= 10;
+		}
+		out += digits;
+	}
+
+	if (tzone == 0)
+		*out++ = 'Z';
+	else {
+		if (tzone < 0) {
+			*out++ = '-';
+			tzone = -tzone;
+		}
+		else
+			*out++ = '+';
+		out = put2(out, tzone / 60);
+		*out++ = ':';
+		out = put2(out, tzone % 60);
+	}
+	*out = '\0';
+
+	return out - buf;
+}
@@ -0,0 +1,78 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifndef __MTK_GPS_TIME_H__
+#define __MTK_GPS_TIME_H__
+
+/*
+	NMEA date/time to UTC nanoseconds since Epoch conversion without
+	mktime() and libc TZ handling, local time is a fixed offset from UTC.
+	Days/civil date conversion as described by Howard Hinnant in
+	http://howardhinnant.github.io/date_algorithms.html
+*/
+
+#include <stdint.h>
+#include <time.h>
+
+#define GPS_NSEC_PER_SEC 1000000000ll
+#define GPS_NSEC_PER_MIN (60ll*GPS_NSEC_PER_SEC)
+#define GPS_NSEC_PER_DAY (86400ll*GPS_NSEC_PER_SEC)
+
+// "2015-08-17T12:34:56.789+01:00" and terminating '\0'
+#define GPS_ISO8601_LEN 32
+
+// last converted date, day number is recalculated only when date changes
+typedef struct gpstime_s
+{
+	uint32_t date; // ddmmyy
+	int32_t  days; // days since 1970-01-01
+} gpstime_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* days since 1970-01-01 for year, month 1-12 and day 1-31 */
+int32_t gps_days_from_civil(int32_t y, uint32_t m, uint32_t d);
+/* year, month 1-12 and day 1-31 for days since 1970-01-01 */
+void gps_civil_from_days(int32_t days, int32_t *y, uint32_t *m, uint32_t *d);
+
+/* NMEA ddmmyy date, hhmmss time and milliseconds to UTC nanoseconds since Epoch,
+   cache can be NULL */
+int64_t gps_time_ns(gpstime_t *cache, uint32_t ddmmyy, uint32_t hhmmss, uint32_t msec);
+/* break nanoseconds since Epoch down to struct tm, tm_year since 1900, tm_mon 0-11 */
+void gps_time_tm(int64_t ns, struct tm *tm);
+/* format nanoseconds since Epoch as ISO-8601 string with tzone offset in minutes
+   and 0-9 digits of second fraction, returns string length */
+int gps_time_iso8601(char *buf, int64_t ns, int tzone, int digits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,126 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <time.h>
+#include <string.h>
+
+#include "lathist.h"
+
+uint64_t lat_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void lat_hist_reset(lat_hist_t *hist)
+{
+	memset(hist, 0, sizeof(lat_hist_t));
+	hist->min = UINT32_MAX;
+}
+
+uint32_t lat_hist_index(uint32_t usec)
+{
+	if (usec < LAT_SUB_COUNT)
+		return usec;
+
+	uint32_t msb = 31 - __builtin_clz(usec);
+	if (msb >= LAT_MAX_BITS)
+		return LAT_BUCKETS - 1;
+
+	return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) +
+		((usec >> (msb - LAT_SUB_BITS)) & (LAT_SUB_COUNT - 1));
+}
+
+uint32_t lat_hist_lower(uint32_t idx)
+{
+	if (idx < LAT_SUB_COUNT)
+		return idx;
+
+	uint32_t shift = (idx >> LAT_SUB_BITS) - 1;
+	return (LAT_SUB_COUNT + (idx & (LAT_SUB_COUNT - 1))) << shift;
+}
+
+uint32_t lat_hist_upper(uint32_t idx)
+{
+	if (idx < LAT_SUB_COUNT)
+		return idx;
+
+	uint32_t shift = (idx >> LAT_SUB_BITS) - 1;
+	return lat_hist_lower(idx) + (1u << shift) - 1;
+}
+
+void lat_hist_add(lat_hist_t *hist, uint32_t usec)
+{
+	hist->bucket[lat_hist_index(usec)]++;
+	hist->count++;
+	hist->sum += usec;
+	if (usec < hist->min)
+		hist->min = usec;
+	if (usec > hist->max)
+		hist->max = usec;
+}
+
+void lat_hist_add_span(lat_hist_t *hist, uint64_t start, uint64_t end)
+{
+	uint64_t usec = (end > start) ? (end - start) / 1000 : 0;
+	if (usec > UINT32_MAX)
+		usec = UINT32_MAX;
+	lat_hist_add(hist, (uint32_t)usec);
+}
+
+uint32_t lat_hist_percentile(const lat_hist_t *hist, double pct)
+{
+	uint32_t i;
+
+	if (hist->count == 0)
+		return 0;
+
+	// rank of the sample we are looking for, 1 based
+	uint64_t rank = (uint64_t)(pct * hist->count / 100.0 + 0.5);
+	if (rank == 0)
+		rank = 1;
+
+	uint64_t total = 0;
+	for(i = 0; i < LAT_BUCKETS; i++) {
+		total += hist->bucket[i];
+		if (total >= rank) {
+			uint32_t val = lat_hist_upper(i);
+			return (val > hist->max) ? hist->max : val;
+		}
+	}
+	return hist->max;
+}
+
+uint32_t lat_hist_mean(const lat_hist_t *hist)
+{
+	if (hist->count == 0)
+		return 0;
+	return (uint32_t)(hist->sum / hist->count);
+}
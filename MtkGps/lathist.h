@@ -0,0 +1,82 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifndef __MTK_LAT_HIST_H__
+#define __MTK_LAT_HIST_H__
+
+/*
+	Log-linear latency histogram: values below LAT_SUB_COUNT are counted
+	exactly, every next power of two is split into LAT_SUB_COUNT linear
+	sub-buckets, so relative error stays below 1/LAT_SUB_COUNT (12.5%).
+	Values are in microseconds, anything above 2^LAT_MAX_BITS goes
+	to the last bucket.
+*/
+
+#include <stdint.h>
+
+#define LAT_SUB_BITS  3
+#define LAT_SUB_COUNT (1 << LAT_SUB_BITS)
+#define LAT_MAX_BITS  26 // 2^26 usec, about 67 seconds
+#define LAT_BUCKETS   ((LAT_MAX_BITS - LAT_SUB_BITS + 1) * LAT_SUB_COUNT)
+
+typedef struct lat_hist_s
+{
+	uint32_t count;
+	uint32_t min;  // usec
+	uint32_t max;  // usec
+	uint64_t sum;  // usec
+	uint32_t bucket[LAT_BUCKETS];
+} lat_hist_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CLOCK_MONOTONIC time in nanoseconds */
+uint64_t lat_clock(void);
+
+void lat_hist_reset(lat_hist_t *hist);
+/* add a sample in microseconds */
+void lat_hist_add(lat_hist_t *hist, uint32_t usec);
+/* add a sample as a difference of two lat_clock() stamps */
+void lat_hist_add_span(lat_hist_t *hist, uint64_t start, uint64_t end);
+/* value (upper bound of the bucket) below which 'pct' percent of samples fall */
+uint32_t lat_hist_percentile(const lat_hist_t *hist, double pct);
+/* average value in microseconds */
+uint32_t lat_hist_mean(const lat_hist_t *hist);
+
+/* bucket index for a value and value range for a bucket index */
+uint32_t lat_hist_index(uint32_t usec);
+uint32_t lat_hist_lower(uint32_t idx);
+uint32_t lat_hist_upper(uint32_t idx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
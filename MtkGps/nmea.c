@@ -79,6 +79,31 @@ int nmea_get_type(const char *nmea)
 	return NMEA_INVALID;
 }
 
+int nmea_type_index(int type)
+{
+	if (type & 0x00FF)
+		return __builtin_ctz(type);
+	if (type == NMEA_SEN_MTK)
+		return NMEA_IDX_MTK;
+	if (type == NMEA_SEN_PGACK)
+		return NMEA_IDX_PGACK;
+	if (type == NMEA_SEN_PGTOP)
+		return NMEA_IDX_PGTOP;
+	return NMEA_IDX_OTHER;
+}
+
+static const char *type_name[NMEA_NTYPES] = {
+	"GLL", "RMC", "VTG", "GGA", "GSA", "GSV", "ZDA", "CHN",
+	"MTK", "PGACK", "PGTOP", "other"
+};
+
+const char *nmea_type_name(int idx)
+{
+	if (idx < 0 || idx >= NMEA_NTYPES)
+		idx = NMEA_IDX_OTHER;
+	return type_name[idx];
+}
+
 // extracts an item from the nmea string
 const char *nmea_get_item(const char *nmea, char *item)
 {
@@ -59,6 +59,13 @@
 #define NMEA_SEN_PGACK	0x4000 // PGACK sentence
 #define NMEA_SEN_PGTOP	0x2000 // PGTOP sentence
 
+/* NMEA_SEN_* type index, to keep per-type data in plain arrays */
+#define NMEA_IDX_MTK	8
+#define NMEA_IDX_PGACK	9
+#define NMEA_IDX_PGTOP	10
+#define NMEA_IDX_OTHER	11 // NMEA_INVALID or not supported
+#define NMEA_NTYPES		12
+
 #define NMEA_VALID		0x0001
 #define NMEA_LAT_SOUTH	0x0002
 #define NMEA_LON_WEST	0x0004
@@ -197,6 +204,10 @@ extern "C" {
 int nmea_is_valid(const char *nmea);
 /* returns NMEA_SEN_* types */
 int nmea_get_type(const char *nmea);
+/* converts NMEA_SEN_* type to 0...NMEA_NTYPES-1 index */
+int nmea_type_index(int type);
+/* short name of the type index: "GGA", "RMC", ... */
+const char *nmea_type_name(int idx);
 
 // extracts an item from the nmea string
 #define NMEA_MAX_ITEM_LEN 64
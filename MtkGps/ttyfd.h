@@ -0,0 +1,61 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifndef __MTK_TTY_FD_H__
+#define __MTK_TTY_FD_H__
+
+/*
+	Raw serial port access through file descriptors, for ports not
+	managed by Galileo TTYUARTClass or to be waited on with poll/epoll
+*/
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* open serial device in raw non-blocking mode, returns fd or -1 */
+int tty_open(const char *dev, uint32_t baud);
+/* change baud rate of the opened serial device */
+int tty_set_baud(int fd, uint32_t baud);
+/* VMIN/VTIME: read() returns when vmin bytes are received or the line
+   was idle for vtime tenths of a second after the first byte (vmin 0:
+   vtime after the call); non-zero values switch fd to blocking mode,
+   both zero restore non-blocking mode */
+int tty_set_timeouts(int fd, uint8_t vmin, uint8_t vtime);
+/* serial driver low latency mode (ASYNC_LOW_LATENCY): received data is
+   pushed to the reader at once instead of on the next driver tick,
+   returns -1 if the driver does not support it (ptys, some USB serial) */
+int tty_set_low_latency(int fd, int on);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -36,6 +36,13 @@ public:
 	virtual void putch(uint8_t c) = 0;
 	virtual void puts(const char *str) = 0;
 	virtual int	 print(const char *format, ...) = 0;
+	/* write len bytes, used by TPRINT() formatter (TermFormat.h) */
+	virtual void write(const char *data, unsigned len) {
+		while(len--)
+			putch(*data++);
+	}
+	/* send buffered output, if any */
+	virtual void flush(void) {}
 };
 
 #endif
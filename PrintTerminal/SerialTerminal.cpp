@@ -35,6 +35,11 @@ SerialTerminal::SerialTerminal(unsigned maxlen)
 	flags = F_ECHO;
 	port = NULL;
 	esc = idx = 0;
+	obuf = NULL;
+	osize = olen = 0;
+	otime = odelay = 0;
+	drate = dtokens = dtime = dskipped = 0;
+	buffering(TERM_OUT_LEN);
 
 	// allocate buffer ones...
 	buffer = (char *)malloc(maxlen+2);
@@ -51,6 +56,57 @@ SerialTerminal::~SerialTerminal(void)
 		free(buffer);
 		buffer = NULL;
 	}
+	if (obuf) {
+		free(obuf);
+		obuf = NULL;
+	}
+}
+
+int SerialTerminal::buffering(unsigned size, uint32_t delay, bool line)
+{
+	flush();
+	if (size != osize) {
+		free(obuf);
+		obuf = size ? (char *)malloc(size) : NULL;
+		osize = obuf ? size : 0;
+	}
+	odelay = delay;
+	if (line)
+		flags |= F_LINE;
+	else
+		flags &= ~F_LINE;
+	return (osize == size) ? 0 : -1;
+}
+
+void SerialTerminal::flush(void)
+{
+	if (olen && port)
+		port->write((const uint8_t *)obuf, olen);
+	olen = 0;
+}
+
+void SerialTerminal::write(const char *data, unsigned size)
+{
+	if (port == NULL)
+		return;
+
+	if (olen && (olen + size) > osize)
+		flush();
+	// too big to be buffered
+	if (size >= osize) {
+		port->write((const uint8_t *)data, size);
+		return;
+	}
+
+	if (olen == 0)
+		otime = millis();
+	memcpy(obuf + olen, data, size);
+	olen += size;
+
+	if ((flags & F_LINE) && memchr(data, '\n', size))
+		flush();
+	else if (olen == osize || (odelay && (millis() - otime) >= odelay))
+		flush();
 }
 
 int	SerialTerminal::print(const char *format, ...)
@@ -65,24 +121,19 @@ int	SerialTerminal::print(const char *format, ...)
 	if (retval < 0 || (len > 0 && retval >= len))
 		return -1;
 
-	if (port)
-		port->print(buffer);
+	write(buffer, retval);
 
 	return retval;
 }
 
 void SerialTerminal::putch(uint8_t c)
 {
-	if (port)
-		port->write(c);
+	write((const char *)&c, 1);
 }
 
 void SerialTerminal::puts(const char *str)
 {
-	if (port) {
-		while(*str)
-			port->write(*str++);
-	}
+	write(str, strlen(str));
 }
 
 int	SerialTerminal::get_char(int ch)
@@ -157,6 +208,7 @@ int	SerialTerminal::getch(void)
 	if (port && port->available()) {
 		c = port->read();
 		if (flags & F_DEBUG) {
+			flush();
 			if (c < ' ') {
 				port->write('\'');
 				port->print(c);
@@ -168,37 +220,101 @@ int	SerialTerminal::getch(void)
 		}
 	}
 
-	return get_char(c);
+	c = get_char(c);
+	// whatever was printed before waiting for input and echo should be seen
+	flush();
+	return c;
 }
 
-int SerialTerminal::dump(const char *prefix, void *pdump, uint32_t ulen)
+/* dump line layout: 16 hex pairs, separators and 16 characters */
+#define DUMP_BYTES  16
+#define DUMP_LINE   68
+#define DUMP_ASCII  52
+#define DUMP_CHUNK  2048
+
+/* hex pair and printable character for every byte value */
+static char hex2[256][2];
+static char ascii[256];
+
+static void dump_init(void)
 {
-	char line[70];
-	uint32_t i, n;
 	static const char *hex = "0123456789ABCDEF";
+
+	for(int i = 0; i < 256; i++) {
+		hex2[i][0] = hex[i >> 4];
+		hex2[i][1] = hex[i & 0x0F];
+		ascii[i] = isprint(i) ? i : '.';
+	}
+}
+
+/* format up to 16 bytes as one line, returns line length */
+static unsigned dump_line(char *line, const uint8_t *pmem, uint32_t n)
+{
+	memset(line, ' ', DUMP_LINE);
+	line[24] = '|';	line[50] = '|';
+
+	char *phex = line;
+	for(uint32_t i = 0; i < n; i++) {
+		phex[0] = hex2[pmem[i]][0];
+		phex[1] = hex2[pmem[i]][1];
+		phex += (i == 7) ? 5 : 3;
+		line[DUMP_ASCII + i] = ascii[pmem[i]];
+	}
+	line[DUMP_LINE] = '\n';
+	return DUMP_LINE + 1;
+}
+
+void SerialTerminal::dumpRate(uint32_t rate)
+{
+	drate = rate;
+	dtokens = rate;
+	dtime = millis();
+}
+
+int SerialTerminal::dump(const char *prefix, void *pdump, uint32_t ulen)
+{
+	char out[DUMP_CHUNK];
+	unsigned dlen = 0;
+	unsigned plen = strlen(prefix);
+	if (plen > DUMP_LINE)
+		plen = DUMP_LINE;
 	const uint8_t *pmem = (const uint8_t *)pdump;
+	uint32_t skip = 0;
 
-	// initialize output line
-	memset(line, ' ', sizeof(line));
-	line[24] = '|';	line[50] = '|';	line[68] = '\0';
-
-	for(i = n = 0; n < ulen; n++) {
-		line[i++] = hex[(pmem[n] >> 4) & 0x0F];
-		line[i++] = hex[pmem[n] & 0x0F];
-		line[(n & 0x0F) + 52] = isprint(pmem[n]) ? pmem[n] : '.';
-		i++;
-		if (i == 24)
-			i += 2;
-		if (i == 50) {
-			i = 0;
-			puts(prefix); puts(line); puts("\n");
-			// re-initialize output line
-			memset(line, ' ', sizeof(line));
-			line[24] = '|';	line[50] = '|';	line[68] = '\0';
+	if (ascii[0] == 0)
+		dump_init();
+
+	if (drate) {
+		// refill token bucket, burst is one second worth of data
+		uint32_t now = millis();
+		uint64_t refill = (uint64_t)(now - dtime) * drate / 1000;
+		if (refill) {
+			dtokens = (dtokens + refill > drate) ? drate : dtokens + refill;
+			dtime = now;
+		}
+		if (ulen > dtokens) {
+			skip = ulen - dtokens;
+			ulen = dtokens;
 		}
+		dtokens -= ulen;
 	}
-	if (i != 0) {
-		puts(prefix); puts(line); puts("\n");
+
+	// every line is formatted in place and the whole chunk goes out in one write
+	for(uint32_t n = 0; n < ulen; n += DUMP_BYTES) {
+		if ((dlen + plen + DUMP_LINE + 1) > sizeof(out)) {
+			write(out, dlen);
+			dlen = 0;
+		}
+		memcpy(out + dlen, prefix, plen);
+		dlen += plen;
+		dlen += dump_line(out + dlen, pmem + n, (ulen - n) < DUMP_BYTES ? (ulen - n) : DUMP_BYTES);
+	}
+	if (dlen)
+		write(out, dlen);
+
+	if (skip) {
+		dskipped += skip;
+		print("%s... %u bytes not shown\n", prefix, skip);
 	}
 	return 0;
 }
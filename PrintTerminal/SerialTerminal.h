@@ -34,10 +34,14 @@
 
 #include "PrintTerminal.h"
 
+/* default size of output buffer and max age of buffered output, msec */
+#define TERM_OUT_LEN   512
+#define TERM_OUT_DELAY 50
+
 /* serial terminal */
 class SerialTerminal:public PrintTerminal {
 private:
-	enum { F_DEBUG = 0x8000, F_ECHO = 0x0001 };
+	enum { F_DEBUG = 0x8000, F_ECHO = 0x0001, F_LINE = 0x0002 };
 	uint32_t flags;
 	char    *buffer;
 	unsigned len;
@@ -46,6 +50,19 @@ private:
 	uint8_t esc;
 	uint8_t idx;
 
+	/* output is collected here and sent to the port in one write */
+	char    *obuf;
+	unsigned osize;
+	unsigned olen;
+	uint32_t otime;  /* when the oldest buffered byte was written */
+	uint32_t odelay;
+
+	/* dump rate limit */
+	uint32_t drate;   /* bytes per second, 0 - no limit */
+	uint32_t dtokens; /* bytes allowed to be dumped now */
+	uint32_t dtime;
+	uint32_t dskipped;
+
 	int get_char(int ch);
 
 public:
@@ -79,8 +96,23 @@ public:
 	virtual void puts(const char *str);
 	/* print a string to attached serial port, up to maxlen in size*/
 	virtual int	print(const char *format, ...);
+	/* send len bytes to attached serial port, through output buffer */
+	virtual void write(const char *data, unsigned len);
 	/* dump memory to attached terminal port */
 	int dump(const char *prefix, void *pmem, uint32_t ulen);
+	/* limit dump to 'rate' bytes of memory per second, 0 - no limit;
+	   data over the limit is skipped and reported with one line */
+	void dumpRate(uint32_t rate);
+	/* total bytes skipped by dump rate limit */
+	uint32_t dumpSkipped(void) { return dskipped; }
+
+	/* output buffering: buffer size (0 - no buffering), max age of
+	   buffered output in msec (0 - no limit) and flush on new line.
+	   Buffer is flushed also when full, by flush() and by getch()
+	*/
+	int buffering(unsigned size, uint32_t delay = TERM_OUT_DELAY, bool line = true);
+	/* send buffered output to the port */
+	virtual void flush(void);
 
 	/* return last printed string */
 	const char *string(void) { return buffer; }
@@ -26,10 +26,96 @@
 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
 */
+#include <stdio.h>
 #include <string.h>
 
 #include "SimpleCli.h"
 
+// FNV-1a hash of the command path
+#define FNV_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+#define HASH_MASK (CLI_HASH_SIZE - 1)
+
+#define is_sep(c) ((c) == ' ' || (c) == '\t')
+
+/*
+	check if the first k words of the command path are the same as in
+	the line, returns pointer to the word k of the path or NULL
+*/
+static const char *path_words(const char *path, const char *line, unsigned k)
+{
+	unsigned i;
+
+	for(i = 0; i < k; i++) {
+		while(is_sep(*line))
+			line++;
+		while(*line > ' ' && *line == *path)
+			line++, path++;
+		if (*line > ' ' || (*path != ' ' && *path != '\0'))
+			return NULL;
+		if (*path == '\0')
+			return (i == (k - 1)) ? path : NULL;
+		path++;
+	}
+	return path;
+}
+
+// length of a word or schema element
+static unsigned word_len(const char *str)
+{
+	const char *end = str;
+	while(*end && *end != ' ')
+		end++;
+	return end - str;
+}
+
+// schema element takes the rest of the line
+static int elem_rest(const char *el, unsigned len)
+{
+	unsigned i;
+	for(i = 0; (i + 2) < len; i++) {
+		if (el[i] == '.' && el[i + 1] == '.' && el[i + 2] == '.')
+			return 1;
+	}
+	return 0;
+}
+
+/*
+	check argument against schema element, if kw is not NULL just collect
+	keywords starting with tok to kw array
+*/
+static int elem_match(const char *el, unsigned len, const char *tok, unsigned tlen,
+	const char **kw, unsigned *kwlen, unsigned *nkw)
+{
+	const char *end = el + len;
+
+	if (*el == '[')
+		el++;
+	if (end > el && end[-1] == ']')
+		end--;
+
+	while(el < end) {
+		const char *alt = el;
+		while(el < end && *el != '|')
+			el++;
+		if (*alt == '<') {
+			if (!kw)
+				return 1;
+		}
+		else if (kw) {
+			if ((unsigned)(el - alt) >= tlen && memcmp(alt, tok, tlen) == 0) {
+				kw[*nkw] = alt;
+				kwlen[*nkw] = el - alt;
+				(*nkw)++;
+			}
+		}
+		else if ((unsigned)(el - alt) == tlen && memcmp(alt, tok, tlen) == 0)
+			return 1;
+		el++;
+	}
+	return 0;
+}
+
 SimpleCli::SimpleCli(PrintTerminal *term, cmd_handler *processor)
 {
 	memset(cmd, 0, sizeof(cmd));
@@ -38,6 +124,12 @@ SimpleCli::SimpleCli(PrintTerminal *term, cmd_handler *processor)
 
 	this->term = term;
 	this->processor = processor;
+
+	table = NULL;
+	ncmds = 0;
+	cancel = NULL;
+	cancel_data = NULL;
+	memset(vname, 0, sizeof(vname));
 }
 
 void SimpleCli::attach(PrintTerminal *term)
@@ -58,8 +150,26 @@ int SimpleCli::interact(int ch)
 		return 0;
 	}
 
+	if (ch == KEY_CTRL_C) {
+		if (term)
+			term->puts("^C\n");
+		if (cancel)
+			cancel(cancel_data);
+		else {
+			memset(cmd, 0, sizeof(cmd));
+			cursor = 0;
+		}
+		return 0;
+	}
+
+	if (ch == '\t') {
+		if (table)
+			complete();
+		return 0;
+	}
+
 	if (ch == '\n' && *cmd) {
-		if (processor && (processor(cmd, term) == 0))
+		if (execute(cmd) == 0)
 			memcpy(hist, cmd, sizeof(cmd));
 		for(uint8_t i = 0; i < cursor; i++)
 			cmd[i] = '\0';
@@ -92,6 +202,528 @@ int SimpleCli::interact(int ch)
 	return 0;
 }
 
+int SimpleCli::commands(const cli_cmd_t *table, unsigned ncmds)
+{
+	unsigned i, n;
+	const char *path;
+	uint32_t h;
+
+	this->table = NULL;
+	this->ncmds = 0;
+	if (ncmds > CLI_MAX_CMDS)
+		return -1;
+
+	memset(slot, 0, sizeof(slot));
+	for(n = 0; n < ncmds; n++) {
+		h = FNV_BASIS;
+		depth[n] = 1;
+		for(path = table[n].path; *path; path++) {
+			h = (h ^ (uint8_t)*path) * FNV_PRIME;
+			if (*path == ' ')
+				depth[n]++;
+		}
+		if (depth[n] > CLI_MAX_DEPTH)
+			return -1;
+		hval[n] = h;
+		for(i = h & HASH_MASK; slot[i]; i = (i + 1) & HASH_MASK);
+		slot[i] = n + 1;
+	}
+
+	this->table = table;
+	this->ncmds = ncmds;
+	return 0;
+}
+
+/* finds the longest command path at the beginning of the line */
+int SimpleCli::find(const char *line, const char **rest)
+{
+	const char *str = line;
+	uint32_t h = FNV_BASIS;
+	unsigned d, i, n;
+	int found = -1;
+
+	for(d = 1; d <= CLI_MAX_DEPTH; d++) {
+		while(is_sep(*str))
+			str++;
+		if (*str == '\0')
+			break;
+		if (d > 1)
+			h = (h ^ ' ') * FNV_PRIME;
+		for(; *str > ' '; str++)
+			h = (h ^ (uint8_t)*str) * FNV_PRIME;
+
+		for(i = h & HASH_MASK; slot[i]; i = (i + 1) & HASH_MASK) {
+			n = slot[i] - 1;
+			if (hval[n] == h && depth[n] == d) {
+				const char *end = path_words(table[n].path, line, d);
+				if (end && *end == '\0') {
+					found = n;
+					*rest = str;
+					break;
+				}
+			}
+		}
+	}
+	return found;
+}
+
+/* splits arguments according to the schema and calls command handler */
+int SimpleCli::run(const cli_cmd_t *pcmd, char *str)
+{
+	cli_args_t args;
+	const char *el = pcmd->args;
+	unsigned len;
+
+	args.argc = 0;
+	while(el && *el) {
+		while(*el == ' ')
+			el++;
+		if (*el == '\0')
+			break;
+		len = word_len(el);
+
+		while(is_sep(*str))
+			str++;
+		if (*str == '\0') {
+			if (*el == '[')
+				break;
+			goto usage;
+		}
+		if (args.argc == CLI_MAX_ARGS)
+			goto usage;
+
+		args.argv[args.argc++] = str;
+		if (elem_rest(el, len)) {
+			char *end = str + strlen(str);
+			while(end > str && is_sep(end[-1]))
+				*--end = '\0';
+			str = end;
+		}
+		else {
+			while(*str > ' ')
+				str++;
+			if (*str)
+				*str++ = '\0';
+			if (!elem_match(el, len, args.argv[args.argc - 1],
+				strlen(args.argv[args.argc - 1]), NULL, NULL, NULL))
+				goto usage;
+		}
+		el += len;
+	}
+
+	while(is_sep(*str))
+		str++;
+	if (*str == '\0')
+		return pcmd->handler(&args, term);
+
+usage:
+	if (term)
+		term->print("usage: %s%s%s\n", pcmd->path, pcmd->args ? " " : "",
+			pcmd->args ? pcmd->args : "");
+	return -1;
+}
+
+int SimpleCli::execute(const char *line)
+{
+	char buf[CMD_LEN + 1];
+	const char *rest;
+	int idx;
+
+	if (expand(line, buf, sizeof(buf)) != 0) {
+		if (term)
+			term->print("command is too long\n");
+		return -1;
+	}
+
+	if (table) {
+		idx = find(buf, &rest);
+		if (idx >= 0)
+			return run(&table[idx], buf + (rest - buf));
+		idx = builtin(buf);
+		if (idx != 1)
+			return idx;
+	}
+
+	if (processor)
+		return processor(buf, term);
+
+	if (term) {
+		// incomplete command path, show what can follow
+		for(idx = 0; idx < (int)ncmds; idx++) {
+			if (strncmp(table[idx].path, buf, strlen(buf)) == 0) {
+				help(buf);
+				return -1;
+			}
+		}
+		term->print("Unknown command '%s'\n", buf);
+	}
+	return -1;
+}
+
+static const cli_cmd_t builtins[] = {
+	{ "help", "[<command>]", NULL, "list of commands" },
+	{ "set",  "[<name> [<value...>]]", NULL, "set, clear or list variables" },
+	{ "run",  "<file>", NULL, "run script" },
+	{ "echo", "[<text...>]", NULL, "print text" },
+};
+#define NBUILTINS (sizeof(builtins)/sizeof(builtins[0]))
+
+/* returns 1 if the line is not a built-in command */
+int SimpleCli::builtin(char *line)
+{
+	char *arg;
+	int i;
+
+	if (cmd_arg(line, "help", &arg)) {
+		help(arg);
+		return 0;
+	}
+	if (cmd_arg(line, "echo", &arg)) {
+		if (term)
+			term->print("%s\n", arg);
+		return 0;
+	}
+	if (cmd_arg(line, "run", &arg)) {
+		if (*arg == '\0')
+			return -1;
+		return script(arg);
+	}
+	if (cmd_arg(line, "set", &arg)) {
+		char *value = arg;
+		if (*arg == '\0') {
+			for(i = 0; i < CLI_MAX_VARS && term; i++) {
+				if (vname[i][0])
+					term->print("%s=%s\n", vname[i], vval[i]);
+			}
+			return 0;
+		}
+		while(*value > ' ')
+			value++;
+		if (*value) {
+			*value++ = '\0';
+			while(is_sep(*value))
+				value++;
+		}
+		if (setVar(arg, *value ? value : NULL) != 0) {
+			if (term)
+				term->print("unable to set '%s'\n", arg);
+			return -1;
+		}
+		return 0;
+	}
+	return 1;
+}
+
+static int is_name(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+		(c >= '0' && c <= '9') || c == '_';
+}
+
+int SimpleCli::setVar(const char *name, const char *value)
+{
+	int i, idx = -1;
+	const char *ptr;
+
+	for(ptr = name; *ptr; ptr++) {
+		if (!is_name(*ptr))
+			return -1;
+	}
+	if (ptr == name || (ptr - name) >= CLI_VAR_NAME)
+		return -1;
+	if (value && strlen(value) >= CLI_VAR_LEN)
+		return -1;
+
+	for(i = 0; i < CLI_MAX_VARS; i++) {
+		if (strcmp(vname[i], name) == 0) {
+			idx = i;
+			break;
+		}
+		if (idx < 0 && vname[i][0] == '\0')
+			idx = i;
+	}
+	if (idx < 0)
+		return value ? -1 : 0;
+
+	if (value == NULL) {
+		if (strcmp(vname[idx], name) == 0)
+			vname[idx][0] = '\0';
+		return 0;
+	}
+	strcpy(vname[idx], name);
+	strcpy(vval[idx], value);
+	return 0;
+}
+
+const char *SimpleCli::getVar(const char *name)
+{
+	int i;
+
+	for(i = 0; i < CLI_MAX_VARS; i++) {
+		if (vname[i][0] && strcmp(vname[i], name) == 0)
+			return vval[i];
+	}
+	return NULL;
+}
+
+/*
+	replaces $name and ${name} by the value, unknown names are left
+	as they are, so "$PMTK..." stays "$PMTK..."
+*/
+int SimpleCli::expand(const char *src, char *dst, unsigned size)
+{
+	char name[CLI_VAR_NAME];
+	const char *value, *end;
+	unsigned len, n = 0;
+	int brace;
+
+	while(*src) {
+		value = NULL;
+		if (*src == '$') {
+			brace = (src[1] == '{');
+			end = src + 1 + brace;
+			for(len = 0; is_name(*end) && len < (CLI_VAR_NAME - 1); end++)
+				name[len++] = *end;
+			name[len] = '\0';
+			if (brace && *end != '}')
+				len = 0;
+			if (len && (value = getVar(name)) != NULL) {
+				len = strlen(value);
+				if ((n + len) >= size)
+					return -1;
+				memcpy(dst + n, value, len);
+				n += len;
+				src = end + brace;
+				continue;
+			}
+		}
+		if ((n + 1) >= size)
+			return -1;
+		dst[n++] = *src++;
+	}
+	dst[n] = '\0';
+	return 0;
+}
+
+int SimpleCli::script(const char *path)
+{
+	return run_script(path, 0);
+}
+
+int SimpleCli::run_script(const char *path, int depth)
+{
+	// state of nested if: running, skipping this branch, skipping all
+	enum { IF_RUN, IF_SKIP, IF_SKIP_ALL };
+	uint8_t state[CLI_MAX_NEST];
+	char line[CMD_LEN + 2];
+	char *str, *arg;
+	int nest = 0, last = 0, ret = 0;
+	unsigned lineno = 0;
+	bool running;
+	FILE *fp;
+
+	if (depth >= CLI_MAX_INCLUDE) {
+		if (term)
+			term->print("%s: too many nested includes\n", path);
+		return -1;
+	}
+	if ((fp = fopen(path, "r")) == NULL) {
+		if (term)
+			term->print("unable to open '%s'\n", path);
+		return -1;
+	}
+
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		lineno++;
+		str = line + strlen(line);
+		if (str > line && str[-1] != '\n' && !feof(fp)) {
+			if (term)
+				term->print("%s:%u: line is too long\n", path, lineno);
+			ret = -1;
+			break;
+		}
+		while(str > line && (uint8_t)str[-1] <= ' ')
+			*--str = '\0';
+		for(str = line; is_sep(*str); str++);
+		if (*str == '\0' || *str == '#')
+			continue;
+
+		running = (nest == 0) || (state[nest - 1] == IF_RUN);
+
+		if (cmd_arg(str, "if", &arg)) {
+			if (nest == CLI_MAX_NEST || (!cmd_is(arg, "ok") && !cmd_is(arg, "fail"))) {
+				if (term)
+					term->print("%s:%u: invalid 'if'\n", path, lineno);
+				ret = -1;
+				break;
+			}
+			if (!running)
+				state[nest++] = IF_SKIP_ALL;
+			else
+				state[nest++] = ((last == 0) == cmd_is(arg, "ok")) ? IF_RUN : IF_SKIP;
+			continue;
+		}
+		if (cmd_is(str, "else") || cmd_is(str, "endif")) {
+			if (nest == 0) {
+				if (term)
+					term->print("%s:%u: '%s' without 'if'\n", path, lineno, str);
+				ret = -1;
+				break;
+			}
+			if (cmd_is(str, "endif"))
+				nest--;
+			else if (state[nest - 1] != IF_SKIP_ALL)
+				state[nest - 1] = (state[nest - 1] == IF_RUN) ? IF_SKIP : IF_RUN;
+			continue;
+		}
+		if (!running)
+			continue;
+
+		if (cmd_arg(str, "include", &arg))
+			last = run_script(arg, depth + 1);
+		else
+			last = execute(str);
+	}
+
+	if (ret == 0 && nest) {
+		if (term)
+			term->print("%s: 'endif' missing\n", path);
+		ret = -1;
+	}
+	fclose(fp);
+	return ret;
+}
+
+void SimpleCli::help(const char *prefix)
+{
+	unsigned i, len, width = 0;
+	unsigned plen = strlen(prefix);
+	const char *args;
+
+	if (!term)
+		return;
+	while(plen && is_sep(prefix[plen - 1]))
+		plen--;
+
+	for(i = 0; i < ncmds; i++) {
+		if (strncmp(table[i].path, prefix, plen))
+			continue;
+		len = strlen(table[i].path);
+		if (table[i].args)
+			len += strlen(table[i].args) + 1;
+		if (len > width)
+			width = len;
+	}
+	if (width == 0) {
+		term->print("Unknown command '%s'\n", prefix);
+		return;
+	}
+
+	if (plen == 0)
+		term->print("List of supported commands:\n");
+	for(i = 0; i < ncmds; i++) {
+		if (strncmp(table[i].path, prefix, plen))
+			continue;
+		args = table[i].args ? table[i].args : "";
+		len = strlen(table[i].path) + (*args ? strlen(args) + 1 : 0);
+		term->print("   %s%s%s%*s  %s\n", table[i].path, *args ? " " : "", args,
+			width - len, "", table[i].help ? table[i].help : "");
+	}
+	if (plen == 0) {
+		term->print("Built-in commands:\n");
+		for(i = 0; i < NBUILTINS; i++)
+			term->print("   %s %s\n", builtins[i].path, builtins[i].args);
+	}
+}
+
+/* TAB completion of command path and keyword arguments */
+void SimpleCli::complete(void)
+{
+	const char *cand[CLI_MAX_CMDS + 4];
+	unsigned clen[CLI_MAX_CMDS + 4];
+	unsigned i, j, n = 0, k = 0, common;
+	const char *word, *rest, *str;
+	unsigned wlen;
+	int idx;
+
+	if (!term)
+		return;
+	word = strrchr(cmd, ' ');
+	word = word ? word + 1 : cmd;
+	wlen = strlen(word);
+
+	idx = find(cmd, &rest);
+	if (idx >= 0 && word >= rest) {
+		// argument: count words between command path and the word
+		const char *el = table[idx].args;
+		for(str = rest; str < word; str++) {
+			if (*str > ' ' && (str == rest || str[-1] == ' '))
+				k++;
+		}
+		for(i = 0; el && *el && i <= k; i++) {
+			while(*el == ' ')
+				el++;
+			if (i == k)
+				elem_match(el, word_len(el), word, wlen, cand, clen, &n);
+			el += word_len(el);
+		}
+	}
+	else {
+		for(str = cmd; str < word; str++) {
+			if (*str > ' ' && (str == cmd || str[-1] == ' '))
+				k++;
+		}
+		for(i = 0; k == 0 && i < NBUILTINS; i++) {
+			if (strncmp(builtins[i].path, word, wlen) == 0) {
+				cand[n] = builtins[i].path;
+				clen[n++] = strlen(builtins[i].path);
+			}
+		}
+		for(i = 0; i < ncmds; i++) {
+			str = path_words(table[i].path, cmd, k);
+			if (!str || *str == '\0' || strncmp(str, word, wlen))
+				continue;
+			for(j = 0; j < n; j++) {
+				if (clen[j] == word_len(str) && memcmp(cand[j], str, clen[j]) == 0)
+					break;
+			}
+			if (j == n) {
+				cand[n] = str;
+				clen[n++] = word_len(str);
+			}
+		}
+	}
+
+	if (n == 0)
+		return;
+
+	common = clen[0];
+	for(i = 1; i < n; i++) {
+		for(j = wlen; j < common && j < clen[i] && cand[i][j] == cand[0][j]; j++);
+		common = j;
+	}
+
+	if (n > 1 && common == wlen) {
+		term->putch('\n');
+		for(i = 0; i < n; i++) {
+			term->write(cand[i], clen[i]);
+			term->puts("  ");
+		}
+		term->putch('\n');
+	}
+	else {
+		if ((cursor + common - wlen + 1) >= CMD_LEN)
+			return;
+		for(i = wlen; i < common; i++)
+			cmd[cursor++] = cand[0][i];
+		if (n == 1)
+			cmd[cursor++] = ' ';
+		cmd[cursor] = '\0';
+	}
+	term->putch('\r');
+	term->puts(cmd);
+}
+
 int cmd_is(const char *cmd, const char *str)
 {
 	return strcmp(cmd, str) == 0;
@@ -33,14 +33,77 @@
 	Simple command line handler, uses PrintTerminal class to print feedback.
 	Last successful command is stored in the history buffer and can be
 	recalled by ARROW_UP key press.
+
+	Commands can be processed by a single cmd_handler or registered as
+	a table of cli_cmd_t. Table commands are found by hash of the command
+	path, arguments are checked against the schema and split only once,
+	'help' and TAB completion are generated from the same table.
+
+	Built-in commands:
+	  help [<command>]  list of commands
+	  set [<name> [<value...>]]  set, clear or list variables, $name
+	                    or ${name} is replaced by the value in commands
+	  run <file>        run script file
+	  echo <text...>    print text
+
+	Scripts are command lines, plus '#' comment lines and
+	  include <file>    run another script
+	  if ok|fail        check result of the last command
+	  else
+	  endif
 */
 #include "SerialTerminal.h"
 
 // command line max length, longer commands will reset the cursor
 #define CMD_LEN 0x07F
 
+// command table limits
+#define CLI_MAX_ARGS  8   // arguments after the command path
+#define CLI_MAX_CMDS  64  // commands in the table
+#define CLI_MAX_DEPTH 4   // words in the command path
+#define CLI_HASH_SIZE 128 // hash slots, power of 2
+
+// script limits
+#define CLI_MAX_VARS  16  // variables
+#define CLI_VAR_NAME  16  // variable name length, including '\0'
+#define CLI_VAR_LEN   64  // variable value length, including '\0'
+#define CLI_MAX_NEST  8   // nested if
+#define CLI_MAX_INCLUDE 4 // nested include
+
+// Ctrl-C, cancels a running command or clears the command line
+#define KEY_CTRL_C 0x03
+
 // command processor, returns 0 on success
 typedef int cmd_handler(char *buf, PrintTerminal *term);
+// called on Ctrl-C while a command is running in background
+typedef void cli_cancel_handler(void *data);
+
+// arguments following the command path, split according to the schema
+typedef struct cli_args_s {
+	int   argc;
+	char *argv[CLI_MAX_ARGS];
+} cli_args_t;
+
+// table command processor, returns 0 on success
+typedef int cli_cmd_handler(cli_args_t *args, PrintTerminal *term);
+
+/*
+	command table entry
+	path: command words separated by one space, "gps baud"
+	args: space separated argument schema, NULL if no arguments:
+	      on|off   - one of keywords
+	      <name>   - any word
+	      <name...> - rest of the line as one argument
+	      [...]    - optional argument, all following are optional too
+	      for example "[on|off]", "<file> [<count>]", "[<cmd...>]"
+	help: one line description
+*/
+typedef struct cli_cmd_s {
+	const char *path;
+	const char *args;
+	cli_cmd_handler *handler;
+	const char *help;
+} cli_cmd_t;
 
 class SimpleCli {
 public:
@@ -52,6 +115,28 @@ public:
 	// process new character from the terminal
 	int interact(int ch);
 
+	// register command table, commands not found in the table
+	// go to command processor if any, returns 0 on success
+	int commands(const cli_cmd_t *table, unsigned ncmds);
+	// execute one command line, returns command processor result
+	int execute(const char *line);
+	// print list of commands starting with prefix ("" for all)
+	void help(const char *prefix);
+
+	// run script file, returns -1 if it can't be read or has errors,
+	// results of commands are checked by 'if' in the script itself
+	int script(const char *path);
+	// set variable, NULL value deletes it, returns 0 on success
+	int setVar(const char *name, const char *value);
+	// variable value or NULL
+	const char *getVar(const char *name);
+	// set by commands still running after returning from the handler,
+	// NULL when done
+	void setCancel(cli_cancel_handler *handler, void *data = NULL) {
+		cancel = handler;
+		cancel_data = data;
+	}
+
 private:
 	uint32_t cursor;
 	char cmd[CMD_LEN + 1];
@@ -59,6 +144,24 @@ private:
 
 	PrintTerminal *term;
 	cmd_handler *processor;
+	cli_cancel_handler *cancel;
+	void *cancel_data;
+
+	const cli_cmd_t *table;
+	unsigned ncmds;
+	uint8_t  slot[CLI_HASH_SIZE]; // table index + 1, 0 - empty
+	uint8_t  depth[CLI_MAX_CMDS]; // words in the command path
+	uint32_t hval[CLI_MAX_CMDS];  // hash of the command path
+
+	char vname[CLI_MAX_VARS][CLI_VAR_NAME];
+	char vval[CLI_MAX_VARS][CLI_VAR_LEN];
+
+	int find(const char *line, const char **rest);
+	int builtin(char *line);
+	int expand(const char *src, char *dst, unsigned size);
+	int run_script(const char *path, int depth);
+	int run(const cli_cmd_t *pcmd, char *args);
+	void complete(void);
 };
 
 // helper functions for commands handler
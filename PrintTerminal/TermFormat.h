@@ -0,0 +1,439 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef __GALILEO_TERM_FORMAT_H__
+#define __GALILEO_TERM_FORMAT_H__
+
+/*
+	Type safe printf-like output for PrintTerminal:
+
+		TPRINT(term, "lat: %.8f nsat: %2d\n", gps.latitude, gps.gga.nsat);
+
+	term can be a PrintTerminal object or a pointer to one.
+
+	With C++11 the format string is checked against the argument types at
+	compile time (static_assert) and the output is formatted without
+	vsnprintf, piece by piece straight into PrintTerminal::write(), so
+	there is no limit on the length of the output.
+
+	Supported conversions: %d %i %u %x %X %c %s %f and %%,
+	flags '-', '0', '+', ' ', width and .precision; length modifiers
+	(h, l, ll, z...) are accepted and ignored as types are known anyway.
+	%f precision is limited to 9 digits.
+	The format must be a string literal.
+
+	Without C++11 TPRINT falls back to PrintTerminal::print().
+*/
+
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+#include <PrintTerminal.h>
+
+namespace termfmt {
+
+inline PrintTerminal *term_ptr(PrintTerminal &term) { return &term; }
+inline PrintTerminal *term_ptr(PrintTerminal *term) { return term; }
+
+}
+
+#if __cplusplus >= 201103L
+
+#include <type_traits>
+
+namespace termfmt {
+
+/* argument kinds: i - signed, u - unsigned, c - char, f - floating, s - string */
+template<typename T> struct kind {
+	typedef typename std::decay<T>::type type;
+	static constexpr char value =
+		std::is_same<type, char>::value ? 'c' :
+		std::is_same<type, bool>::value ? 'u' :
+		std::is_integral<type>::value ? (std::is_signed<type>::value ? 'i' : 'u') :
+		std::is_enum<type>::value ? 'i' :
+		std::is_floating_point<type>::value ? 'f' :
+		(std::is_same<type, char *>::value || std::is_same<type, const char *>::value) ? 's' :
+		'?';
+};
+
+template<typename... A> struct types {};
+/* never called, used in decltype() only */
+template<typename... A> types<A...> types_of(const A &...);
+
+/* compile time format parser */
+constexpr bool is_flag(char c)
+{
+	return c == '-' || c == '0' || c == '+' || c == ' ' || c == '#';
+}
+
+constexpr bool is_skip(char c)
+{
+	return is_flag(c) || (c >= '0' && c <= '9') || c == '.' ||
+		c == 'h' || c == 'l' || c == 'L' || c == 'z' || c == 'j' || c == 't';
+}
+
+/* f points to the character after '%', returns pointer to the conversion */
+constexpr const char *spec_conv(const char *f)
+{
+	return is_skip(*f) ? spec_conv(f + 1) : f;
+}
+
+constexpr bool conv_ok(char conv, char k)
+{
+	return (conv == 'd' || conv == 'i' || conv == 'u' || conv == 'x' || conv == 'X' || conv == 'c') ?
+		(k == 'i' || k == 'u' || k == 'c') :
+		conv == 'f' ? (k == 'f') :
+		conv == 's' ? (k == 's') :
+		false;
+}
+
+/* no arguments left: only %% allowed */
+constexpr bool check_fmt(const char *f)
+{
+	return *f == '\0' ? true :
+		*f != '%' ? check_fmt(f + 1) :
+		f[1] == '%' ? check_fmt(f + 2) :
+		false;
+}
+
+template<typename... R>
+constexpr bool check_fmt(const char *f, char k, R... rest)
+{
+	return *f == '\0' ? false :
+		*f != '%' ? check_fmt(f + 1, k, rest...) :
+		f[1] == '%' ? check_fmt(f + 2, k, rest...) :
+		*spec_conv(f + 1) != '\0' && conv_ok(*spec_conv(f + 1), k) &&
+		check_fmt(spec_conv(f + 1) + 1, rest...);
+}
+
+template<typename... A>
+constexpr bool check(const char *fmt, types<A...>)
+{
+	return check_fmt(fmt, kind<A>::value...);
+}
+
+/* run time part */
+enum { F_LEFT = 0x01, F_ZERO = 0x02, F_PLUS = 0x04, F_SPACE = 0x08 };
+
+struct spec_t {
+	uint8_t  flags;
+	char     conv;
+	unsigned width;
+	int      prec; /* -1 if not set */
+};
+
+/* writes literal text up to the next conversion, returns pointer to it */
+inline const char *literal(PrintTerminal *term, const char *f)
+{
+	const char *s = f;
+	while(*f) {
+		if (*f == '%') {
+			if (f[1] != '%')
+				break;
+			term->write(s, f - s + 1);
+			f += 2;
+			s = f;
+			continue;
+		}
+		f++;
+	}
+	if (f != s)
+		term->write(s, f - s);
+	return f;
+}
+
+/* f points to the character after '%' */
+inline const char *parse(const char *f, spec_t *sp)
+{
+	sp->flags = 0;
+	sp->width = 0;
+	sp->prec = -1;
+
+	for(;; f++) {
+		if (*f == '-') sp->flags |= F_LEFT;
+		else if (*f == '0') sp->flags |= F_ZERO;
+		else if (*f == '+') sp->flags |= F_PLUS;
+		else if (*f == ' ') sp->flags |= F_SPACE;
+		else if (*f != '#') break;
+	}
+	while(*f >= '0' && *f <= '9')
+		sp->width = sp->width*10 + (*f++ - '0');
+	if (*f == '.') {
+		sp->prec = 0;
+		for(f++; *f >= '0' && *f <= '9'; f++)
+			sp->prec = sp->prec*10 + (*f - '0');
+	}
+	while(*f == 'h' || *f == 'l' || *f == 'L' || *f == 'z' || *f == 'j' || *f == 't')
+		f++;
+	sp->conv = *f;
+	return *f ? f + 1 : f;
+}
+
+inline void pad(PrintTerminal *term, char c, unsigned n)
+{
+	char fill[16];
+	memset(fill, c, sizeof(fill));
+	while(n) {
+		unsigned len = (n > sizeof(fill)) ? sizeof(fill) : n;
+		term->write(fill, len);
+		n -= len;
+	}
+}
+
+/* writes [sign][digits] padded to the field width */
+inline void field(PrintTerminal *term, const spec_t &sp, char sign, const char *str, unsigned len)
+{
+	unsigned total = len + (sign ? 1 : 0);
+	unsigned fill = (sp.width > total) ? sp.width - total : 0;
+
+	if (fill && !(sp.flags & (F_LEFT | F_ZERO)))
+		pad(term, ' ', fill);
+	if (sign)
+		term->write(&sign, 1);
+	if (fill && (sp.flags & F_ZERO) && !(sp.flags & F_LEFT))
+		pad(term, '0', fill);
+	term->write(str, len);
+	if (fill && (sp.flags & F_LEFT))
+		pad(term, ' ', fill);
+}
+
+inline char sign_of(const spec_t &sp, bool neg)
+{
+	if (neg) return '-';
+	if (sp.flags & F_PLUS) return '+';
+	if (sp.flags & F_SPACE) return ' ';
+	return 0;
+}
+
+/* converts v to text at the end of buf, returns start */
+inline char *utoa(char *end, uint64_t v, unsigned base, bool upper)
+{
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char *p = end;
+	if (base == 10 && v <= 0xFFFFFFFFu) {
+		/* 32 bit division is much cheaper on Quark */
+		uint32_t v32 = (uint32_t)v;
+		do {
+			*--p = '0' + v32 % 10;
+			v32 /= 10;
+		} while(v32);
+		return p;
+	}
+	do {
+		*--p = digits[v % base];
+		v /= base;
+	} while(v);
+	return p;
+}
+
+inline void put_uint(PrintTerminal *term, const spec_t &sp, bool neg, uint64_t v)
+{
+	char buf[24];
+	char *end = buf + sizeof(buf);
+	char *p;
+	unsigned len;
+
+	if (sp.conv == 'x' || sp.conv == 'X') {
+		neg = false;
+		p = utoa(end, v, 16, sp.conv == 'X');
+	}
+	else
+		p = utoa(end, v, 10, false);
+
+	/* precision for integers is the minimal number of digits */
+	len = end - p;
+	if (sp.prec >= 0) {
+		if (sp.prec == 0 && v == 0)
+			len = 0, p = end;
+		while(len < (unsigned)sp.prec && p > buf)
+			*--p = '0', len++;
+	}
+	field(term, sp, (sp.conv == 'x' || sp.conv == 'X') ? 0 : sign_of(sp, neg), p, len);
+}
+
+inline void put_char(PrintTerminal *term, const spec_t &sp, char c)
+{
+	field(term, sp, 0, &c, 1);
+}
+
+/* unsigned type of the argument after integer promotion, as printf sees it */
+template<typename T> struct promoted_unsigned {
+	typedef typename std::conditional<(sizeof(T) < sizeof(int)),
+		unsigned int, typename std::make_unsigned<T>::type>::type type;
+};
+
+/* u is v as unsigned of its promoted width, for %u %x %X of negative values */
+inline void put_int(PrintTerminal *term, const spec_t &sp, int64_t v, uint64_t u)
+{
+	if (sp.conv == 'c')
+		put_char(term, sp, (char)v);
+	else if (sp.conv == 'u' || sp.conv == 'x' || sp.conv == 'X')
+		put_uint(term, sp, false, u);
+	else
+		put_uint(term, sp, v < 0, v < 0 ? 0 - (uint64_t)v : (uint64_t)v);
+}
+
+inline void put_str(PrintTerminal *term, const spec_t &sp, const char *str)
+{
+	unsigned len;
+
+	if (str == NULL)
+		str = "(null)";
+	if (sp.prec >= 0) {
+		const char *end = (const char *)memchr(str, '\0', sp.prec);
+		len = end ? end - str : sp.prec;
+	}
+	else
+		len = strlen(str);
+	field(term, sp, 0, str, len);
+}
+
+/* fixed point %f: integer and fraction parts are converted as integers */
+inline void put_double(PrintTerminal *term, const spec_t &sp, double v)
+{
+	static const uint32_t pow10[10] = {
+		1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+	};
+	char buf[48];
+	char *end = buf + sizeof(buf);
+	char *p;
+	bool neg = false;
+	unsigned prec = (sp.prec < 0) ? 6 : (sp.prec > 9 ? 9 : sp.prec);
+	uint64_t ipart;
+	uint32_t fpart;
+	double frac;
+	spec_t fs = sp;
+
+	if (v != v) {
+		fs.flags &= ~F_ZERO;
+		field(term, fs, 0, "nan", 3);
+		return;
+	}
+	if (v < 0)
+		neg = true, v = -v;
+	if (v >= 1.8e19) {
+		fs.flags &= ~F_ZERO;
+		field(term, fs, sign_of(sp, neg), "inf", 3);
+		return;
+	}
+
+	ipart = (uint64_t)v;
+	frac = v - (double)ipart;
+	v = frac * pow10[prec];
+	fpart = (uint32_t)v;
+	v -= fpart;
+	if (v > 0.5)
+		fpart++;
+	else if (v == 0.5) {
+		/* product was rounded to a tie: check the exact one,
+		   real ties are rounded to even as printf does */
+		double err = fma(frac, pow10[prec], -(fpart + 0.5));
+		if (err > 0 || (err == 0 && ((prec ? fpart : ipart) & 1)))
+			fpart++;
+	}
+	if (fpart >= pow10[prec]) {
+		fpart -= pow10[prec];
+		ipart++;
+	}
+
+	p = end;
+	if (prec) {
+		unsigned i;
+		for(i = 0; i < prec; i++) {
+			*--p = '0' + fpart % 10;
+			fpart /= 10;
+		}
+		*--p = '.';
+	}
+	p = utoa(p, ipart, 10, false);
+	field(term, sp, sign_of(sp, neg), p, end - p);
+}
+
+/* argument dispatch by kind */
+template<char K> struct tag {};
+
+template<typename T>
+inline void put(PrintTerminal *term, const spec_t &sp, const T &v, tag<'i'>)
+{
+	put_int(term, sp, (int64_t)v, (uint64_t)(typename promoted_unsigned<T>::type)v);
+}
+template<typename T>
+inline void put(PrintTerminal *term, const spec_t &sp, const T &v, tag<'u'>)
+{
+	if (sp.conv == 'c')
+		put_char(term, sp, (char)v);
+	else
+		put_uint(term, sp, false, (uint64_t)v);
+}
+template<typename T>
+inline void put(PrintTerminal *term, const spec_t &sp, const T &v, tag<'c'>)
+{
+	if (sp.conv == 'c')
+		put_char(term, sp, v);
+	else
+		put_int(term, sp, v, (uint64_t)(typename promoted_unsigned<T>::type)v);
+}
+template<typename T>
+inline void put(PrintTerminal *term, const spec_t &sp, const T &v, tag<'f'>) { put_double(term, sp, v); }
+template<typename T>
+inline void put(PrintTerminal *term, const spec_t &sp, const T &v, tag<'s'>) { put_str(term, sp, v); }
+
+inline void format(PrintTerminal *term, const char *f)
+{
+	literal(term, f);
+}
+
+template<typename T, typename... R>
+inline void format(PrintTerminal *term, const char *f, const T &arg, const R &... rest)
+{
+	spec_t sp;
+
+	f = literal(term, f);
+	if (*f == '\0')
+		return;
+	f = parse(f + 1, &sp);
+	put(term, sp, arg, tag<kind<T>::value>());
+	format(term, f, rest...);
+}
+
+}
+
+#define TPRINT(term, fmt, ...) \
+	do { \
+		static_assert(termfmt::check(fmt, decltype(termfmt::types_of(__VA_ARGS__))()), \
+			"TPRINT: format does not match arguments"); \
+		termfmt::format(termfmt::term_ptr(term), fmt, ##__VA_ARGS__); \
+	} while(0)
+
+#else
+
+#define TPRINT(term, fmt, ...) termfmt::term_ptr(term)->print(fmt, ##__VA_ARGS__)
+
+#endif
+
+#endif
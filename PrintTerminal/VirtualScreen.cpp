@@ -0,0 +1,225 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#include <Arduino.h>
+#include <stdarg.h>
+
+#include "VirtualScreen.h"
+
+/* unchanged cells shorter than a cursor move are sent as they are */
+#define SPAN_GAP 6
+
+VirtualScreen::VirtualScreen(PrintTerminal *term, uint8_t rows, uint8_t cols)
+{
+	this->term = term;
+	this->rows = rows;
+	this->cols = cols;
+	row = col = 0;
+	trow = rows;
+	tcol = 0;
+	nsent = 0;
+	olen = 0;
+
+	back = (char *)malloc(rows * cols);
+	front = (char *)malloc(rows * cols);
+	if (back == NULL || front == NULL) {
+		free(back);
+		free(front);
+		back = front = NULL;
+		this->rows = this->cols = 0;
+		return;
+	}
+	memset(back, ' ', rows * cols);
+	/* nothing matches, so the first flush draws everything */
+	memset(front, 0, rows * cols);
+}
+
+VirtualScreen::~VirtualScreen(void)
+{
+	free(back);
+	free(front);
+}
+
+void VirtualScreen::begin(void)
+{
+	static const char init[] = "\x1B[?25l\x1B[H\x1B[J"; /* hide cursor, home, clear */
+
+	if (front)
+		memset(front, ' ', rows * cols);
+	emit(init, sizeof(init) - 1);
+	trow = tcol = 0;
+	flush();
+}
+
+void VirtualScreen::move(uint8_t row, uint8_t col)
+{
+	this->row = (row < rows) ? row : rows;
+	this->col = (col < cols) ? col : cols;
+}
+
+void VirtualScreen::clearEol(void)
+{
+	if (row < rows && col < cols)
+		memset(back + row * cols + col, ' ', cols - col);
+}
+
+void VirtualScreen::clearDown(void)
+{
+	clearEol();
+	if (row < rows - 1)
+		memset(back + (row + 1) * cols, ' ', (rows - row - 1) * cols);
+}
+
+void VirtualScreen::fill(uint8_t c, unsigned n)
+{
+	if (row >= rows)
+		return;
+	if (n > (unsigned)(cols - col))
+		n = cols - col;
+	memset(back + row * cols + col, c, n);
+	col += n;
+}
+
+void VirtualScreen::putch(uint8_t c)
+{
+	if (c == '\n') {
+		clearEol();
+		if (row < rows)
+			row++;
+		col = 0;
+		return;
+	}
+	/* characters past the right edge are dropped */
+	if (row < rows && col < cols)
+		back[row * cols + col++] = c;
+}
+
+void VirtualScreen::puts(const char *str)
+{
+	while(*str)
+		putch(*str++);
+}
+
+int VirtualScreen::print(const char *format, ...)
+{
+	char buf[256];
+	va_list ap;
+
+	va_start(ap, format);
+	int retval = vsnprintf(buf, sizeof(buf), format, ap);
+	va_end(ap);
+	if (retval < 0)
+		return -1;
+
+	puts(buf);
+	return retval;
+}
+
+void VirtualScreen::emit(const char *str, unsigned len)
+{
+	while(len) {
+		unsigned n = sizeof(out) - 1 - olen;
+		if (n > len)
+			n = len;
+		memcpy(out + olen, str, n);
+		olen += n;
+		str += n;
+		len -= n;
+		if (olen == sizeof(out) - 1) {
+			out[olen] = '\0';
+			term->puts(out);
+			nsent += olen;
+			olen = 0;
+		}
+	}
+}
+
+/* decimal number, up to 3 digits */
+static char *put_num(char *ptr, unsigned n)
+{
+	if (n >= 100) *ptr++ = '0' + n / 100;
+	if (n >= 10)  *ptr++ = '0' + (n / 10) % 10;
+	*ptr++ = '0' + n % 10;
+	return ptr;
+}
+
+void VirtualScreen::emit_move(uint8_t r, uint8_t c)
+{
+	char esc[12];
+	char *ptr = esc;
+
+	if (r == trow && c == tcol)
+		return;
+
+	/* ESC [ row ; col H, 1 based */
+	*ptr++ = '\x1B';
+	*ptr++ = '[';
+	ptr = put_num(ptr, r + 1);
+	*ptr++ = ';';
+	ptr = put_num(ptr, c + 1);
+	*ptr++ = 'H';
+	emit(esc, ptr - esc);
+}
+
+void VirtualScreen::flush(void)
+{
+	for(uint8_t r = 0; r < rows; r++) {
+		char *pb = back + r * cols;
+		char *pf = front + r * cols;
+
+		for(uint8_t c = 0; c < cols; c++) {
+			if (pb[c] == pf[c])
+				continue;
+
+			/* extend the span over short runs of unchanged cells */
+			uint8_t last = c;
+			for(uint8_t k = c + 1; k < cols && (k - last) <= SPAN_GAP; k++) {
+				if (pb[k] != pf[k])
+					last = k;
+			}
+
+			emit_move(r, c);
+			emit(pb + c, last - c + 1);
+			memcpy(pf + c, pb + c, last - c + 1);
+			trow = r;
+			tcol = last + 1;
+			/* cursor at the right margin is not where we think it is */
+			if (tcol == cols)
+				trow = rows;
+			c = last;
+		}
+	}
+
+	if (olen) {
+		out[olen] = '\0';
+		term->puts(out);
+		nsent += olen;
+		olen = 0;
+	}
+	term->flush();
+}
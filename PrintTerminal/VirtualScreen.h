@@ -0,0 +1,87 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifndef __GALILEO_VIRTUAL_SCREEN_H__
+#define __GALILEO_VIRTUAL_SCREEN_H__
+
+#include <stdint.h>
+
+#include "PrintTerminal.h"
+
+/* 
+	Screen buffer for VT100 dashboards: application draws into cells,
+	flush() compares them with what is already on the terminal and sends
+	only changed spans using cursor addressing.
+	'\n' clears the rest of the current line and moves to the next one.
+*/
+
+class VirtualScreen:public PrintTerminal {
+public:
+	VirtualScreen(PrintTerminal *term, uint8_t rows = 24, uint8_t cols = 80);
+	~VirtualScreen(void);
+
+	/* clear terminal, hide cursor and redraw everything on next flush */
+	void begin(void);
+
+	/* move cursor, 0 based */
+	void move(uint8_t row, uint8_t col);
+	void home(void) { move(0, 0); }
+	/* clear from cursor to end of line or to end of screen */
+	void clearEol(void);
+	void clearDown(void);
+	/* put character c n times */
+	void fill(uint8_t c, unsigned n);
+
+	virtual void putch(uint8_t c);
+	virtual void puts(const char *str);
+	virtual int  print(const char *format, ...);
+	/* send changes to the terminal */
+	virtual void flush(void);
+
+	/* bytes sent to the terminal */
+	uint32_t sent(void) { return nsent; }
+
+private:
+	PrintTerminal *term;
+	uint8_t  rows;
+	uint8_t  cols;
+	uint8_t  row; /* cursor */
+	uint8_t  col;
+	uint8_t  trow; /* terminal cursor after last flush, rows if unknown */
+	uint8_t  tcol;
+	char    *back;  /* being drawn */
+	char    *front; /* on the terminal */
+	uint32_t nsent;
+	unsigned olen;
+	char     out[256];
+
+	void emit(const char *str, unsigned len);
+	void emit_move(uint8_t r, uint8_t c);
+};
+
+#endif
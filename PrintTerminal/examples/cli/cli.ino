@@ -31,6 +31,7 @@
 #include <SerialTerminal.h>
 #include <SimpleCli.h>
 #include <led.h>
+#include <subproc.h>
 
 led_t led;
 
@@ -39,14 +40,18 @@ led_t led;
 
 SerialTerminal term(MAX_TERM_STR_LEN);
 
-extern int cli_handler(char *buf, PrintTerminal *term);
-SimpleCli cli(&term, cli_handler);
+SimpleCli cli(&term, NULL);
+extern const cli_cmd_t cli_table[];
+extern const unsigned cli_ncmds;
+extern subproc_t sysproc;
+void system_output(void);
 
 void setup()
 {
 	// use USB serial as a terminal
 	term.attach(&Serial);
 	term.begin(115200);
+	cli.commands(cli_table, cli_ncmds);
 
 	// we'll control onboard LED
 	led.attach(13);
@@ -60,76 +65,81 @@ void loop()
 	// check terminal input
 	while((ch = term.getch()) != 0)
 		cli.interact(ch);
+
+	// output of 'system' command running in background
+	if (subproc_running(&sysproc))
+		system_output();
 	
 	delay(50);
 }
 
-#define LINE_MAX 512
+static int led_cmd(cli_args_t *args, PrintTerminal *term)
+{
+	// no argument provided - show current state
+	if (args->argc == 0)
+		term->print("led is %s\n", led.state() ? "on" : "off");
+	else if (cmd_is(args->argv[0], "on"))
+		led.on();
+	else
+		led.off();
+	return 0;
+}
 
-// list of supported commands 
-const char *cmd_list[] = {
-	"help",			// be nice and provide some help
-	"led [on|off]", // LED manipulation
-	"system [cmd]", // 'system format C:' for example ;)
-	"reset console" // reset system console
-};
+// 'system' runs in background, so loop() keeps serving the terminal
+subproc_t sysproc = { 0, -1, -1 };
 
-// called by terminal for every new command line
-int cli_handler(char *buf, PrintTerminal *term)
+static void system_cancel(void *data)
 {
-	char *arg;
-	char cmd[CMD_LEN + 1];
-	char wline[LINE_MAX];
-
-	memcpy(cmd, buf, sizeof(cmd));
+	subproc_kill(&sysproc, SIGINT);
+}
 
-	if (cmd_is(cmd, "help")) {
-		term->print("List of supported commands:\n");
-		for(uint8_t i = 0; i < sizeof(cmd_list)/sizeof(cmd_list[0]); i++)
-			term->print("   %s\n", cmd_list[i]);
-		return 0;
+void system_output(void)
+{
+	char buf[256];
+	int n;
+
+	while((n = subproc_read(&sysproc, buf, sizeof(buf))) > 0)
+		term.write(buf, n);
+	if (n < 0) {
+		cli.setCancel(NULL);
+		n = subproc_wait(&sysproc);
+		if (n != 0)
+			term.print("exit status %d\n", n);
 	}
+}
 
-	if (cmd_arg(cmd, "reset", &arg)) {
-		// ignore arg...
-		Serial2.begin(115200);
-		delay(100);
-		term->print("reseting...\n");
-		Serial2.println("\nreseting...");
-		delay(100);
-		Serial2.end();
-		return 0;
-	}
+static int system_cmd(cli_args_t *args, PrintTerminal *term)
+{
+	// by default show system name
+	const char *arg = args->argc ? args->argv[0] : "uname -a";
 
-	if (cmd_arg(cmd, "led", &arg)) {
-		if (cmd_is(arg, "on")) {
-			led.on();
-			return 0;
-		}
-		if (cmd_is(arg, "off")) {
-			led.off();
-			return 0;
-		}
-		// no argument provided - show current state
-		if (*arg == '\0') {
-			term->print("led is %s\n", led.state() ? "on" : "off");
-			return 0;
-		}
+	if (subproc_running(&sysproc)) {
+		term->print("'system' is still running, Ctrl-C to stop it\n");
+		return -1;
 	}
-
-	if (cmd_arg(buf, "system", &arg)) {
-		if (*arg == '\0') // by default show system name
-			arg = "uname -a";
-		FILE *pf = popen(arg, "r");
-		if (pf) {
-			while (fgets(wline, LINE_MAX, pf) != NULL) {
-				term->print("%s", wline);
-			}
-			pclose(pf);
-		}
-		return 0;
+	if (subproc_start(&sysproc, arg) < 0) {
+		term->print("unable to run '%s'\n", arg);
+		return -1;
 	}
+	cli.setCancel(system_cancel);
+	return 0;
+}
 
-	term->print("Unknown command '%s'\n", buf);
-	return -1;
+static int reset_console(cli_args_t *args, PrintTerminal *term)
+{
+	Serial2.begin(115200);
+	delay(100);
+	term->print("reseting...\n");
+	Serial2.println("\nreseting...");
+	delay(100);
+	Serial2.end();
+	return 0;
 }
+
+// list of supported commands, 'help' and TAB completion are provided by SimpleCli
+const cli_cmd_t cli_table[] = {
+	{ "led",           "[on|off]",   led_cmd,       "LED manipulation" },
+	{ "system",        "[<cmd...>]", system_cmd,    "'system top' for example, Ctrl-C to stop" },
+	{ "reset console", NULL,         reset_console, "reset system console" },
+};
+const unsigned cli_ncmds = sizeof(cli_table)/sizeof(cli_table[0]);
@@ -0,0 +1,131 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+/*
+	Compares TPRINT output with snprintf for the supported conversions,
+	signed, unsigned, short and char arguments included.
+
+	g++ -std=c++11 -O2 -I../.. -o tformat_check tformat_check.cpp
+	./tformat_check
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+
+#include <TermFormat.h>
+
+// collects output in a string
+class StrTerminal : public PrintTerminal {
+public:
+	StrTerminal(void) { len = 0; buf[0] = '\0'; }
+	void clear(void) { len = 0; buf[0] = '\0'; }
+	const char *str(void) { return buf; }
+
+	virtual void putch(uint8_t c) { write((const char *)&c, 1); }
+	virtual void puts(const char *str) { write(str, strlen(str)); }
+	virtual int print(const char *format, ...) {
+		va_list ap;
+		va_start(ap, format);
+		int n = vsnprintf(buf + len, sizeof(buf) - len, format, ap);
+		va_end(ap);
+		len += n;
+		return n;
+	}
+	virtual void write(const char *data, unsigned n) {
+		if (n > sizeof(buf) - len - 1)
+			n = sizeof(buf) - len - 1;
+		memcpy(buf + len, data, n);
+		len += n;
+		buf[len] = '\0';
+	}
+
+private:
+	unsigned len;
+	char buf[512];
+};
+
+static StrTerminal term;
+static int nchecks;
+static int nerrors;
+
+#define CHECK(fmt, ...) \
+	do { \
+		char expect[512]; \
+		snprintf(expect, sizeof(expect), fmt, ##__VA_ARGS__); \
+		term.clear(); \
+		TPRINT(term, fmt, ##__VA_ARGS__); \
+		nchecks++; \
+		if (strcmp(expect, term.str())) { \
+			nerrors++; \
+			printf("line %d: \"%s\": printf '%s' TPRINT '%s'\n", __LINE__, fmt, expect, term.str()); \
+		} \
+	} while(0)
+
+int main(void)
+{
+	int i = -1;
+	short s = -1;
+	short smin = SHRT_MIN;
+	signed char c = -5;
+	long l = -1;
+	long long ll = -1;
+	unsigned u = UINT_MAX;
+	unsigned short us = 65535;
+	uint8_t u8 = 200;
+
+	// signed arguments with unsigned conversions are printed as
+	// printf prints them after integer promotion
+	CHECK("%x %X %u", i, i, i);
+	CHECK("%x %X %u", s, s, s);
+	CHECK("%x %u %d", smin, smin, smin);
+	CHECK("%x %u %d", c, c, c);
+	CHECK("%lx %lu %ld", l, l, l);
+	CHECK("%llx %llu %lld", ll, ll, ll);
+	CHECK("%d %i", INT_MIN, INT_MAX);
+	CHECK("%lld %lld", LLONG_MIN, LLONG_MAX);
+	CHECK("%u %x %d", u, u, us);
+	CHECK("%hu %hx %u", us, us, u8);
+
+	// flags, width and precision
+	CHECK("[%5d] [%-5d] [%05d] [%+d] [% d]", 42, 42, -42, 42, 42);
+	CHECK("[%08x] [%-8X] [%.3d] [%.0d] [%8.3u]", 0xBEEFu, 0xBEEFu, 7, 0, 7u);
+	CHECK("[%6hd] [%-6hd] [%06hd]", s, s, s);
+	CHECK("[%c] [%3c] [%-3c]", 'a', 'b', 'c');
+	CHECK("[%s] [%8s] [%-8s] [%.2s]", "gps", "gps", "gps", "gps");
+	CHECK("%% %d%%", 100);
+
+	// fixed point
+	CHECK("%f %.2f %.0f %.9f", 3.14159, -2.675, 0.5, 1.0 / 3);
+	CHECK("[%10.4f] [%-10.2f] [%010.3f] [%+.1f]", 53.36131, -6.5056, -1.5, 2.25);
+	CHECK("%.8f %.8f", 53.3613, -6.5056);
+
+	printf("%d checks, %d errors\n", nchecks, nerrors);
+	return nerrors ? 1 : 0;
+}
@@ -0,0 +1,341 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#include <Arduino.h>
+
+#ifdef __ARDUINO_X86__
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "eventloop.h"
+
+#define TIMER_SOURCE 0xFFFFFFFFu // epoll tag of the timerfd
+
+static inline uint64_t make_tag(uint32_t idx, uint32_t gen)
+{
+	return ((uint64_t)gen << 32) | idx;
+}
+
+EventLoop::EventLoop(void) : wheel(now())
+{
+	efd = tfd = -1;
+	running = false;
+	armed = 0;
+	is_armed = false;
+	nwakeups = 0;
+	ndefer = 0;
+	memset(src, 0, sizeof(src));
+	for(int i = 0; i < EVL_MAX_SOURCES; i++)
+		src[i].fd = -1;
+}
+
+EventLoop::~EventLoop(void)
+{
+	end();
+}
+
+uint32_t EventLoop::now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int EventLoop::begin(void)
+{
+	end();
+
+	efd = epoll_create1(EPOLL_CLOEXEC);
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (efd < 0 || tfd < 0) {
+		end();
+		return -1;
+	}
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.u64 = TIMER_SOURCE;
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, tfd, &ev) < 0) {
+		end();
+		return -1;
+	}
+	is_armed = false;
+	arm();
+	return 0;
+}
+
+void EventLoop::end(void)
+{
+	for(int i = 0; i < EVL_MAX_SOURCES; i++) {
+		if (src[i].poll)
+			removePoller(i);
+		src[i].fd = -1;
+		src[i].handler = NULL;
+	}
+	if (tfd >= 0)
+		close(tfd);
+	if (efd >= 0)
+		close(efd);
+	efd = tfd = -1;
+	ndefer = 0;
+}
+
+int EventLoop::alloc(int fd)
+{
+	for(int i = 0; i < EVL_MAX_SOURCES; i++) {
+		if (src[i].handler == NULL && src[i].poll == NULL) {
+			src[i].fd = fd;
+			src[i].gen++;
+			return i;
+		}
+	}
+	return -1;
+}
+
+int EventLoop::find(int fd)
+{
+	for(int i = 0; i < EVL_MAX_SOURCES; i++) {
+		if (src[i].fd == fd && src[i].handler)
+			return i;
+	}
+	return -1;
+}
+
+int EventLoop::add(int fd, eventHandler *handler, void *data, uint32_t events)
+{
+	if (efd < 0 || fd < 0 || handler == NULL || find(fd) >= 0)
+		return -1;
+
+	int idx = alloc(fd);
+	if (idx < 0)
+		return -1;
+
+	struct epoll_event ev;
+	ev.events = events;
+	ev.data.u64 = make_tag(idx, src[idx].gen);
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		src[idx].fd = -1;
+		return -1;
+	}
+	src[idx].handler = handler;
+	src[idx].data = data;
+	return 0;
+}
+
+int EventLoop::modify(int fd, uint32_t events)
+{
+	int idx = find(fd);
+	if (idx < 0)
+		return -1;
+
+	struct epoll_event ev;
+	ev.events = events;
+	ev.data.u64 = make_tag(idx, src[idx].gen);
+	return epoll_ctl(efd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+int EventLoop::remove(int fd)
+{
+	int idx = find(fd);
+	if (idx < 0)
+		return -1;
+
+	epoll_ctl(efd, EPOLL_CTL_DEL, fd, NULL);
+	src[idx].fd = -1;
+	src[idx].handler = NULL;
+	return 0;
+}
+
+int EventLoop::on_poll(void *data)
+{
+	source *s = (source *)data;
+	s->poll(s->data);
+	return 0;
+}
+
+int EventLoop::addPoller(loopHandler *handler, void *data, uint32_t interval, const char *dev)
+{
+	if (efd < 0 || handler == NULL || interval == 0)
+		return -1;
+
+	int idx = alloc(-1);
+	if (idx < 0)
+		return -1;
+
+	source *s = &src[idx];
+	s->poll = handler;
+	s->data = data;
+	s->timer = new wtimer_t(on_poll, s);
+
+	// only readiness is needed, data is read by the handler through its own port
+	if (dev && (s->fd = open(dev, O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC)) >= 0) {
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.u64 = make_tag(idx, s->gen);
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, s->fd, &ev) < 0) {
+			close(s->fd);
+			s->fd = -1;
+		}
+	}
+	start(s->timer, interval, interval);
+	return idx;
+}
+
+void EventLoop::removePoller(int id)
+{
+	if (id < 0 || id >= EVL_MAX_SOURCES || src[id].poll == NULL)
+		return;
+
+	source *s = &src[id];
+	cancel(s->timer);
+	delete s->timer;
+	if (s->fd >= 0) {
+		epoll_ctl(efd, EPOLL_CTL_DEL, s->fd, NULL);
+		close(s->fd);
+	}
+	s->fd = -1;
+	s->poll = NULL;
+	s->timer = NULL;
+}
+
+void EventLoop::start(wtimer_t *timer, uint32_t delay, uint32_t period)
+{
+	wheel.start(timer, now(), delay, period);
+	arm();
+}
+
+void EventLoop::cancel(wtimer_t *timer)
+{
+	// timerfd stays armed, an early wakeup is cheaper than re-arming
+	wheel.cancel(timer);
+}
+
+int EventLoop::defer(loopHandler *handler, void *data)
+{
+	if (ndefer == EVL_MAX_DEFER)
+		return -1;
+	dq[ndefer].handler = handler;
+	dq[ndefer].data = data;
+	ndefer++;
+	return 0;
+}
+
+// set timerfd to the nearest timer deadline
+void EventLoop::arm(void)
+{
+	if (tfd < 0)
+		return;
+
+	uint32_t tnow = now();
+	int32_t delay = wheel.next(tnow);
+	if (delay < 0) {
+		// no timers, leave it as it is if armed, wakeup will be ignored
+		return;
+	}
+
+	uint32_t deadline = tnow + delay;
+	if (is_armed && (int32_t)(deadline - armed) >= 0 && (int32_t)(armed - tnow) >= 0)
+		return; // will wake up earlier anyway
+
+	struct itimerspec its;
+	memset(&its, 0, sizeof(its));
+	// 0 disarms timerfd, so use 1 nsec for already expired timers
+	its.it_value.tv_sec = delay / 1000;
+	its.it_value.tv_nsec = (delay % 1000) * 1000000 + (delay ? 0 : 1);
+	timerfd_settime(tfd, 0, &its, NULL);
+	armed = deadline;
+	is_armed = true;
+}
+
+void EventLoop::run_timers(void)
+{
+	uint64_t expirations;
+
+	if (::read(tfd, &expirations, sizeof(expirations)) > 0)
+		is_armed = false;
+	wheel.run(now());
+	arm();
+}
+
+int EventLoop::run_once(int timeout)
+{
+	struct epoll_event ev[EVL_MAX_SOURCES + 1];
+	int ncalls = 0;
+
+	if (efd < 0)
+		return -1;
+
+	if (ndefer)
+		timeout = 0;
+
+	int n = epoll_wait(efd, ev, EVL_MAX_SOURCES + 1, timeout);
+	if (n < 0)
+		return (errno == EINTR) ? 0 : -1;
+	nwakeups++;
+
+	for(int i = 0; i < n; i++) {
+		if (ev[i].data.u64 == TIMER_SOURCE) {
+			run_timers();
+			ncalls++;
+			continue;
+		}
+
+		uint32_t idx = (uint32_t)ev[i].data.u64;
+		if (idx >= EVL_MAX_SOURCES || src[idx].gen != (uint32_t)(ev[i].data.u64 >> 32))
+			continue;
+
+		source *s = &src[idx];
+
+		if (s->handler)
+			s->handler(s->fd, ev[i].events, s->data);
+		else if (s->poll) {
+			if (ev[i].events & (EPOLLERR | EPOLLHUP)) {
+				// device is gone, keep polling by timer only
+				epoll_ctl(efd, EPOLL_CTL_DEL, s->fd, NULL);
+				close(s->fd);
+				s->fd = -1;
+			}
+			s->poll(s->data);
+		}
+		ncalls++;
+	}
+
+	// handlers can defer more calls, they will be run on the next iteration
+	uint32_t nq = ndefer;
+	for(uint32_t i = 0; i < nq; i++)
+		dq[i].handler(dq[i].data);
+	ncalls += nq;
+	ndefer -= nq;
+	if (ndefer)
+		memmove(dq, dq + nq, ndefer * sizeof(deferred));
+
+	return ncalls;
+}
+
+void EventLoop::run(void)
+{
+	running = true;
+	while(running) {
+		if (run_once(-1) < 0)
+			break;
+	}
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#ifndef __YAHL_EVENT_LOOP_H__
+#define __YAHL_EVENT_LOOP_H__
+
+/*
+	Single thread event loop: waits with epoll for file descriptors
+	(serial ports, sockets, epoll descriptors of other components) and
+	for timers of a TimerWheel driven by one timerfd, so nothing is
+	polled while idle. Sources without a descriptor, like TTYUARTClass
+	ports, are served by pollers: called when a watched device becomes
+	readable or every N msec if there is no device to watch.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/epoll.h>
+
+#include "timerwheel.h"
+
+#define EVL_MAX_SOURCES 32
+#define EVL_MAX_DEFER   16
+
+// called when fd is ready, events are EPOLLIN, EPOLLOUT, EPOLLERR, ...
+typedef void eventHandler(int fd, uint32_t events, void *data);
+// user callback, deferred to the next loop iteration or for pollers
+typedef void loopHandler(void *data);
+
+class EventLoop {
+public:
+	EventLoop(void);
+	~EventLoop(void);
+
+	int  begin(void);
+	void end(void);
+
+	// watch descriptor for events, EPOLLIN by default
+	int add(int fd, eventHandler *handler, void *data = NULL, uint32_t events = EPOLLIN);
+	int modify(int fd, uint32_t events);
+	int remove(int fd);
+
+	// poll source without descriptor: call handler every 'interval' msec;
+	// if 'dev' can be opened the handler is also called as soon as it
+	// is readable. Returns poller ID or -1
+	int addPoller(loopHandler *handler, void *data, uint32_t interval, const char *dev = NULL);
+	void removePoller(int id);
+
+	// timers, in msec of now()
+	void start(wtimer_t *timer, uint32_t delay, uint32_t period = 0);
+	void cancel(wtimer_t *timer);
+
+	// call handler once on the next iteration
+	int defer(loopHandler *handler, void *data = NULL);
+
+	// wait up to timeout msec (-1 forever) and dispatch events,
+	// returns number of handlers called or -1 on error
+	int run_once(int timeout = -1);
+	// run until stop() is called
+	void run(void);
+	void stop(void) { running = false; }
+
+	// CLOCK_MONOTONIC msec
+	static uint32_t now(void);
+	// loop iterations, for checking how idle the loop is
+	uint32_t wakeups(void) { return nwakeups; }
+
+private:
+	struct source {
+		int fd;
+		uint32_t gen; // detects stale events of removed sources
+		eventHandler *handler;
+		loopHandler  *poll; // poller, fd is the watched device
+		void *data;
+		wtimer_t *timer;
+	};
+	struct deferred {
+		loopHandler *handler;
+		void *data;
+	};
+
+	int efd;
+	int tfd;
+	bool running;
+	uint32_t armed; // timerfd deadline, valid if 'is_armed'
+	bool is_armed;
+	uint32_t nwakeups;
+	uint32_t ndefer;
+	TimerWheel wheel;
+	source src[EVL_MAX_SOURCES];
+	deferred dq[EVL_MAX_DEFER];
+
+	int  alloc(int fd);
+	int  find(int fd);
+	void arm(void);
+	void run_timers(void);
+	static int on_poll(void *data);
+};
+
+#endif
@@ -0,0 +1,131 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+/*
+	Randomized check of TimerWheel against a brute-force model:
+	next() must never be later than the nearest deadline, and a loop
+	sleeping exactly next() msec must run every handler on time.
+	A timer started at the time already passed to run() is due
+	on the next tick, one msec later.
+
+	g++ -O2 -I../.. -o twcheck twcheck.cpp ../../timerwheel.cpp
+	./twcheck [-n rounds] [-s seed]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <timerwheel.h>
+
+#define NTIMERS 64
+
+static wtimer_t *timers[NTIMERS];
+static uint32_t now;
+static uint32_t ran; // last time passed to run()
+static uint32_t late_runs;
+
+// deadline as the wheel sees it
+static uint32_t due(uint32_t deadline)
+{
+	return ((int32_t)(deadline - ran) > 0) ? deadline : ran + 1;
+}
+
+static int on_timer(void *data)
+{
+	wtimer_t *timer = *(wtimer_t **)data;
+	// periodic timers are already rescheduled, one-shot keep the deadline
+	uint32_t deadline = timer->active() ? timer->expires() - timer->get_period() : timer->expires();
+	if (now != due(deadline))
+		late_runs++;
+	return 0;
+}
+
+// delays around level boundaries and full turns are the interesting ones
+static uint32_t random_delay(void)
+{
+	static const uint32_t edge[] = { 64, 4096, 262144, 16777216 };
+	switch(rand() % 4) {
+	case 0: return rand() % 64;
+	case 1: return rand() % 5000;
+	case 2: return edge[rand() % 4] - 1 - rand() % 80;
+	}
+	return rand() % 300000;
+}
+
+// brute-force nearest deadline, -1 if no timers
+static int32_t model_next(void)
+{
+	int32_t best = -1;
+	for(int i = 0; i < NTIMERS; i++) {
+		if (!timers[i]->active())
+			continue;
+		int32_t delta = (int32_t)(due(timers[i]->expires()) - now);
+		if (delta < 0)
+			delta = 0;
+		if (best < 0 || delta < best)
+			best = delta;
+	}
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t rounds = 100000;
+	unsigned seed = 1;
+	uint32_t errors = 0;
+	int opt;
+
+	while((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch(opt) {
+		case 'n': rounds = atoi(optarg); break;
+		case 's': seed = atoi(optarg); break;
+		default:
+			printf("usage: %s [-n rounds] [-s seed]\n", argv[0]);
+			return 1;
+		}
+	}
+	srand(seed);
+
+	now = rand();
+	ran = now - 1;
+	TimerWheel wheel(now);
+	for(int i = 0; i < NTIMERS; i++)
+		timers[i] = new wtimer_t(on_timer, &timers[i]);
+
+	for(uint32_t r = 0; r < rounds; r++) {
+		wtimer_t *timer = timers[rand() % NTIMERS];
+		if (rand() % 8 == 0)
+			wheel.cancel(timer);
+		else if (!timer->active())
+			wheel.start(timer, now, random_delay(), (rand() % 4) ? 0 : 1 + random_delay());
+
+		int32_t expect = model_next();
+		int32_t got = wheel.next(now);
+		if ((expect < 0) != (got < 0) || got > expect) {
+			if (errors++ < 10)
+				printf("round %u now %u: next() %d, nearest deadline in %d msec\n",
+					r, now, got, expect);
+		}
+		// sleep as the event loop would, sometimes wake up earlier
+		if (got > 0)
+			now += (rand() % 4) ? got : rand() % got;
+		wheel.run(now);
+		ran = now;
+	}
+
+	printf("%u rounds, %u next() errors, %u late handler runs\n", rounds, errors, late_runs);
+	return (errors || late_runs) ? 1 : 0;
+}
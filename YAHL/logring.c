@@ -0,0 +1,194 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#include <Arduino.h>
+
+#ifdef __ARDUINO_X86__
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "logring.h"
+
+#define LOGRING_WRAP 0x01 // padding up to the end of buffer, skip it
+
+// chunk header is stored in the ring as is
+#define ALIGN(x) (((x) + 3) & ~3)
+
+int logring_init(logring_t *ring, uint32_t size)
+{
+	uint32_t n = 256;
+
+	memset(ring, 0, sizeof(logring_t));
+	while(n < size)
+		n <<= 1;
+	ring->buf = (char *)malloc(n);
+	if (ring->buf == NULL)
+		return -1;
+	ring->size = n;
+	return 0;
+}
+
+void logring_free(logring_t *ring)
+{
+	logring_stop(ring);
+	free(ring->buf);
+	ring->buf = NULL;
+	ring->size = 0;
+}
+
+static int put_chunk(logring_t *ring, uint8_t tag, uint32_t ts, const char *data, unsigned len)
+{
+	uint32_t head = ring->head;
+	uint32_t off = head & (ring->size - 1);
+	uint32_t need = LOGRING_HDR + ALIGN(len);
+	uint32_t contig = ring->size - off;
+	uint32_t skip = (contig < need) ? contig : 0;
+	logchunk_t *hdr;
+
+	// 'tail' is read once, consumer can only free more space meanwhile
+	if ((ring->size - (head - ring->tail)) < (skip + need))
+		return -1;
+
+	if (skip) {
+		// less than a header left at the end is skipped implicitly
+		if (skip >= LOGRING_HDR) {
+			hdr = (logchunk_t *)(ring->buf + off);
+			hdr->len = 0;
+			hdr->flags = LOGRING_WRAP;
+		}
+		off = 0;
+	}
+	hdr = (logchunk_t *)(ring->buf + off);
+	hdr->ts = ts;
+	hdr->len = len;
+	hdr->tag = tag;
+	hdr->flags = 0;
+	hdr->dropped = ring->pending;
+	ring->pending = 0;
+	memcpy(ring->buf + off + LOGRING_HDR, data, len);
+
+	// chunk must be in memory before consumer can see it
+	__sync_synchronize();
+	ring->head = head + skip + need;
+	return 0;
+}
+
+int logring_put(logring_t *ring, uint8_t tag, uint32_t ts, const void *data, unsigned len)
+{
+	const char *src = (const char *)data;
+	unsigned max = ring->size / 4 - LOGRING_HDR;
+	unsigned n;
+	int ret = 0;
+
+	if (max > 0xFFF8)
+		max = 0xFFF8;
+
+	do {
+		n = (len > max) ? max : len;
+		if (put_chunk(ring, tag, ts, src, n) < 0) {
+			ring->pending += n;
+			ring->dropped += n;
+			ring->lost++;
+			ret = -1;
+		}
+		src += n;
+		len -= n;
+	} while(len);
+
+	return ret;
+}
+
+int logring_get(logring_t *ring, logringReader *reader, void *arg)
+{
+	uint32_t tail = ring->tail;
+	uint32_t off;
+	uint32_t contig;
+	logchunk_t *hdr;
+
+	if (tail == ring->head)
+		return 0;
+	// do not read chunk data before 'head' is read
+	__sync_synchronize();
+
+	off = tail & (ring->size - 1);
+	contig = ring->size - off;
+	if (contig < LOGRING_HDR || (((logchunk_t *)(ring->buf + off))->flags & LOGRING_WRAP)) {
+		tail += contig;
+		off = 0;
+	}
+	hdr = (logchunk_t *)(ring->buf + off);
+
+	reader(hdr, ring->buf + off + LOGRING_HDR, arg);
+
+	// done with the data before producer can overwrite it
+	__sync_synchronize();
+	ring->tail = tail + LOGRING_HDR + ALIGN(hdr->len);
+	return 1;
+}
+
+static void *logring_thread(void *data)
+{
+	logring_t *ring = (logring_t *)data;
+	struct timespec idle;
+	pid_t tid = syscall(SYS_gettid);
+
+	// per thread nice value, Linux specific
+	setpriority(PRIO_PROCESS, tid, getpriority(PRIO_PROCESS, tid) + ring->nice);
+
+	idle.tv_sec = 0;
+	idle.tv_nsec = LOGRING_IDLE * 1000000L;
+
+	while(ring->running) {
+		if (!logring_get(ring, ring->reader, ring->arg))
+			nanosleep(&idle, NULL);
+	}
+	// flush what is left
+	while(logring_get(ring, ring->reader, ring->arg));
+
+	return NULL;
+}
+
+int logring_start(logring_t *ring, logringReader *reader, void *arg, int nice)
+{
+	if (ring->running || ring->buf == NULL)
+		return -1;
+
+	ring->reader = reader;
+	ring->arg = arg;
+	ring->nice = nice;
+	ring->running = 1;
+	if (pthread_create(&ring->thread, NULL, logring_thread, ring) != 0) {
+		ring->running = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void logring_stop(logring_t *ring)
+{
+	if (!ring->running)
+		return;
+	ring->running = 0;
+	pthread_join(ring->thread, NULL);
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#ifndef __YAHL_LOGRING_H__
+#define __YAHL_LOGRING_H__
+
+#ifdef __ARDUINO_X86__
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+	Single producer, single consumer ring of timestamped data chunks.
+	Producer (hot path, e.g. serial bridge) never blocks and never makes
+	a system call: if there is no space the chunk is dropped and counted.
+	Consumer is a lower priority thread which formats and prints chunks
+	at its own pace; it is told how much was dropped since the previous
+	chunk, so the log shows where the gaps are.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOGRING_HDR  12     // chunk header, data is padded to 4 bytes
+#define LOGRING_IDLE 20     // msec, consumer sleep when ring is empty
+
+typedef struct logchunk_s
+{
+	uint32_t ts;      // producer timestamp, units are up to the user
+	uint16_t len;     // data length
+	uint8_t  tag;     // user defined, direction for example
+	uint8_t  flags;   // internal
+	uint32_t dropped; // bytes dropped between previous chunk and this one
+} logchunk_t;
+
+// called by consumer thread for every chunk
+typedef void logringReader(const logchunk_t *chunk, const char *data, void *arg);
+
+typedef struct logring_s
+{
+	char    *buf;
+	uint32_t size; // power of 2
+	volatile uint32_t head;    // free running, written by producer only
+	volatile uint32_t tail;    // free running, written by consumer only
+	volatile uint32_t dropped; // total bytes, written by producer only
+	volatile uint32_t lost;    // total chunks, written by producer only
+	uint32_t pending;          // bytes dropped since the last chunk put
+	// consumer thread
+	pthread_t thread;
+	volatile int running;
+	int nice;
+	logringReader *reader;
+	void *arg;
+} logring_t;
+
+// size is rounded up to power of 2, returns 0 or -1
+int  logring_init(logring_t *ring, uint32_t size);
+void logring_free(logring_t *ring);
+
+// producer: copy chunk to the ring, chunks longer than size/4 are split;
+// returns 0 or -1 if (some of) the data was dropped
+int logring_put(logring_t *ring, uint8_t tag, uint32_t ts, const void *data, unsigned len);
+
+// consumer: call reader for the oldest chunk and release it,
+// returns 1 if a chunk was read or 0 if the ring is empty
+int logring_get(logring_t *ring, logringReader *reader, void *arg);
+
+// start consumer thread with 'nice' value relative to the caller,
+// it calls reader for every chunk and sleeps if the ring is empty
+int  logring_start(logring_t *ring, logringReader *reader, void *arg, int nice);
+// stop the thread after it has read all chunks put so far
+void logring_stop(logring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+#endif
@@ -19,92 +19,274 @@
 #ifdef __ARDUINO_X86__
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ifaddrs.h>
+#include <pthread.h>
 
 #include "netif.h"
 
-int get_netif_info(const char *name, netif_t *netif)
+#define PROC_NET_DEV "/proc/net/dev"
+#define SYS_CLASS_NET "/sys/class/net/"
+
+// cached /sys/class/net/<if>/address descriptors
+typedef struct hwfd_s
 {
-	iostat_t *pstat;
-	char *val, str[512];
-	int i, ifound = 0;
+	char name[IFNAMSIZ];
+	int  fd;
+} hwfd_t;
 
-	if (name == NULL || netif == NULL)
-		return -1;
+static int devfd = -1;
+static int nhw; // number of cached hwfd entries
+static hwfd_t hwfd[NETIF_MAX];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
 
-	memset(netif, 0, sizeof(netif_t));
+static int open_ro(const char *path)
+{
+	return open(path, O_RDONLY | O_CLOEXEC);
+}
 
-	sprintf(str, "ifconfig %s", name);
-	FILE *pf = popen(str, "r");
-	if (pf == NULL)
-		return -1;
+// whole file content into buf, returns length or -1
+static int read_file(int fd, char *buf, int size)
+{
+	int len = 0;
 
-	while(fgets(str, 512, pf)) {
-		if (strstr(str, name)) {
-			strcpy(netif->name, name);
-			ifound = 1;
-		}
+	while(len < (size - 1)) {
+		ssize_t n = pread(fd, buf + len, size - 1 - len, len);
+		if (n < 0)
+			return -1;
+		if (n == 0)
+			break;
+		len += n;
+	}
+	buf[len] = '\0';
+	return len;
+}
 
-		if (!ifound)
-			continue;
+// whole /proc/net/dev, buffer is doubled until the file fits,
+// returns malloc()ed string to be freed by the caller or NULL
+static char *read_dev(void)
+{
+	int size = 4096;
+	char *buf = NULL;
 
-		if ((val = strstr(str, "HWaddr ")) != NULL) {
-			val = strchr(val, ' ') + 1;
-			for(i = 0; val[i] != '\0' && i < 17; i++)
-				netif->hwas[i] = val[i];
-			netif->hwas[i] = 0;
-			continue;
-		}
+	// netif_close() must not close devfd while it is being read
+	pthread_mutex_lock(&lock);
+	if (devfd < 0)
+		devfd = open_ro(PROC_NET_DEV);
 
-		if ((val = strstr(str, " inet addr:")) != NULL) {
-			val = strchr(val, ':') + 1;
-			while(*val == ' ') val++;
-			for(i = 0; val[i] != ' '; i++)
-				netif->ip4as[i] = val[i];
-			netif->ip4as[i] = 0;
-			continue;
+	while(devfd >= 0) {
+		char *nbuf = (char *)realloc(buf, size);
+		if (nbuf == NULL)
+			break;
+		buf = nbuf;
+		int len = read_file(devfd, buf, size);
+		if (len < 0)
+			break;
+		if (len < (size - 1)) {
+			pthread_mutex_unlock(&lock);
+			return buf;
 		}
+		size *= 2;
+	}
+	pthread_mutex_unlock(&lock);
+	free(buf);
+	return NULL;
+}
 
-		if ((val = strstr(str, " inet6 addr:")) != NULL) {
-			val = strchr(val, ':') + 1;
-			while(*val == ' ') val++;
-			for(i = 0; val[i] != ' ' && val[i] != '/'; i++)
-				netif->ip6as[i] = val[i];
-			netif->ip6as[i] = 0;
-			continue;
-		}
-			
-		if (strstr(str, "RX "))
-			pstat = &netif->rx;
+// HW address of the interface into buf, returns length or -1
+static int read_hwaddr(const char *name, char *buf, int size)
+{
+	char path[sizeof(SYS_CLASS_NET) + IFNAMSIZ + 8];
+	int i, fd, len = -1;
 
-		if (strstr(str, "TX "))
-			pstat = &netif->tx;
+	pthread_mutex_lock(&lock);
+	for(i = 0; i < nhw; i++) {
+		if (strcmp(hwfd[i].name, name) == 0)
+			break;
+	}
 
-		if ((val = strstr(str, " packets:")) != NULL) {
-			val = strchr(val, ':') + 1;
-			pstat->packets = strtoul(val, &val, 10);
+	if (i < nhw) {
+		len = read_file(hwfd[i].fd, buf, size);
+		if (len < 0) {
+			// interface was removed and maybe re-added, descriptor is stale
+			close(hwfd[i].fd);
+			hwfd[i] = hwfd[--nhw];
 		}
-		if ((val = strstr(str, " errors:")) != NULL) {
-			val = strchr(val, ':') + 1;
-			pstat->errors = strtoul(val, &val, 10);
-		}
-		if ((val = strstr(str, " dropped:")) != NULL) {
-			val = strchr(val, ':') + 1;
-			pstat->dropped = strtoul(val, &val, 10);
+	}
+
+	if (len < 0) {
+		snprintf(path, sizeof(path), SYS_CLASS_NET "%s/address", name);
+		if ((fd = open_ro(path)) >= 0) {
+			len = read_file(fd, buf, size);
+			// keep descriptor only if there is room in the cache
+			if (len >= 0 && nhw < NETIF_MAX) {
+				strncpy(hwfd[nhw].name, name, IFNAMSIZ - 1);
+				hwfd[nhw].name[IFNAMSIZ - 1] = '\0';
+				hwfd[nhw++].fd = fd;
+			}
+			else
+				close(fd);
 		}
+	}
+	pthread_mutex_unlock(&lock);
+	return len;
+}
+
+static const char *skip_space(const char *str)
+{
+	while(*str == ' ' || *str == '\t')
+		str++;
+	return str;
+}
+
+static uint64_t next_u64(const char **str)
+{
+	uint64_t val = 0;
+	const char *p = skip_space(*str);
+
+	while(*p >= '0' && *p <= '9')
+		val = val * 10 + (*p++ - '0');
+	*str = p;
+	return val;
+}
+
+/*
+	/proc/net/dev line, after 'name:'
+	  Receive: bytes packets errs drop fifo frame compressed multicast
+	  Transmit: bytes packets errs drop fifo colls carrier compressed
+*/
+static void parse_dev(const char *str, netif_t *netif)
+{
+	int i;
 
-		if ((val = strstr(str, "RX bytes:")) != NULL) {
-			val = strchr(val, ':') + 1;
-			netif->rx.bytes = strtoul(val, &val, 10);
+	netif->rx.bytes   = next_u64(&str);
+	netif->rx.packets = next_u64(&str);
+	netif->rx.errors  = next_u64(&str);
+	netif->rx.dropped = next_u64(&str);
+	for(i = 0; i < 4; i++)
+		next_u64(&str);
+	netif->tx.bytes   = next_u64(&str);
+	netif->tx.packets = next_u64(&str);
+	netif->tx.errors  = next_u64(&str);
+	netif->tx.dropped = next_u64(&str);
+}
+
+int get_netif_stat(const char *name, netif_t *netif)
+{
+	char *buf;
+	int ret = -1;
+
+	if (name == NULL || netif == NULL || (buf = read_dev()) == NULL)
+		return -1;
+
+	// skip two header lines
+	const char *line = strchr(buf, '\n');
+	if (line)
+		line = strchr(line + 1, '\n');
+	size_t nlen = strlen(name);
+
+	while(line) {
+		line = skip_space(line + 1);
+		const char *colon = strchr(line, ':');
+		if (colon == NULL)
+			break;
+		if ((size_t)(colon - line) == nlen && strncmp(line, name, nlen) == 0) {
+			strncpy(netif->name, name, IFNAMSIZ - 1);
+			netif->name[IFNAMSIZ - 1] = '\0';
+			parse_dev(colon + 1, netif);
+			ret = 0;
+			break;
 		}
-		if ((val = strstr(str, "TX bytes:")) != NULL) {
-			val = strchr(val, ':') + 1;
-			netif->tx.bytes = strtoul(val, &val, 10);
+		line = strchr(colon, '\n');
+	}
+
+	free(buf);
+	return ret;
+}
+
+int get_netif_list(netif_t *list, int max)
+{
+	char *buf;
+	int n = 0;
+
+	if (list == NULL || (buf = read_dev()) == NULL)
+		return -1;
+
+	const char *line = strchr(buf, '\n');
+	if (line)
+		line = strchr(line + 1, '\n');
+
+	while(line && n < max) {
+		line = skip_space(line + 1);
+		const char *colon = strchr(line, ':');
+		if (colon == NULL)
 			break;
+		netif_t *netif = &list[n++];
+		size_t nlen = colon - line;
+		if (nlen >= IFNAMSIZ)
+			nlen = IFNAMSIZ - 1;
+		memset(netif, 0, sizeof(netif_t));
+		memcpy(netif->name, line, nlen);
+		parse_dev(colon + 1, netif);
+		line = strchr(colon, '\n');
+	}
+
+	free(buf);
+	return n;
+}
+
+int get_netif_info(const char *name, netif_t *netif)
+{
+	struct ifaddrs *ifa, *pifa;
+	char hw[HW_ADDRSTRLEN + 1];
+
+	if (name == NULL || netif == NULL)
+		return -1;
+
+	memset(netif, 0, sizeof(netif_t));
+	if (get_netif_stat(name, netif) != 0)
+		return -1;
+
+	if (read_hwaddr(name, hw, sizeof(hw)) >= HW_ADDRSTRLEN - 1) {
+		memcpy(netif->hwas, hw, HW_ADDRSTRLEN - 1);
+		netif->hwas[HW_ADDRSTRLEN - 1] = '\0';
+	}
+
+	if (getifaddrs(&ifa) != 0)
+		return 0;
+
+	for(pifa = ifa; pifa; pifa = pifa->ifa_next) {
+		if (pifa->ifa_addr == NULL || strcmp(pifa->ifa_name, name))
+			continue;
+
+		if (pifa->ifa_addr->sa_family == AF_INET && !netif->ip4as[0]) {
+			struct sockaddr_in *sa = (struct sockaddr_in *)pifa->ifa_addr;
+			inet_ntop(AF_INET, &sa->sin_addr, netif->ip4as, INET_ADDRSTRLEN);
+		}
+		if (pifa->ifa_addr->sa_family == AF_INET6 && !netif->ip6as[0]) {
+			struct sockaddr_in6 *sa = (struct sockaddr_in6 *)pifa->ifa_addr;
+			inet_ntop(AF_INET6, &sa->sin6_addr, netif->ip6as, INET6_ADDRSTRLEN);
 		}
 	}
 
-	fclose(pf);
-	return ifound ? 0 : -1;
+	freeifaddrs(ifa);
+	return 0;
+}
+
+void netif_close(void)
+{
+	int i;
+
+	pthread_mutex_lock(&lock);
+	if (devfd >= 0)
+		close(devfd);
+	devfd = -1;
+	for(i = 0; i < nhw; i++)
+		close(hwfd[i].fd);
+	nhw = 0;
+	pthread_mutex_unlock(&lock);
 }
 
 #endif
@@ -25,7 +25,10 @@
 #include <netinet/in.h>
 
 /*
-	Network interface information from 'ifconfig' command
+	Network interface information read directly from the kernel:
+	counters from /proc/net/dev, HW address from /sys/class/net/<if>/address
+	and IP addresses from getifaddrs(). Files stay open and are re-read
+	with pread(), so a query costs microseconds instead of popen("ifconfig").
 */
 
 #ifdef __cplusplus
@@ -33,14 +36,15 @@ extern "C" {
 #endif
 
 #define HW_ADDRSTRLEN 18
+#define NETIF_MAX     16 // max interfaces with cached descriptors
 
 // network interface statistics
 typedef struct iostat_s
 {
-	uint32_t packets;
-	uint32_t errors;
-	uint32_t dropped;
-	uint32_t bytes;		// increment to uint64_t if needed
+	uint64_t packets;
+	uint64_t errors;
+	uint64_t dropped;
+	uint64_t bytes;
 } iostat_t;
 
 // network interface information
@@ -56,6 +60,12 @@ typedef struct netif_s
 
 // interface name to get information for
 int get_netif_info(const char *name, netif_t *netif);
+// update only name and rx/tx counters, cheaper than get_netif_info()
+int get_netif_stat(const char *name, netif_t *netif);
+// name and counters of up to max interfaces, returns number of interfaces
+int get_netif_list(netif_t *list, int max);
+// close cached file descriptors
+void netif_close(void);
 
 #ifdef __cplusplus
 }
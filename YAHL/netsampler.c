@@ -0,0 +1,237 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#include <Arduino.h>
+
+#ifdef __ARDUINO_X86__
+
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "netsampler.h"
+
+typedef struct ifring_s
+{
+	char     name[IFNAMSIZ];
+	uint32_t count; // total samples taken
+	netrate_t rx;
+	netrate_t tx;
+	netsample_t ring[NETSAMPLER_HISTORY];
+} ifring_t;
+
+static struct sampler_s
+{
+	pthread_t       thread;
+	pthread_mutex_t lock;
+	pthread_cond_t  wake;
+	int      running;
+	uint32_t period;
+	double   alpha;
+	int      nif;
+	ifring_t ifs[NETIF_MAX];
+} sampler = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static uint64_t now_msec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static ifring_t *find_if(const char *name)
+{
+	int i;
+
+	for(i = 0; i < sampler.nif; i++) {
+		if (strcmp(sampler.ifs[i].name, name) == 0)
+			return &sampler.ifs[i];
+	}
+	return NULL;
+}
+
+static double ewma(double avg, double val, double alpha, int first)
+{
+	return first ? val : avg + alpha * (val - avg);
+}
+
+// counters can go backward if interface was re-created
+static double delta(uint64_t cur, uint64_t prev, double secs)
+{
+	return (cur >= prev) ? (cur - prev) / secs : 0;
+}
+
+static void update_rate(netrate_t *rate, const iostat_t *cur, const iostat_t *prev, double secs, int first)
+{
+	double alpha = sampler.alpha;
+
+	rate->packets = ewma(rate->packets, delta(cur->packets, prev->packets, secs), alpha, first);
+	rate->errors  = ewma(rate->errors,  delta(cur->errors,  prev->errors,  secs), alpha, first);
+	rate->dropped = ewma(rate->dropped, delta(cur->dropped, prev->dropped, secs), alpha, first);
+	rate->bytes   = ewma(rate->bytes,   delta(cur->bytes,   prev->bytes,   secs), alpha, first);
+}
+
+static void take_sample(void)
+{
+	netif_t list[NETIF_MAX];
+	uint64_t msec = now_msec();
+	int i, n = get_netif_list(list, NETIF_MAX);
+
+	pthread_mutex_lock(&sampler.lock);
+	for(i = 0; i < n; i++) {
+		ifring_t *ifr = find_if(list[i].name);
+		if (ifr == NULL) {
+			if (sampler.nif == NETIF_MAX)
+				continue;
+			ifr = &sampler.ifs[sampler.nif++];
+			memset(ifr, 0, sizeof(ifring_t));
+			strcpy(ifr->name, list[i].name);
+		}
+
+		netsample_t *cur = &ifr->ring[ifr->count % NETSAMPLER_HISTORY];
+		cur->msec = msec;
+		cur->rx = list[i].rx;
+		cur->tx = list[i].tx;
+
+		if (ifr->count) {
+			netsample_t *prev = &ifr->ring[(ifr->count - 1) % NETSAMPLER_HISTORY];
+			double secs = (msec - prev->msec) / 1000.0;
+			if (secs > 0) {
+				update_rate(&ifr->rx, &cur->rx, &prev->rx, secs, ifr->count == 1);
+				update_rate(&ifr->tx, &cur->tx, &prev->tx, secs, ifr->count == 1);
+			}
+		}
+		ifr->count++;
+	}
+	pthread_mutex_unlock(&sampler.lock);
+}
+
+static void *sampler_thread(void *arg)
+{
+	struct timespec deadline;
+
+	(void)arg;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	pthread_mutex_lock(&sampler.lock);
+	while(sampler.running) {
+		pthread_mutex_unlock(&sampler.lock);
+		take_sample();
+		pthread_mutex_lock(&sampler.lock);
+
+		// absolute deadlines, so sampling period does not drift
+		deadline.tv_sec  += sampler.period / 1000;
+		deadline.tv_nsec += (sampler.period % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		while(sampler.running) {
+			if (pthread_cond_timedwait(&sampler.wake, &sampler.lock, &deadline) == ETIMEDOUT)
+				break;
+		}
+	}
+	pthread_mutex_unlock(&sampler.lock);
+	return NULL;
+}
+
+int netsampler_start(uint32_t period, double alpha)
+{
+	pthread_condattr_t attr;
+
+	if (period == 0 || alpha <= 0 || alpha > 1)
+		return -1;
+
+	netsampler_stop();
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sampler.wake, &attr);
+	pthread_condattr_destroy(&attr);
+
+	sampler.period = period;
+	sampler.alpha = alpha;
+	sampler.nif = 0;
+	sampler.running = 1;
+	if (pthread_create(&sampler.thread, NULL, sampler_thread, NULL) != 0) {
+		sampler.running = 0;
+		pthread_cond_destroy(&sampler.wake);
+		return -1;
+	}
+	return 0;
+}
+
+void netsampler_stop(void)
+{
+	pthread_mutex_lock(&sampler.lock);
+	if (!sampler.running) {
+		pthread_mutex_unlock(&sampler.lock);
+		return;
+	}
+	sampler.running = 0;
+	pthread_cond_signal(&sampler.wake);
+	pthread_mutex_unlock(&sampler.lock);
+
+	pthread_join(sampler.thread, NULL);
+	pthread_cond_destroy(&sampler.wake);
+}
+
+int netsampler_list(char names[][IFNAMSIZ], int max)
+{
+	int n;
+
+	pthread_mutex_lock(&sampler.lock);
+	for(n = 0; n < sampler.nif && n < max; n++)
+		strcpy(names[n], sampler.ifs[n].name);
+	pthread_mutex_unlock(&sampler.lock);
+	return n;
+}
+
+int netsampler_rate(const char *name, netrate_t *rx, netrate_t *tx)
+{
+	int ret = -1;
+
+	pthread_mutex_lock(&sampler.lock);
+	ifring_t *ifr = find_if(name);
+	// rates need at least two samples
+	if (ifr && ifr->count > 1) {
+		if (rx)
+			*rx = ifr->rx;
+		if (tx)
+			*tx = ifr->tx;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&sampler.lock);
+	return ret;
+}
+
+int netsampler_history(const char *name, netsample_t *samples, int max)
+{
+	int i, n = 0;
+
+	pthread_mutex_lock(&sampler.lock);
+	ifring_t *ifr = find_if(name);
+	if (ifr) {
+		n = (ifr->count < NETSAMPLER_HISTORY) ? ifr->count : NETSAMPLER_HISTORY;
+		if (n > max)
+			n = max;
+		for(i = 0; i < n; i++)
+			samples[i] = ifr->ring[(ifr->count - n + i) % NETSAMPLER_HISTORY];
+	}
+	pthread_mutex_unlock(&sampler.lock);
+	return n;
+}
+
+#endif
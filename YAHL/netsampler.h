@@ -0,0 +1,69 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#ifndef __YAHL_NET_SAMPLER_H__
+#define __YAHL_NET_SAMPLER_H__
+
+#ifdef __ARDUINO_X86__
+
+#include "netif.h"
+
+/*
+	Background sampler of network interface counters: a thread snapshots
+	all interfaces every 'period' msec into a per-interface ring buffer
+	and keeps EWMA smoothed per second rates
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NETSAMPLER_HISTORY 64 // samples kept per interface
+
+// per second rates
+typedef struct netrate_s
+{
+	double packets;
+	double errors;
+	double dropped;
+	double bytes;
+} netrate_t;
+
+// one snapshot of interface counters
+typedef struct netsample_s
+{
+	uint64_t msec; // CLOCK_MONOTONIC time
+	iostat_t rx;
+	iostat_t tx;
+} netsample_t;
+
+// start sampling, alpha is EWMA weight of a new sample: 0 < alpha <= 1
+int  netsampler_start(uint32_t period, double alpha);
+void netsampler_stop(void);
+
+// names of sampled interfaces, returns number of interfaces
+int netsampler_list(char names[][IFNAMSIZ], int max);
+// smoothed rates of the interface, rx or tx can be NULL
+int netsampler_rate(const char *name, netrate_t *rx, netrate_t *tx);
+// up to max latest samples, oldest first, returns number of samples
+int netsampler_history(const char *name, netsample_t *samples, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+#endif
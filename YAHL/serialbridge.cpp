@@ -0,0 +1,337 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#include <Arduino.h>
+
+#ifdef __ARDUINO_X86__
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "serialbridge.h"
+
+#define RING_MASK (BRIDGE_RING - 1)
+
+static uint64_t now_usec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+SerialBridge::SerialBridge(void)
+{
+	loop = NULL;
+	fd[0] = fd[1] = -1;
+	events[0] = events[1] = 0;
+	use_splice = true;
+	monitor = NULL;
+	mdata = NULL;
+	memset(dir, 0, sizeof(dir));
+	dir[0].pipe[0] = dir[0].pipe[1] = -1;
+	dir[1].pipe[0] = dir[1].pipe[1] = -1;
+}
+
+SerialBridge::~SerialBridge(void)
+{
+	end();
+}
+
+int SerialBridge::begin(EventLoop *loop, int a, int b)
+{
+	end();
+	if (a < 0 || b < 0)
+		return -1;
+
+	this->loop = loop;
+	fd[0] = a;
+	fd[1] = b;
+	fcntl(a, F_SETFL, fcntl(a, F_GETFL) | O_NONBLOCK);
+	fcntl(b, F_SETFL, fcntl(b, F_GETFL) | O_NONBLOCK);
+
+	for(int i = 0; i < 2; i++) {
+		path *p = &dir[i];
+		p->src = fd[i];
+		p->dst = fd[1 - i];
+		p->pending = p->head = p->tail = 0;
+		p->full = p->eof = false;
+		if (use_splice && pipe(p->pipe) < 0)
+			use_splice = false;
+		if (p->pipe[0] >= 0) {
+			fcntl(p->pipe[0], F_SETFL, O_NONBLOCK);
+			fcntl(p->pipe[1], F_SETFL, O_NONBLOCK);
+		}
+	}
+	if (!use_splice)
+		close_pipes();
+	resetStat();
+
+	events[0] = events[1] = EPOLLIN;
+	if (loop->add(a, on_event, this, EPOLLIN) < 0 || loop->add(b, on_event, this, EPOLLIN) < 0) {
+		end();
+		return -1;
+	}
+	return 0;
+}
+
+void SerialBridge::end(void)
+{
+	if (loop) {
+		loop->remove(fd[0]);
+		loop->remove(fd[1]);
+	}
+	close_pipes();
+	loop = NULL;
+	fd[0] = fd[1] = -1;
+}
+
+void SerialBridge::close_pipes(void)
+{
+	for(int i = 0; i < 2; i++) {
+		for(int n = 0; n < 2; n++) {
+			if (dir[i].pipe[n] >= 0)
+				close(dir[i].pipe[n]);
+			dir[i].pipe[n] = -1;
+		}
+	}
+}
+
+void SerialBridge::setMonitor(bridgeMonitor *monitor, void *data)
+{
+	this->monitor = monitor;
+	mdata = data;
+	// monitor needs to see the data, switch to ring buffers; with data
+	// in the pipes sources are not read until both directions drain
+	rings();
+	if (loop)
+		update();
+}
+
+// switch from splice pipes to ring buffers once the pipes are empty
+void SerialBridge::rings(void)
+{
+	if (use_splice && monitor && dir[0].pending == 0 && dir[1].pending == 0) {
+		use_splice = false;
+		close_pipes();
+	}
+}
+
+void SerialBridge::resetStat(void)
+{
+	uint32_t now = EventLoop::now();
+	for(int i = 0; i < 2; i++) {
+		memset(&dir[i].stat, 0, sizeof(bridge_stat_t));
+		dir[i].lat_sum = 0;
+		dir[i].lat_count = 0;
+		dir[i].sec_bytes = 0;
+		dir[i].t_sec = now;
+	}
+}
+
+void SerialBridge::getStat(int d, bridge_stat_t *stat)
+{
+	path *p = &dir[d & 1];
+	*stat = p->stat;
+	stat->lat_avg = p->lat_count ? (uint32_t)(p->lat_sum / p->lat_count) : 0;
+	// nothing was sent for a while
+	if ((EventLoop::now() - p->t_sec) > 2000)
+		stat->rate = 0;
+}
+
+// account len bytes written out
+void SerialBridge::sent(path *p, unsigned len)
+{
+	uint32_t now = EventLoop::now();
+
+	p->pending -= len;
+	p->stat.bytes += len;
+	p->stat.writes++;
+	if ((now - p->t_sec) >= 1000) {
+		p->stat.rate = (uint64_t)p->sec_bytes * 1000 / (now - p->t_sec);
+		p->sec_bytes = 0;
+		p->t_sec = now;
+	}
+	p->sec_bytes += len;
+
+	if (p->pending == 0) {
+		uint32_t lat = now_usec() - p->t_first;
+		if (p->lat_count == 0 || lat < p->stat.lat_min)
+			p->stat.lat_min = lat;
+		if (lat > p->stat.lat_max)
+			p->stat.lat_max = lat;
+		p->lat_sum += lat;
+		p->lat_count++;
+	}
+}
+
+// destination failed, drop what is buffered
+void SerialBridge::drop(path *p)
+{
+	char buf[256];
+
+	p->stat.errors++;
+	if (use_splice) {
+		while(p->pending && read(p->pipe[0], buf, sizeof(buf)) > 0);
+	}
+	p->pending = 0;
+	p->head = p->tail = 0;
+}
+
+// read source, returns true if anything was read
+bool SerialBridge::pull(path *p)
+{
+	bool got = false;
+	ssize_t n;
+
+	// waiting for the pipes to drain, see setMonitor()
+	if (use_splice && monitor)
+		return false;
+
+	while(!p->full && !p->eof) {
+		if (use_splice) {
+			n = splice(p->src, NULL, p->pipe[1], NULL, BRIDGE_PIPE - p->pending,
+				SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (n < 0 && errno == EINVAL && p->pending == 0 &&
+				dir[0].pending == 0 && dir[1].pending == 0) {
+				// descriptor can't be spliced, switch to ring buffers
+				use_splice = false;
+				close_pipes();
+				continue;
+			}
+		}
+		else {
+			unsigned chunk = BRIDGE_RING - p->head;
+			if (chunk > (BRIDGE_RING - p->pending))
+				chunk = BRIDGE_RING - p->pending;
+			n = read(p->src, p->ring + p->head, chunk);
+			if (n > 0) {
+				if (monitor)
+					monitor((p == &dir[0]) ? BRIDGE_A2B : BRIDGE_B2A, p->ring + p->head, n, mdata);
+				p->head = (p->head + n) & RING_MASK;
+			}
+		}
+
+		if (n > 0) {
+			if (p->pending == 0)
+				p->t_first = now_usec();
+			p->pending += n;
+			p->stat.reads++;
+			p->full = p->pending >= (use_splice ? BRIDGE_PIPE : BRIDGE_RING);
+			got = true;
+			continue;
+		}
+		// ttys in raw mode return 0 if there is no data, but pull()
+		// is called only when source is readable: that's end of file
+		if (n == 0) {
+			if (!got)
+				p->eof = true;
+		}
+		else if (errno == EINTR)
+			continue;
+		else if (errno != EAGAIN)
+			p->stat.errors++;
+		break;
+	}
+	return got;
+}
+
+// write to destination, returns true if anything was written
+bool SerialBridge::push(path *p)
+{
+	bool put = false;
+	ssize_t n;
+
+	while(p->pending) {
+		if (use_splice)
+			n = splice(p->pipe[0], NULL, p->dst, NULL, p->pending,
+				SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		else {
+			unsigned chunk = BRIDGE_RING - p->tail;
+			if (chunk > p->pending)
+				chunk = p->pending;
+			n = write(p->dst, p->ring + p->tail, chunk);
+			if (n > 0)
+				p->tail = (p->tail + n) & RING_MASK;
+		}
+
+		if (n > 0) {
+			sent(p, n);
+			p->full = false;
+			put = true;
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno == EAGAIN)
+			p->stat.stalls++;
+		else
+			drop(p);
+		break;
+	}
+	if (p->pending == 0) {
+		p->full = false;
+		rings();
+	}
+	return put;
+}
+
+// watch sources with space in buffer and destinations with pending data
+void SerialBridge::update(void)
+{
+	for(int i = 0; i < 2; i++) {
+		uint32_t ev = 0;
+		if (!dir[i].full && !dir[i].eof && !(use_splice && monitor))
+			ev |= EPOLLIN;
+		if (dir[1 - i].pending)
+			ev |= EPOLLOUT;
+		if (ev != events[i]) {
+			loop->modify(fd[i], ev);
+			events[i] = ev;
+		}
+	}
+}
+
+void SerialBridge::on_event(int fd, uint32_t events, void *data)
+{
+	SerialBridge *br = (SerialBridge *)data;
+	int i = (fd == br->fd[0]) ? 0 : 1;
+	path *in = &br->dir[i];      // fd is the source
+	path *out = &br->dir[1 - i]; // fd is the destination
+	bool done = false;
+
+	if (events & EPOLLOUT)
+		done |= br->push(out);
+	if (events & EPOLLIN) {
+		done |= br->pull(in);
+		// forward straight away, destination is usually ready
+		done |= br->push(in);
+	}
+
+	// hung up descriptor would wake the loop for ever
+	if ((events & (EPOLLERR | EPOLLHUP)) && !done) {
+		in->eof = true;
+		in->stat.errors++;
+		if (out->pending)
+			br->drop(out);
+		br->loop->remove(fd);
+		return;
+	}
+	br->update();
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#ifndef __YAHL_SERIAL_BRIDGE_H__
+#define __YAHL_SERIAL_BRIDGE_H__
+
+/*
+	Bidirectional bridge between two descriptors (serial ports from
+	tty_open(), pipes, sockets) driven by EventLoop. Data is moved in
+	blocks: with splice() through a pipe, so it never leaves the kernel,
+	or through a ring buffer with large reads and writes if a monitor
+	is set or descriptors can't be spliced. When the destination is
+	slow the source is not read until there is space again.
+*/
+#include <stdint.h>
+#include "eventloop.h"
+
+#define BRIDGE_RING 4096 // ring buffer per direction, power of 2
+#define BRIDGE_PIPE 16384 // max data kept in splice pipe per direction
+
+// directions
+#define BRIDGE_A2B 0
+#define BRIDGE_B2A 1
+
+// called with every block read in direction dir, before it is written
+typedef void bridgeMonitor(int dir, const char *block, unsigned len, void *data);
+
+typedef struct bridge_stat_s
+{
+	uint64_t bytes;   // forwarded
+	uint32_t reads;   // blocks read
+	uint32_t writes;  // blocks written
+	uint32_t stalls;  // destination was not ready to take data
+	uint32_t errors;  // read/write errors, data in buffer dropped
+	uint32_t rate;    // bytes per second over the last second
+	uint32_t lat_min; // usec, from read to written out
+	uint32_t lat_avg;
+	uint32_t lat_max;
+} bridge_stat_t;
+
+class SerialBridge {
+public:
+	SerialBridge(void);
+	~SerialBridge(void);
+
+	// forward data between a and b, both switched to non-blocking mode
+	int  begin(EventLoop *loop, int a, int b);
+	void end(void);
+
+	// called for every block forwarded, disables splice(); if there is
+	// data in splice pipes, sources are not read until it is written out
+	void setMonitor(bridgeMonitor *monitor, void *data = NULL);
+	// data moved by splice()
+	bool spliced(void) { return use_splice; }
+
+	void getStat(int dir, bridge_stat_t *stat);
+	void resetStat(void);
+
+private:
+	struct path {
+		int src;
+		int dst;
+		int pipe[2];
+		unsigned pending; // bytes in ring or pipe
+		unsigned head;
+		unsigned tail;
+		bool full;
+		bool eof;
+		uint64_t t_first; // usec, when the oldest pending byte was read
+		uint32_t t_sec;   // msec, start of the rate second
+		uint32_t sec_bytes;
+		uint64_t lat_sum;
+		uint32_t lat_count;
+		bridge_stat_t stat;
+		char ring[BRIDGE_RING];
+	};
+
+	EventLoop *loop;
+	int fd[2];
+	uint32_t events[2]; // epoll events watched for fd[]
+	bool use_splice;
+	bridgeMonitor *monitor;
+	void *mdata;
+	path dir[2];
+
+	static void on_event(int fd, uint32_t events, void *data);
+	bool pull(path *p);
+	bool push(path *p);
+	void drop(path *p);
+	void sent(path *p, unsigned len);
+	void update(void);
+	void rings(void);
+	void close_pipes(void);
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // pipe2()
+#endif
+#include <Arduino.h>
+
+#ifdef __ARDUINO_X86__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "subproc.h"
+
+int subproc_start(subproc_t *sp, const char *cmd)
+{
+	int pfd[2];
+	int null;
+	pid_t pid;
+
+	sp->pid = 0;
+	sp->fd = -1;
+	sp->status = -1;
+
+	// nothing but stdin/stdout/stderr is passed to the command,
+	// dup2() clears close-on-exec on the copies
+	if (pipe2(pfd, O_CLOEXEC) < 0)
+		return -1;
+	fcntl(pfd[0], F_SETFL, fcntl(pfd[0], F_GETFL) | O_NONBLOCK);
+	null = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+	// vfork: sketch can be big, no need to copy page tables for exec
+	pid = vfork();
+	if (pid == 0) {
+		setpgid(0, 0);
+		if (null >= 0)
+			dup2(null, STDIN_FILENO);
+		dup2(pfd[1], STDOUT_FILENO);
+		dup2(pfd[1], STDERR_FILENO);
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		_exit(127);
+	}
+
+	if (null >= 0)
+		close(null);
+	close(pfd[1]);
+	if (pid < 0) {
+		close(pfd[0]);
+		return -1;
+	}
+
+	// the child may not have run yet, make sure kill() can find the group
+	setpgid(pid, pid);
+	sp->pid = pid;
+	sp->fd = pfd[0];
+	return sp->fd;
+}
+
+int subproc_read(subproc_t *sp, char *buf, int len)
+{
+	int n;
+
+	if (sp->fd < 0)
+		return -1;
+	do {
+		n = read(sp->fd, buf, len);
+	} while(n < 0 && errno == EINTR);
+
+	if (n > 0)
+		return n;
+	if (n < 0 && errno == EAGAIN)
+		return 0;
+	return -1;
+}
+
+int subproc_kill(subproc_t *sp, int sig)
+{
+	if (sp->pid <= 0)
+		return -1;
+	return kill(-sp->pid, sig);
+}
+
+int subproc_wait(subproc_t *sp)
+{
+	int status;
+
+	if (sp->fd >= 0) {
+		close(sp->fd);
+		sp->fd = -1;
+	}
+	if (sp->pid <= 0)
+		return -1;
+
+	while(waitpid(sp->pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			sp->pid = 0;
+			return -1;
+		}
+	}
+	sp->pid = 0;
+	if (WIFEXITED(status))
+		sp->status = WEXITSTATUS(status);
+	else
+		sp->status = 128 + WTERMSIG(status);
+	return sp->status;
+}
+
+int subproc_running(const subproc_t *sp)
+{
+	return sp->pid > 0;
+}
+
+#endif
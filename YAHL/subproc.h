@@ -0,0 +1,59 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#ifndef __YAHL_SUBPROC_H__
+#define __YAHL_SUBPROC_H__
+
+#ifdef __ARDUINO_X86__
+
+#include <signal.h>
+#include <sys/types.h>
+
+/*
+	Shell command running in background: stdout and stderr of the child
+	go to a non-blocking pipe, so the output can be read from the main
+	loop (EventLoop::add(subproc.fd, ...)) as it arrives, instead of
+	blocking in popen/fgets until the command exits
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct subproc_s
+{
+	pid_t pid; // child process, 0 if not running
+	int   fd;  // read end of the output pipe, -1 if not running
+	int   status; // exit status after subproc_wait()
+} subproc_t;
+
+// run 'sh -c cmd' in its own process group, returns output fd or -1
+int subproc_start(subproc_t *sp, const char *cmd);
+// returns number of bytes read, 0 if no data now, -1 at end of output
+int subproc_read(subproc_t *sp, char *buf, int len);
+// send signal to the child process group (SIGINT for Ctrl-C)
+int subproc_kill(subproc_t *sp, int sig);
+// close the pipe and collect child exit status, waits if still running
+int subproc_wait(subproc_t *sp);
+// 1 if the child was started and not waited for yet
+int subproc_running(const subproc_t *sp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+#endif
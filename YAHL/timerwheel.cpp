@@ -0,0 +1,286 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifdef __ARDUINO_X86__
+#include <Arduino.h>
+#endif
+
+#include "timerwheel.h"
+
+static inline void list_init(tw_node_t *head)
+{
+	head->next = head->prev = head;
+}
+
+static inline bool list_empty(tw_node_t *head)
+{
+	return head->next == head;
+}
+
+static inline void list_add(tw_node_t *head, tw_node_t *node)
+{
+	node->prev = head->prev;
+	node->next = head;
+	head->prev->next = node;
+	head->prev = node;
+}
+
+static inline void list_del(tw_node_t *node)
+{
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	node->next = node->prev = 0;
+}
+
+// move all nodes from src to empty dst
+static inline void list_splice(tw_node_t *src, tw_node_t *dst)
+{
+	if (list_empty(src)) {
+		list_init(dst);
+		return;
+	}
+	dst->next = src->next;
+	dst->prev = src->prev;
+	dst->next->prev = dst;
+	dst->prev->next = dst;
+	list_init(src);
+}
+
+// index of the first set bit at or after 'from' going round, -1 if none
+static inline int first_bit(uint64_t bitmap, int from)
+{
+	if (bitmap == 0)
+		return -1;
+	uint64_t rot = (bitmap >> from) | (from ? (bitmap << (TW_SLOTS - from)) : 0);
+	return (from + __builtin_ctzll(rot)) & TW_MASK;
+}
+
+wtimer_t::wtimer_t(timerHandler *phandler, void *pdata)
+{
+	next = prev = 0;
+	handler = phandler;
+	data = pdata;
+	deadline = period = 0;
+	level = slot = 0;
+	reset_stat();
+}
+
+void wtimer_t::reset_stat(void)
+{
+	runs = overruns = 0;
+	jitter_max = jitter_last = 0;
+	jitter_sum = 0;
+}
+
+TimerWheel::TimerWheel(uint32_t now)
+{
+	cur = now;
+	ntimers = 0;
+	for(int l = 0; l < TW_LEVELS; l++) {
+		bitmap[l] = 0;
+		for(int s = 0; s < TW_SLOTS; s++)
+			list_init(&wheel[l][s]);
+	}
+}
+
+void TimerWheel::insert(wtimer_t *timer)
+{
+	int32_t delta = (int32_t)(timer->deadline - cur);
+	uint32_t when = timer->deadline;
+	int level;
+
+	if (delta < 0) {
+		// already expired, run on the next tick
+		when = cur;
+		level = 0;
+	}
+	else if (delta < (1 << TW_BITS))
+		level = 0;
+	else if (delta < (1 << (2*TW_BITS)))
+		level = 1;
+	else if (delta < (1 << (3*TW_BITS)))
+		level = 2;
+	else {
+		// too far, park it in the farthest slot and re-queue when reached
+		if (delta >= (1 << (4*TW_BITS)))
+			when = cur + (1 << (4*TW_BITS)) - 1;
+		level = 3;
+	}
+
+	int slot = (when >> (level * TW_BITS)) & TW_MASK;
+	timer->level = level;
+	timer->slot = slot;
+	list_add(&wheel[level][slot], timer);
+	bitmap[level] |= 1ull << slot;
+}
+
+void TimerWheel::unlink(wtimer_t *timer)
+{
+	tw_node_t *head = &wheel[timer->level][timer->slot];
+	list_del(timer);
+	if (list_empty(head))
+		bitmap[timer->level] &= ~(1ull << timer->slot);
+}
+
+void TimerWheel::start(wtimer_t *timer, uint32_t now, uint32_t delay, uint32_t period)
+{
+	if (timer->active())
+		cancel(timer);
+
+	timer->deadline = now + delay;
+	timer->period = period;
+	insert(timer);
+	ntimers++;
+}
+
+void TimerWheel::cancel(wtimer_t *timer)
+{
+	if (!timer->active())
+		return;
+	unlink(timer);
+	ntimers--;
+}
+
+// move timers of the slot one level down
+void TimerWheel::cascade(int level, int slot)
+{
+	tw_node_t list;
+
+	list_splice(&wheel[level][slot], &list);
+	bitmap[level] &= ~(1ull << slot);
+	while(!list_empty(&list)) {
+		wtimer_t *timer = static_cast<wtimer_t *>(list.next);
+		list_del(timer);
+		insert(timer);
+	}
+}
+
+void TimerWheel::expire(tw_node_t *list, uint32_t now, int *nrun)
+{
+	// handlers can start or cancel any timer, including ones still in the list
+	while(!list_empty(list)) {
+		wtimer_t *timer = static_cast<wtimer_t *>(list->next);
+		list_del(timer);
+
+		uint32_t late = now - timer->deadline;
+		timer->runs++;
+		timer->jitter_last = late;
+		timer->jitter_sum += late;
+		if (late > timer->jitter_max)
+			timer->jitter_max = late;
+
+		if (timer->period) {
+			// skip periods we are too late for
+			uint32_t missed = late / timer->period;
+			timer->overruns += missed;
+			timer->deadline += timer->period * (missed + 1);
+			insert(timer);
+		}
+		else
+			ntimers--;
+
+		(*nrun)++;
+		timer->handler(timer->data);
+	}
+}
+
+int TimerWheel::run(uint32_t now)
+{
+	int nrun = 0;
+
+	while((int32_t)(now - cur) >= 0) {
+		int idx = cur & TW_MASK;
+
+		if (idx == 0) {
+			// wheel of a level turned over, bring down timers of the next level
+			for(int l = 1; l < TW_LEVELS; l++) {
+				int slot = (cur >> (l * TW_BITS)) & TW_MASK;
+				cascade(l, slot);
+				if (slot)
+					break;
+			}
+		}
+
+		if (bitmap[0] & (1ull << idx)) {
+			tw_node_t list;
+			list_splice(&wheel[0][idx], &list);
+			bitmap[0] &= ~(1ull << idx);
+			// timers restarted by handlers go to the next slot at least
+			cur++;
+			expire(&list, now, &nrun);
+			continue;
+		}
+
+		// nothing in this slot, jump to the next non-empty one,
+		// cascade point or past 'now', whichever is closer
+		uint32_t step = TW_SLOTS - idx;
+		uint64_t ahead = bitmap[0] >> idx;
+		if (ahead)
+			step = __builtin_ctzll(ahead);
+		if (step == 0)
+			step = 1;
+		if (step > (now - cur + 1))
+			step = now - cur + 1;
+		cur += step;
+	}
+
+	return nrun;
+}
+
+int32_t TimerWheel::next(uint32_t now)
+{
+	if (ntimers == 0)
+		return -1;
+
+	uint32_t best = 0;
+	bool found = false;
+
+	for(int l = 0; l < TW_LEVELS; l++) {
+		if (bitmap[l] == 0)
+			continue;
+		int shift = l * TW_BITS;
+		int idx = (cur >> shift) & TW_MASK;
+		int slot = first_bit(bitmap[l], idx);
+		uint32_t ahead = (slot - idx) & TW_MASK;
+		// the current slot of upper levels is cascaded right at the slot
+		// boundary if run() has not got there yet, or a full turn later;
+		// in the latter case nearer slots of the level still count
+		if (l && ahead == 0 && (cur & ((1u << shift) - 1))) {
+			int near = first_bit(bitmap[l] & ~(1ull << idx), (idx + 1) & TW_MASK);
+			ahead = (near < 0) ? TW_SLOTS : ((near - idx) & TW_MASK);
+		}
+		// level 0 slots are exact, upper ones give the cascade time
+		uint32_t when = l ? (((cur >> shift) + ahead) << shift) : (cur + ahead);
+		if (!found || (int32_t)(when - best) < 0)
+			best = when;
+		found = true;
+	}
+
+	int32_t delta = (int32_t)(best - now);
+	return (delta < 0) ? 0 : delta;
+}
@@ -0,0 +1,115 @@
+/*	BSD License
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Redistribution and use in source and binary forms, with or without 
+	modification, are permitted provided that the following conditions
+	are met:
+
+	1. Redistributions of source code must retain the above copyright
+	notice, this list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright
+	notice, this list of conditions and the following disclaimer
+	in the documentation and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	contributors may be used to endorse or promote products derived
+	from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+	"AS IS" AND ANY	EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+	LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+	DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+	THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.	
+*/
+#ifndef __YAHL_TIMER_WHEEL_H__
+#define __YAHL_TIMER_WHEEL_H__
+
+#include <stdint.h>
+
+/*
+	Hierarchical timer wheel: 4 levels of 64 slots with 1 msec resolution,
+	O(1) start, cancel and expire for one-shot and periodic timers.
+	Level 0 covers 64 msec, level 1 - 4 seconds, level 2 - 4 minutes,
+	level 3 - 4.6 hours, longer timers are parked in the farthest slot
+	and re-queued when it is reached.
+	Bitmaps of non-empty slots let next() find the nearest deadline
+	without walking lists, so the main loop can sleep until then.
+*/
+
+#define TW_LEVELS 4
+#define TW_BITS   6
+#define TW_SLOTS  (1 << TW_BITS)
+#define TW_MASK   (TW_SLOTS - 1)
+
+// timer handler, same as ticker_t handler
+typedef int timerHandler(void *data);
+
+// intrusive list node
+struct tw_node_t {
+	tw_node_t *next;
+	tw_node_t *prev;
+};
+
+class wtimer_t : private tw_node_t {
+public:
+	wtimer_t(timerHandler *phandler, void *pdata = 0);
+
+	bool     active(void) { return next != 0; }
+	uint32_t expires(void) { return deadline; }
+	uint32_t get_period(void) { return period; }
+
+	// statistics, jitter is how late (msec) the handler was called
+	uint32_t runs;
+	uint32_t overruns;   // periods skipped because handler was too late
+	uint32_t jitter_max;
+	uint32_t jitter_last;
+	uint64_t jitter_sum;
+
+	uint32_t jitter_avg(void) { return runs ? (uint32_t)(jitter_sum / runs) : 0; }
+	void     reset_stat(void);
+
+private:
+	friend class TimerWheel;
+	uint32_t deadline;
+	uint32_t period;
+	uint8_t  level;
+	uint8_t  slot;
+	timerHandler *handler;
+	void *data;
+};
+
+class TimerWheel {
+public:
+	// current time in msec, millis() for example
+	TimerWheel(uint32_t now = 0);
+
+	// start or restart timer, expires in 'delay' msec and then
+	// every 'period' msec if period is not 0
+	void start(wtimer_t *timer, uint32_t now, uint32_t delay, uint32_t period = 0);
+	void cancel(wtimer_t *timer);
+
+	// call handlers of expired timers, returns number of handlers called
+	int run(uint32_t now);
+	// msec until the next deadline, 0 if something expired already, -1 if no timers
+	int32_t next(uint32_t now);
+
+	uint32_t count(void) { return ntimers; }
+
+private:
+	uint32_t cur; // all timers before this time are processed
+	uint32_t ntimers;
+	uint64_t bitmap[TW_LEVELS];
+	tw_node_t wheel[TW_LEVELS][TW_SLOTS];
+
+	void insert(wtimer_t *timer);
+	void unlink(wtimer_t *timer);
+	void cascade(int level, int slot);
+	void expire(tw_node_t *list, uint32_t now, int *nrun);
+};
+
+#endif
@@ -0,0 +1,208 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#include <Arduino.h>
+
+#ifdef __ARDUINO_X86__
+
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "udpfanout.h"
+
+// sendmmsg() batch size
+#define FANOUT_BATCH 16
+
+UdpFanout::UdpFanout(void)
+{
+	nsubs = 0;
+	dgram_max = 0;
+	dgram_len = 0;
+	memset(subs, 0, sizeof(subs));
+}
+
+int UdpFanout::begin(uint8_t ttl, const char *if_addr)
+{
+	int fd = sock.create();
+	if (fd < 0)
+		return -1;
+
+	int opt = ttl;
+	setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &opt, sizeof(opt));
+	opt = 1;
+	setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &opt, sizeof(opt));
+	if (if_addr) {
+		struct in_addr ifa;
+		ifa.s_addr = inet_addr(if_addr);
+		setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &ifa, sizeof(ifa));
+	}
+
+	return fd;
+}
+
+void UdpFanout::end(void)
+{
+	flush();
+	sock.end();
+}
+
+int UdpFanout::subscribe(const char *ip_addr, uint16_t port)
+{
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, ip_addr, &addr.sin_addr) != 1)
+		return -1;
+
+	for(uint32_t i = 0; i < nsubs; i++) {
+		if (subs[i].addr.sin_addr.s_addr == addr.sin_addr.s_addr &&
+			subs[i].addr.sin_port == addr.sin_port)
+			return i;
+	}
+	if (nsubs == FANOUT_MAX_SUBS)
+		return -1;
+
+	memset(&subs[nsubs], 0, sizeof(fanout_sub_t));
+	subs[nsubs].addr = addr;
+	return nsubs++;
+}
+
+int UdpFanout::unsubscribe(const char *ip_addr, uint16_t port)
+{
+	struct in_addr ia;
+	if (inet_pton(AF_INET, ip_addr, &ia) != 1)
+		return -1;
+
+	for(uint32_t i = 0; i < nsubs; i++) {
+		if (subs[i].addr.sin_addr.s_addr == ia.s_addr &&
+			subs[i].addr.sin_port == htons(port)) {
+			subs[i] = subs[--nsubs];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+const fanout_sub_t *UdpFanout::subscriber(int idx)
+{
+	if (idx < 0 || idx >= (int)nsubs)
+		return NULL;
+	return &subs[idx];
+}
+
+void UdpFanout::coalesce(uint32_t size)
+{
+	flush();
+	if (size > FANOUT_MAX_DGRAM)
+		size = FANOUT_MAX_DGRAM;
+	dgram_max = size;
+}
+
+// send one datagram to all subscribers, FANOUT_BATCH per sendmmsg()
+int UdpFanout::send(const void *msg, uint32_t len)
+{
+	int fd = sock.handle();
+	if (fd < 0 || nsubs == 0)
+		return 0;
+
+	struct iovec iov;
+	struct mmsghdr mh[FANOUT_BATCH];
+
+	iov.iov_base = (void *)msg;
+	iov.iov_len = len;
+
+	int nsent = 0;
+	for(uint32_t first = 0; first < nsubs; first += FANOUT_BATCH) {
+		uint32_t n = nsubs - first;
+		if (n > FANOUT_BATCH)
+			n = FANOUT_BATCH;
+
+		memset(mh, 0, sizeof(mh[0]) * n);
+		for(uint32_t i = 0; i < n; i++) {
+			mh[i].msg_hdr.msg_name = &subs[first + i].addr;
+			mh[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			mh[i].msg_hdr.msg_iov = &iov;
+			mh[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		// sendmmsg() stops on the first failed datagram,
+		// count it as dropped and continue with the next one
+		for(uint32_t i = 0; i < n; ) {
+			int ret = sendmmsg(fd, &mh[i], n - i, MSG_DONTWAIT);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				subs[first + i].dropped++;
+				i++;
+				continue;
+			}
+			for(int k = 0; k < ret; k++)
+				subs[first + i + k].sent++;
+			nsent += ret;
+			i += ret;
+		}
+	}
+
+	return nsent;
+}
+
+int UdpFanout::flush(void)
+{
+	if (dgram_len == 0)
+		return 0;
+	int ret = send(dgram, dgram_len);
+	dgram_len = 0;
+	return ret;
+}
+
+int UdpFanout::publish(const void *msg, uint32_t len)
+{
+	// too big for coalescing or no coalescing at all
+	if (len > dgram_max) {
+		flush();
+		return send(msg, len);
+	}
+
+	if ((dgram_len + len) > dgram_max)
+		flush();
+	memcpy(dgram + dgram_len, msg, len);
+	dgram_len += len;
+
+	return 0;
+}
+
+int UdpFanout::publish_nmea(const char *nmea)
+{
+	char line[FANOUT_MAX_DGRAM];
+	uint32_t len = strlen(nmea);
+
+	// strip existing EOL, if any
+	while(len && (nmea[len - 1] == '\r' || nmea[len - 1] == '\n'))
+		len--;
+	if (len > (sizeof(line) - 2))
+		return -1;
+
+	memcpy(line, nmea, len);
+	line[len++] = '\r';
+	line[len++] = '\n';
+
+	return publish(line, len);
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#ifndef __YAHL_UDP_FANOUT_H__
+#define __YAHL_UDP_FANOUT_H__
+
+/*
+	Publishes messages to a multicast group and/or a list of unicast
+	subscribers, one sendmmsg() call sends a datagram to all of them.
+	Small messages (like NMEA sentences) can be coalesced into one datagram.
+*/
+
+#include <netinet/in.h>
+
+#include "udpsock.h"
+
+#define FANOUT_MAX_SUBS  64
+#define FANOUT_MAX_DGRAM 1472 // fits into one Ethernet frame
+
+typedef struct fanout_sub_s
+{
+	struct sockaddr_in addr;
+	uint32_t sent;    // datagrams sent
+	uint32_t dropped; // datagrams dropped: socket buffer full or send error
+} fanout_sub_t;
+
+class UdpFanout {
+public:
+	UdpFanout(void);
+
+	// create socket, TTL and local interface address for multicast
+	int  begin(uint8_t ttl = 1, const char *if_addr = NULL);
+	void end(void);
+
+	// add multicast group or unicast subscriber, returns index or -1
+	int subscribe(const char *ip_addr, uint16_t port);
+	int unsubscribe(const char *ip_addr, uint16_t port);
+	int count(void) { return nsubs; }
+	const fanout_sub_t *subscriber(int idx);
+
+	// coalesce messages into datagrams up to 'size' bytes,
+	// 0 to send every message as a separate datagram
+	void coalesce(uint32_t size);
+	// publish a message, returns number of subscribers it was sent to
+	// or 0 if it was queued for coalescing
+	int publish(const void *msg, uint32_t len);
+	// publish NMEA sentence terminated with <CR><LF>
+	int publish_nmea(const char *nmea);
+	// send coalesced messages now
+	int flush(void);
+
+private:
+	UdpSocket sock;
+	uint32_t  nsubs;
+	uint32_t  dgram_max; // coalescing size
+	uint32_t  dgram_len; // pending data
+	char dgram[FANOUT_MAX_DGRAM];
+	fanout_sub_t subs[FANOUT_MAX_SUBS];
+
+	int send(const void *msg, uint32_t len);
+};
+
+#endif
@@ -0,0 +1,316 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#include <Arduino.h>
+
+#ifdef __ARDUINO_X86__
+
+#include <poll.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "udpserver.h"
+
+#define INDEX_SIZE (UDP_MAX_SESSIONS * 2)
+#define INDEX_MASK (INDEX_SIZE - 1)
+#define RECV_BATCH 16
+
+// FNV-1a over address and port
+static uint32_t addr_hash(const struct sockaddr_in6 *addr)
+{
+	uint32_t hash = 2166136261u;
+	const uint8_t *p = addr->sin6_addr.s6_addr;
+
+	for(int i = 0; i < 16; i++)
+		hash = (hash ^ p[i]) * 16777619u;
+	hash = (hash ^ (addr->sin6_port & 0xFF)) * 16777619u;
+	hash = (hash ^ (addr->sin6_port >> 8)) * 16777619u;
+	return hash;
+}
+
+static int addr_equal(const struct sockaddr_in6 *a, const struct sockaddr_in6 *b)
+{
+	return a->sin6_port == b->sin6_port &&
+		memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(struct in6_addr)) == 0;
+}
+
+UdpServer::UdpServer(udpHandler *handler, void *data)
+{
+	sock = -1;
+	idle = UDP_SESSION_IDLE;
+	nses = 0;
+	nrejected = 0;
+	this->handler = handler;
+	hdata = data;
+	memset(ses, 0, sizeof(ses));
+	memset(used, 0, sizeof(used));
+	memset(index, 0xFF, sizeof(index));
+}
+
+UdpServer::~UdpServer(void)
+{
+	end();
+}
+
+int UdpServer::begin(uint16_t port, const char *ip_addr)
+{
+	struct sockaddr_in6 addr;
+
+	if (port == 0)
+		return -1;
+	end();
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin6_family = AF_INET6;
+	addr.sin6_port = htons(port);
+	addr.sin6_addr = in6addr_any;
+	if (ip_addr) {
+		struct in_addr ip4;
+		if (inet_pton(AF_INET, ip_addr, &ip4) == 1) {
+			// IPv4-mapped address ::ffff:a.b.c.d
+			addr.sin6_addr.s6_addr[10] = 0xFF;
+			addr.sin6_addr.s6_addr[11] = 0xFF;
+			memcpy(&addr.sin6_addr.s6_addr[12], &ip4, 4);
+		}
+		else if (inet_pton(AF_INET6, ip_addr, &addr.sin6_addr) != 1)
+			return -1;
+	}
+
+	if ((sock = socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP)) < 0)
+		return -1;
+
+	int opt = 0;
+	setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt));
+	opt = 1;
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		::close(sock);
+		sock = -1;
+		return -1;
+	}
+
+	return sock;
+}
+
+void UdpServer::end(void)
+{
+	for(int i = 0; i < UDP_MAX_SESSIONS; i++) {
+		if (used[i])
+			close(&ses[i]);
+	}
+	if (sock != -1)
+		::close(sock);
+	sock = -1;
+}
+
+udp_session_t *UdpServer::session(uint32_t idx)
+{
+	if (idx >= UDP_MAX_SESSIONS || !used[idx])
+		return NULL;
+	return &ses[idx];
+}
+
+// find session for the address, create a new one if not found
+udp_session_t *UdpServer::lookup(const struct sockaddr_in6 *addr, uint32_t now)
+{
+	uint32_t slot = addr_hash(addr) & INDEX_MASK;
+
+	for(; index[slot] != -1; slot = (slot + 1) & INDEX_MASK) {
+		udp_session_t *ps = &ses[index[slot]];
+		if (addr_equal(&ps->addr, addr))
+			return ps;
+	}
+
+	if (nses == UDP_MAX_SESSIONS)
+		return NULL;
+
+	int sidx;
+	for(sidx = 0; used[sidx]; sidx++);
+
+	udp_session_t *ps = &ses[sidx];
+	memset(ps, 0, sizeof(udp_session_t));
+	ps->addr = *addr;
+	ps->first_seen = now;
+	if (IN6_IS_ADDR_V4MAPPED(&addr->sin6_addr))
+		inet_ntop(AF_INET, &addr->sin6_addr.s6_addr[12], ps->ip, sizeof(ps->ip));
+	else
+		inet_ntop(AF_INET6, &addr->sin6_addr, ps->ip, sizeof(ps->ip));
+
+	used[sidx] = 1;
+	index[slot] = sidx;
+	nses++;
+	return ps;
+}
+
+// remove session from the hash index, backward shift deletion
+// keeps probe sequences intact without tombstones
+void UdpServer::unlink(int sidx)
+{
+	uint32_t i = addr_hash(&ses[sidx].addr) & INDEX_MASK;
+	while(index[i] != sidx) {
+		if (index[i] == -1)
+			return;
+		i = (i + 1) & INDEX_MASK;
+	}
+
+	for(uint32_t j = i; ; ) {
+		index[i] = -1;
+		while(1) {
+			j = (j + 1) & INDEX_MASK;
+			if (index[j] == -1)
+				return;
+			uint32_t home = addr_hash(&ses[index[j]].addr) & INDEX_MASK;
+			// move entry j to i if its home slot is not in (i, j]
+			if (((j - home) & INDEX_MASK) >= ((j - i) & INDEX_MASK))
+				break;
+		}
+		index[i] = index[j];
+		i = j;
+	}
+}
+
+void UdpServer::close(udp_session_t *ps)
+{
+	int sidx = ps - ses;
+	if (sidx < 0 || sidx >= UDP_MAX_SESSIONS || !used[sidx])
+		return;
+
+	if (handler)
+		handler(this, ps, NULL, 0, hdata);
+	unlink(sidx);
+	used[sidx] = 0;
+	nses--;
+}
+
+int UdpServer::expire(void)
+{
+	int n = 0;
+	uint32_t now = millis();
+
+	if (idle == 0 || nses == 0)
+		return 0;
+
+	for(int i = 0; i < UDP_MAX_SESSIONS; i++) {
+		if (used[i] && (now - ses[i].last_seen) >= idle) {
+			close(&ses[i]);
+			n++;
+		}
+	}
+	return n;
+}
+
+int UdpServer::process(void)
+{
+	char buf[RECV_BATCH][UDP_MAX_LINE + 1];
+	struct sockaddr_in6 addr[RECV_BATCH];
+	struct iovec iov[RECV_BATCH];
+	struct mmsghdr mh[RECV_BATCH];
+	int total = 0;
+
+	if (sock == -1)
+		return -1;
+
+	while(1) {
+		memset(mh, 0, sizeof(mh));
+		for(int i = 0; i < RECV_BATCH; i++) {
+			iov[i].iov_base = buf[i];
+			iov[i].iov_len = UDP_MAX_LINE;
+			mh[i].msg_hdr.msg_name = &addr[i];
+			mh[i].msg_hdr.msg_namelen = sizeof(addr[i]);
+			mh[i].msg_hdr.msg_iov = &iov[i];
+			mh[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int n = recvmmsg(sock, mh, RECV_BATCH, MSG_DONTWAIT, NULL);
+		if (n < 1)
+			break;
+
+		uint32_t now = millis();
+		for(int i = 0; i < n; i++) {
+			udp_session_t *ps = lookup(&addr[i], now);
+			if (ps == NULL) {
+				nrejected++;
+				continue;
+			}
+			ps->last_seen = now;
+			ps->rx++;
+			buf[i][mh[i].msg_len] = '\0';
+			if (handler)
+				handler(this, ps, buf[i], mh[i].msg_len, hdata);
+		}
+		total += n;
+		if (n < RECV_BATCH)
+			break;
+	}
+
+	expire();
+	return total;
+}
+
+int UdpServer::poll(int timeout)
+{
+	struct pollfd pfd;
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	if (::poll(&pfd, 1, timeout) > 0)
+		return process();
+
+	expire();
+	return 0;
+}
+
+int UdpServer::send(udp_session_t *ps, const void *msg, uint32_t len)
+{
+	if (sock == -1 || ps == NULL)
+		return -1;
+
+	int ret = sendto(sock, msg, len, MSG_DONTWAIT, (struct sockaddr *)&ps->addr, sizeof(ps->addr));
+	if (ret > 0)
+		ps->tx++;
+	return ret;
+}
+
+int UdpServer::print(udp_session_t *ps, const char *format, ...)
+{
+	int len;
+	char buffer[UDP_MAX_LINE];
+	va_list ap;
+
+	va_start(ap, format);
+	len = vsnprintf(buffer, UDP_MAX_LINE, format, ap);
+	va_end(ap);
+	if (len < 0)
+		return -1;
+	if (len >= UDP_MAX_LINE)
+		len = UDP_MAX_LINE - 1;
+
+	return send(ps, buffer, len);
+}
+
+int UdpServer::broadcast(const void *msg, uint32_t len)
+{
+	int n = 0;
+	for(int i = 0; i < UDP_MAX_SESSIONS; i++) {
+		if (used[i] && send(&ses[i], msg, len) > 0)
+			n++;
+	}
+	return n;
+}
+
+#endif
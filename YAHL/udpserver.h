@@ -0,0 +1,105 @@
+/*	Apache 2.0 License
+	
+	Copyright (c) 2015 Andrey Chilikin https://github.com/achilikin
+
+	Licensed under the Apache License, Version 2.0 (the "License");
+	you may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+*/
+#ifndef __YAHL_UDP_SERVER_H__
+#define __YAHL_UDP_SERVER_H__
+
+/*
+	Non-blocking UDP server for many clients: every client address gets
+	its own session with last seen time, so replies go to the right client
+	and idle sessions expire. Dual stack socket, IPv4 clients are seen as
+	IPv4-mapped IPv6 addresses. fd() can be added to poll/epoll, process()
+	then reads all pending packets.
+*/
+
+#include <stdarg.h>
+#include <netinet/in.h>
+
+#include "udpsock.h"
+
+#define UDP_MAX_SESSIONS 64
+#define UDP_SESSION_IDLE 60000 // default idle timeout, msec
+
+typedef struct udp_session_s
+{
+	struct sockaddr_in6 addr;
+	char     ip[INET6_ADDRSTRLEN]; // address string, dotted IPv4 for IPv4 clients
+	uint32_t first_seen; // millis()
+	uint32_t last_seen;
+	uint32_t rx;   // packets received
+	uint32_t tx;   // packets sent
+	void    *data; // user data
+} udp_session_t;
+
+class UdpServer;
+
+// called for every packet received from a session,
+// msg == NULL when the session is expired or closed
+typedef void udpHandler(UdpServer *srv, udp_session_t *ses, const char *msg, uint32_t len, void *data);
+
+class UdpServer {
+public:
+	UdpServer(udpHandler *handler, void *data = NULL);
+	~UdpServer(void);
+
+	// listen on port, any address if ip_addr is NULL, IPv4 or IPv6 address otherwise
+	int  begin(uint16_t port, const char *ip_addr = NULL);
+	void end(void);
+
+	// socket descriptor to wait for POLLIN/EPOLLIN on
+	int fd(void) { return sock; }
+	// read all pending packets and dispatch them, returns number of packets
+	int process(void);
+	// wait up to timeout msec for packets and process them
+	int poll(int timeout);
+
+	// session idle timeout in msec, 0 - sessions never expire
+	void set_idle(uint32_t msec) { idle = msec; }
+	// expire idle sessions, called by process() as well
+	int  expire(void);
+	// close session
+	void close(udp_session_t *ses);
+
+	// send to session
+	int send(udp_session_t *ses, const void *msg, uint32_t len);
+	int print(udp_session_t *ses, const char *format, ...);
+	// send to all sessions
+	int broadcast(const void *msg, uint32_t len);
+
+	uint32_t count(void) { return nses; }
+	// session by index 0...UDP_MAX_SESSIONS-1, NULL if not used
+	udp_session_t *session(uint32_t idx);
+	// packets dropped because session table was full
+	uint32_t rejected(void) { return nrejected; }
+
+private:
+	int sock;
+	uint32_t idle;
+	uint32_t nses;
+	uint32_t nrejected;
+	udpHandler *handler;
+	void *hdata;
+
+	// session storage and open addressing hash index to it
+	udp_session_t ses[UDP_MAX_SESSIONS];
+	uint8_t used[UDP_MAX_SESSIONS];
+	int16_t index[UDP_MAX_SESSIONS * 2]; // -1 for free slot
+
+	udp_session_t *lookup(const struct sockaddr_in6 *addr, uint32_t now);
+	void unlink(int sidx);
+};
+
+#endif
@@ -27,6 +27,7 @@
 UdpSocket::UdpSocket(void)
 {
 	sock = -1;
+	tstamp = 0;
 	saddr[0] = '\0';
 	caddr[0] = '\0';
 }
@@ -36,6 +37,7 @@ void UdpSocket::end(void)
 	if (sock != -1)
 		close(sock);
 	sock = -1;
+	tstamp = 0;
 	saddr[0] = '\0';
 	caddr[0] = '\0';
 }
@@ -112,7 +114,7 @@ uint16_t UdpSocket::get_client_port(void)
 }
 
 /* read our socket and store client address */
-int UdpSocket::read(char *msg, uint32_t msglen)
+int UdpSocket::read(char *msg, uint32_t msglen, uint32_t flags)
 {
 	if (sock == -1)
 		return 0;
@@ -141,6 +143,11 @@ int UdpSocket::read(char *msg, uint32_t msglen)
 		return 0;
 	msg[rlen] = '\0';
 
+	if (flags & UDP_RAW) {
+		inet_ntop(AF_INET, &client.sin_addr, caddr, INET_ADDRSTRLEN);
+		return rlen;
+	}
+
 	/* make sure to receive valid ASCII string */
 	for(int i = 0; i < rlen; i++) {
 		if (!isprint(msg[i])) {
@@ -177,6 +184,90 @@ int UdpSocket::read(char *msg, uint32_t msglen)
 	return rlen;
 }
 
+int UdpSocket::enable_tstamp(void)
+{
+	if (!tstamp) {
+		int opt = 1;
+		if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &opt, sizeof(opt)) < 0)
+			return -1;
+		tstamp = 1;
+	}
+	return 0;
+}
+
+/* read a batch of packets, no copying, no string conversion unless asked */
+int UdpSocket::read_batch(udp_msg_t *msgs, uint32_t n, uint32_t flags)
+{
+	if (sock == -1 || n == 0)
+		return 0;
+	if (n > UDP_MAX_BATCH)
+		n = UDP_MAX_BATCH;
+	// string mode needs room for the terminating null
+	if (!(flags & UDP_RAW)) {
+		for(uint32_t i = 0; i < n; i++)
+			if (msgs[i].buflen == 0)
+				return -1;
+	}
+	if (flags & UDP_TSTAMP)
+		enable_tstamp();
+
+	// room for IP_PKTINFO enabled by begin() and for SO_TIMESTAMPNS
+	typedef char cmsg_t[CMSG_SPACE(sizeof(struct in_pktinfo)) + CMSG_SPACE(sizeof(struct timespec))];
+	struct iovec iov[UDP_MAX_BATCH];
+	struct mmsghdr mh[UDP_MAX_BATCH];
+	cmsg_t cmsg[UDP_MAX_BATCH];
+
+	memset(mh, 0, sizeof(mh[0]) * n);
+	for(uint32_t i = 0; i < n; i++) {
+		iov[i].iov_base = msgs[i].buf;
+		// keep one byte for terminating null for string mode
+		iov[i].iov_len = msgs[i].buflen - ((flags & UDP_RAW) ? 0 : 1);
+		mh[i].msg_hdr.msg_name = &msgs[i].addr;
+		mh[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		mh[i].msg_hdr.msg_iov = &iov[i];
+		mh[i].msg_hdr.msg_iovlen = 1;
+		mh[i].msg_hdr.msg_control = cmsg[i];
+		mh[i].msg_hdr.msg_controllen = sizeof(cmsg_t);
+	}
+
+	int nmsg = recvmmsg(sock, mh, n, MSG_DONTWAIT, NULL);
+	if (nmsg < 1)
+		return 0;
+
+	for(int i = 0; i < nmsg; i++) {
+		udp_msg_t *pmsg = &msgs[i];
+		pmsg->len = mh[i].msg_len;
+		if (!(flags & UDP_RAW)) {
+			char *str = (char *)pmsg->buf;
+			str[pmsg->len] = '\0';
+			for(uint32_t k = 0; k < pmsg->len; k++) {
+				if (!isprint(str[k])) {
+					str[k] = '\0';
+					pmsg->len = k;
+					break;
+				}
+			}
+		}
+
+		pmsg->tstamp.tv_sec = pmsg->tstamp.tv_nsec = 0;
+		if (flags & UDP_TSTAMP) {
+			struct cmsghdr *pcmsg = CMSG_FIRSTHDR(&mh[i].msg_hdr);
+			for(; pcmsg != NULL; pcmsg = CMSG_NXTHDR(&mh[i].msg_hdr, pcmsg)) {
+				if (pcmsg->cmsg_level == SOL_SOCKET && pcmsg->cmsg_type == SCM_TIMESTAMPNS) {
+					memcpy(&pmsg->tstamp, CMSG_DATA(pcmsg), sizeof(struct timespec));
+					break;
+				}
+			}
+		}
+	}
+
+	// last sender becomes current client for write() and print()
+	client = msgs[nmsg - 1].addr;
+	inet_ntop(AF_INET, &client.sin_addr, caddr, INET_ADDRSTRLEN);
+
+	return nmsg;
+}
+
 int UdpSocket::write(const char *msg, int msglen)
 {
 	if (!connected())
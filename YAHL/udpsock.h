@@ -17,10 +17,26 @@
 #ifndef __YAHL_UDP_SOCKET_H__
 #define __YAHL_UDP_SOCKET_H__
 
+#include <time.h>
 #include <stdarg.h>
 #include <netinet/in.h>
 
-#define UDP_MAX_LINE 512
+#define UDP_MAX_LINE  512
+#define UDP_MAX_BATCH 32 // maximum number of datagrams for read_batch()
+
+// read() and read_batch() flags
+#define UDP_RAW    0x0001 // binary data, do not truncate at non-printable characters
+#define UDP_TSTAMP 0x0002 // get kernel receive timestamp (CLOCK_REALTIME)
+
+// one datagram for read_batch()
+typedef struct udp_msg_s
+{
+	void    *buf;    // caller provided buffer
+	uint32_t buflen; // and its size
+	uint32_t len;    // received data length
+	struct sockaddr_in addr; // sender address
+	struct timespec tstamp;  // receive time if UDP_TSTAMP requested
+} udp_msg_t;
 
 class UdpSocket {
 private:
@@ -29,6 +45,9 @@ private:
 	struct sockaddr_in client;	 // client IPv4 address string
 	char saddr[INET_ADDRSTRLEN]; // server IPv4 address string
 	char caddr[INET_ADDRSTRLEN]; // client IPv4 address string
+	int tstamp; // SO_TIMESTAMPNS enabled
+
+	int enable_tstamp(void);
 
 public:
 	UdpSocket(void);
@@ -40,6 +59,8 @@ public:
 	int  begin(uint16_t port, const char *ip_addr = NULL);
 	// close UDP socket
 	void end(void);
+	// socket descriptor, -1 if not created
+	int handle(void) { return sock; }
 
 	// sends data to specified ip and port
 	// if msglen == -1 then msglen = strlen(msg)+1
@@ -49,8 +70,12 @@ public:
 
 	// returns true if data is ready to be read
 	int ready(void);
-	// reads received packet
-	int read(char *buffer, uint32_t buflen);
+	// reads received packet, by default as a printable string
+	int read(char *buffer, uint32_t buflen, uint32_t flags = 0);
+	// reads up to n packets with one system call into caller provided buffers
+	// returns number of packets read, 0 if nothing is ready,
+	// -1 if a buffer has no room for the terminating null in string mode
+	int read_batch(udp_msg_t *msgs, uint32_t n, uint32_t flags = 0);
 
 	// checks if any client connected so far
 	int connected(void) { return (caddr[0] == '\0') ? 0 : 1; }